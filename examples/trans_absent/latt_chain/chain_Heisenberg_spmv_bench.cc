@@ -0,0 +1,260 @@
+#include <iostream>
+#include <iomanip>
+#include "qbasis.h"
+
+// micro-benchmark of the sparse matrix vector product backends
+// Heisenberg model on a chain, Sz = 0 sector
+int main() {
+    qbasis::initialize(false);                      // no checkpoints: each run below must compute, not reload
+    std::cout << std::setprecision(10);
+    // parameters
+    double J = 1.0;
+    int L = 20;
+    int n_rep = 20;
+
+    std::cout << "L =       " << L << std::endl;
+    std::cout << "J =       " << J << std::endl << std::endl;
+
+    // lattice object
+    std::vector<std::string> bc{"pbc"};
+    qbasis::lattice lattice("chain",{static_cast<uint32_t>(L)},bc);
+
+    // local matrix representation
+    // Spins:
+    std::vector<std::vector<std::complex<double>>> Splus(2,std::vector<std::complex<double>>(2));
+    std::vector<std::vector<std::complex<double>>> Sminus(2,std::vector<std::complex<double>>(2));
+    std::vector<std::complex<double>> Sz(2);
+    Splus[0][0]  = 0.0;
+    Splus[0][1]  = 1.0;
+    Splus[1][0]  = 0.0;
+    Splus[1][1]  = 0.0;
+    Sminus[0][0] = 0.0;
+    Sminus[0][1] = 0.0;
+    Sminus[1][0] = 1.0;
+    Sminus[1][1] = 0.0;
+    Sz[0]        = 0.5;
+    Sz[1]        = -0.5;
+
+    // constructing the Hamiltonian in operator representation
+    qbasis::model<std::complex<double>> Heisenberg(lattice);
+    Heisenberg.add_orbital(lattice.total_sites(), "spin-1/2");
+    qbasis::mopr<std::complex<double>> Sz_total;
+    for (int x = 0; x < L; x++) {
+        uint32_t site_i, site_j;
+        std::vector<int> work(lattice.dimension());
+        lattice.coor2site({x}, 0, site_i, work); // obtain site label of (x)
+        auto Splus_i   = qbasis::opr<std::complex<double>>(site_i,0,false,Splus);
+        auto Sminus_i  = qbasis::opr<std::complex<double>>(site_i,0,false,Sminus);
+        auto Sz_i      = qbasis::opr<std::complex<double>>(site_i,0,false,Sz);
+        Sz_total += Sz_i;
+
+        // with neighbor (x+1)
+        lattice.coor2site({x+1}, 0, site_j, work);
+        auto Splus_j   = qbasis::opr<std::complex<double>>(site_j,0,false,Splus);
+        auto Sminus_j  = qbasis::opr<std::complex<double>>(site_j,0,false,Sminus);
+        auto Sz_j      = qbasis::opr<std::complex<double>>(site_j,0,false,Sz);
+        Heisenberg.add_Ham(std::complex<double>(0.5 * J,0.0) * (Splus_i * Sminus_j + Sminus_i * Splus_j));
+        Heisenberg.add_Ham(std::complex<double>(J,0.0) * (Sz_i * Sz_j));
+    }
+
+    // constructing the Hilbert space basis
+    Heisenberg.enumerate_basis_full({Sz_total}, {0.0});
+    MKL_INT dim = Heisenberg.dim_full[0];
+
+    std::vector<std::complex<double>> x(dim), y_ref(dim), y(dim);
+    qbasis::vec_randomize(dim, x.data(), 1);
+
+    // upper triangle (default) and full storage
+    for (bool upper_triangle : {true, false}) {
+        Heisenberg.generate_Ham_sparse_full(0, upper_triangle, false);
+        auto &H = Heisenberg.HamMat_csr_full[0];
+        std::cout << std::endl << "Storage: " << (upper_triangle ? "upper triangle" : "full") << std::endl;
+        for (std::string backend : {"mkl_csrmv", "native", "sell", "mkl_ie"}) {
+            H.set_spmv(backend);
+            H.MultMv(x.data(), y.data());                                    // warm up
+            std::chrono::time_point<std::chrono::system_clock> start, end;
+            start = std::chrono::system_clock::now();
+            for (int rep = 0; rep < n_rep; rep++) H.MultMv(x.data(), y.data());
+            end = std::chrono::system_clock::now();
+            std::chrono::duration<double> elapsed_seconds = end - start;
+            if (backend == "mkl_csrmv") y_ref = y;
+            double diff = 0.0;
+            for (MKL_INT i = 0; i < dim; i++) diff += std::norm(y[i] - y_ref[i]);
+            std::cout << std::endl << std::setw(10) << backend << ": "
+                      << elapsed_seconds.count() / n_rep << "s per MultMv, |y - y_mkl_csrmv| = " << std::sqrt(diff) << std::endl;
+            assert(std::sqrt(diff) < 1e-10);
+        }
+        // compressed column indices, native kernel
+        for (std::string index : {"idx32", "delta"}) {
+            auto H_idx = H;
+            H_idx.set_index(index);
+            H_idx.MultMv(x.data(), y.data());                                // warm up
+            std::chrono::time_point<std::chrono::system_clock> start, end;
+            start = std::chrono::system_clock::now();
+            for (int rep = 0; rep < n_rep; rep++) H_idx.MultMv(x.data(), y.data());
+            end = std::chrono::system_clock::now();
+            std::chrono::duration<double> elapsed_seconds = end - start;
+            double diff = 0.0;
+            for (MKL_INT i = 0; i < dim; i++) diff += std::norm(y[i] - y_ref[i]);
+            std::cout << std::endl << std::setw(10) << ("native/" + index) << ": "
+                      << elapsed_seconds.count() / n_rep << "s per MultMv, |y - y_mkl_csrmv| = " << std::sqrt(diff) << std::endl;
+            assert(std::sqrt(diff) < 1e-10);
+        }
+    }
+
+    // block product with k interleaved vectors, upper triangle storage and matrix free
+    Heisenberg.generate_Ham_sparse_full(0, true, false);
+    std::cout << std::endl << "Block product (time per vector):" << std::endl;
+    for (int k : {1, 2, 4, 8}) {
+        std::vector<std::complex<double>> X(static_cast<size_t>(dim) * k), Y(static_cast<size_t>(dim) * k);
+        for (MKL_INT i = 0; i < dim; i++)
+            for (int s = 0; s < k; s++) X[static_cast<size_t>(i) * k + s] = x[i];
+        for (bool matrix_free : {false, true}) {
+            Heisenberg.matrix_free = matrix_free;
+            auto &H = Heisenberg.HamMat_csr_full[0];
+            std::chrono::time_point<std::chrono::system_clock> start, end;
+            start = std::chrono::system_clock::now();
+            int n_blk = matrix_free ? 2 : n_rep;
+            for (int rep = 0; rep < n_blk; rep++) {
+                if (matrix_free) Heisenberg.MultMm(X.data(), Y.data(), k); else H.MultMm(X.data(), Y.data(), k);
+            }
+            end = std::chrono::system_clock::now();
+            std::chrono::duration<double> elapsed_seconds = end - start;
+            double diff = 0.0;
+            for (MKL_INT i = 0; i < dim; i++)
+                for (int s = 0; s < k; s++) diff += std::norm(Y[static_cast<size_t>(i) * k + s] - y_ref[i]);
+            std::cout << std::endl << std::setw(4) << k << (matrix_free ? " vectors, matrix free: " : " vectors, csr native:  ")
+                      << elapsed_seconds.count() / n_blk / k << "s per vector, |Y - y_mkl_csrmv| = " << std::sqrt(diff) << std::endl;
+            assert(std::sqrt(diff) < 1e-10 * k);
+        }
+    }
+    Heisenberg.matrix_free = false;
+
+    // native kernel before and after the reverse Cuthill-McKee reordering
+    Heisenberg.generate_Ham_sparse_full(0, true, false);
+    for (std::string method : {"none", "rcm"}) {
+        Heisenberg.reorder_Ham_sparse(0, 0, method);
+        auto &H = Heisenberg.HamMat_csr_full[0];
+        auto &perm = Heisenberg.perm_full[0];
+        std::vector<std::complex<double>> xp(dim), yp(dim);
+        for (MKL_INT i = 0; i < dim; i++) xp[perm.empty() ? i : perm[i]] = x[i];
+        H.set_spmv("native");
+        H.MultMv(xp.data(), yp.data());                                      // warm up
+        std::chrono::time_point<std::chrono::system_clock> start, end;
+        start = std::chrono::system_clock::now();
+        for (int rep = 0; rep < n_rep; rep++) H.MultMv(xp.data(), yp.data());
+        end = std::chrono::system_clock::now();
+        std::chrono::duration<double> elapsed_seconds = end - start;
+        double diff = 0.0;
+        for (MKL_INT i = 0; i < dim; i++) diff += std::norm(yp[perm.empty() ? i : perm[i]] - y_ref[i]);
+        std::cout << std::endl << std::setw(10) << ("order " + method) << ": "
+                  << elapsed_seconds.count() / n_rep << "s per MultMv, |y - y_mkl_csrmv| = " << std::sqrt(diff) << std::endl;
+        assert(std::sqrt(diff) < 1e-10);
+    }
+    Heisenberg.reorder_Ham_sparse(0, 0, "none");
+
+    // one Lanczos step: separate BLAS passes vs the fused lanczos_step
+    Heisenberg.generate_Ham_sparse_full(0, true, false);
+    {
+        auto &H = Heisenberg.HamMat_csr_full[0];
+        H.set_spmv("native");
+        std::vector<std::complex<double>> v0(x), v1(dim), w(dim);
+        double nrm = qbasis::nrm2(dim, v0.data(), 1);
+        qbasis::scal(dim, 1.0 / nrm, v0.data(), 1);
+        qbasis::vec_randomize(dim, v1.data(), 2);
+        nrm = qbasis::nrm2(dim, v1.data(), 1);
+        qbasis::scal(dim, 1.0 / nrm, v1.data(), 1);
+        double b = 0.5, a_sep = 0.0, b_sep = 0.0, a_fus = 0.0, b_fus = 0.0;
+        for (bool fused : {false, true}) {
+            std::chrono::time_point<std::chrono::system_clock> start, end;
+            start = std::chrono::system_clock::now();
+            for (int rep = 0; rep < n_rep; rep++) {
+                w = v1;
+                if (fused) {
+                    double nv = 1.0;
+                    double w2 = H.lanczos_step(v0.data(), w.data(), b, a_fus);
+                    b_fus = qbasis::lanczos_step_normalize(dim, v0.data(), w.data(), a_fus, w2, nv);
+                } else {
+                    qbasis::scal(dim, -b, w.data(), 1);
+                    H.MultMv2(v0.data(), w.data());
+                    a_sep = std::real(qbasis::dotc(dim, v0.data(), 1, w.data(), 1));
+                    qbasis::axpy(dim, -a_sep, v0.data(), 1, w.data(), 1);
+                    b_sep = qbasis::nrm2(dim, w.data(), 1);
+                    qbasis::scal(dim, 1.0 / b_sep, w.data(), 1);
+                }
+            }
+            end = std::chrono::system_clock::now();
+            std::chrono::duration<double> elapsed_seconds = end - start;
+            std::cout << std::endl << std::setw(10) << (fused ? "fused" : "separate") << ": "
+                      << elapsed_seconds.count() / n_rep << "s per Lanczos step (copy included)" << std::endl;
+        }
+        std::cout << "|a_fused - a_separate| = " << std::abs(a_fus - a_sep)
+                  << ", |b_fused - b_separate| = " << std::abs(b_fus - b_sep) << std::endl;
+        assert(std::abs(a_fus - a_sep) < 1e-10 && std::abs(b_fus - b_sep) < 1e-10);
+        
+        // the fused step with the vectors stored in single precision
+        std::vector<std::complex<float>> v0_s(v0.begin(), v0.end()), v1_s(v1.begin(), v1.end()), w_s(dim);
+        double a_sgl = 0.0, b_sgl = 0.0;
+        std::chrono::time_point<std::chrono::system_clock> start, end;
+        start = std::chrono::system_clock::now();
+        for (int rep = 0; rep < n_rep; rep++) {
+            w_s = v1_s;
+            double nv = 1.0;
+            double w2 = H.lanczos_step(v0_s.data(), w_s.data(), b, a_sgl);
+            b_sgl = qbasis::lanczos_step_normalize(dim, v0_s.data(), w_s.data(), a_sgl, w2, nv);
+        }
+        end = std::chrono::system_clock::now();
+        std::chrono::duration<double> elapsed_seconds = end - start;
+        std::cout << std::endl << std::setw(10) << "single" << ": "
+                  << elapsed_seconds.count() / n_rep << "s per Lanczos step (copy included)" << std::endl;
+        std::cout << "|a_single - a_separate| = " << std::abs(a_sgl - a_sep)
+                  << ", |b_single - b_separate| = " << std::abs(b_sgl - b_sep) << std::endl;
+        assert(std::abs(a_sgl - a_sep) < 1e-5 && std::abs(b_sgl - b_sep) < 1e-5);
+    }
+
+    // ground state eigenvector after the Lanczos run for E0: CG vs replaying Lanczos vs stored Lanczos vectors
+    // (the latter also in single precision, refined with CG)
+    Heisenberg.generate_Ham_sparse_full(0, true, false);
+    {
+        std::vector<std::complex<double>> phi_cg;
+        std::vector<std::pair<std::string, bool>> runs{{"cg", false}, {"replay", false}, {"store", false},
+                                                        {"spill", false}, {"store", true}, {"spill", true}};
+        for (auto &run : runs) {
+            auto &method = run.first;
+            Heisenberg.mixed_precision = run.second;
+            std::chrono::time_point<std::chrono::system_clock> start, end;
+            start = std::chrono::system_clock::now();
+            Heisenberg.locate_E0_lanczos(0, 1, 1, 1000, method);
+            end = std::chrono::system_clock::now();
+            std::chrono::duration<double> elapsed_seconds = end - start;
+            auto &phi = Heisenberg.eigenvecs_full;
+            if (method == "cg") phi_cg = phi;
+            double overlap = std::abs(qbasis::dotc(dim, phi_cg.data(), 1, phi.data(), 1));
+            std::cout << std::endl << std::setw(10) << (run.second ? method + "/sgl" : method) << ": "
+                      << elapsed_seconds.count() << "s for E0 and phi, 1 - |(phi_cg, phi)| = " << 1.0 - overlap << std::endl;
+            assert(std::abs(overlap - 1.0) < 1e-8);
+        }
+        Heisenberg.mixed_precision = false;
+    }
+
+    // thread scaling of the native kernel with upper triangle storage
+#ifdef _OPENMP
+    Heisenberg.generate_Ham_sparse_full(0, true, false);
+    auto &H = Heisenberg.HamMat_csr_full[0];
+    H.set_spmv("native");
+    std::cout << std::endl << "Scaling of native kernel (upper triangle):" << std::endl;
+    double t1 = 0.0;
+    for (int nt = 1; nt <= 64; nt *= 2) {
+        omp_set_num_threads(nt);
+        H.MultMv(x.data(), y.data());                                        // warm up, re-partition
+        std::chrono::time_point<std::chrono::system_clock> start, end;
+        start = std::chrono::system_clock::now();
+        for (int rep = 0; rep < n_rep; rep++) H.MultMv(x.data(), y.data());
+        end = std::chrono::system_clock::now();
+        std::chrono::duration<double> elapsed_seconds = end - start;
+        if (nt == 1) t1 = elapsed_seconds.count();
+        std::cout << std::endl << std::setw(4) << nt << " threads: " << elapsed_seconds.count() / n_rep
+                  << "s per MultMv, speedup " << t1 / elapsed_seconds.count() << std::endl;
+    }
+#endif
+}
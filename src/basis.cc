@@ -25,7 +25,8 @@ namespace qbasis {
         } else {
             assert(false); // modify later
         }
-        
+        init_parity();
+        init_label();
     }
     
     basis_prop::basis_prop(const uint32_t &n_sites, const std::string &s, const extra_info &ex):
@@ -75,6 +76,96 @@ namespace qbasis {
         } else {
             assert(false); // modify later
         }
+        init_parity();
+        init_label();
+    }
+    
+    void basis_prop::init_parity()
+    {
+        parity_by_bits = true;
+        parity_mask    = 0;
+        parity_bytes.clear();
+        if (! q_fermion()) return;
+        
+        // look for a mask m, such that the parity of popcount(state & m) gives the fermion parity of state
+        parity_by_bits = false;
+        for (uint32_t m = 0; m < (1u << bits_per_site) && ! parity_by_bits; m++) {
+            bool match = true;
+            for (uint32_t state = 0; state < dim_local; state++) {
+                uint32_t cnt = 0;
+                for (uint32_t b = state & m; b > 0; b >>= 1) cnt += (b & 1);
+                if ((Nfermion_map[state] + cnt) % 2 != 0) {
+                    match = false;
+                    break;
+                }
+            }
+            if (match) {
+                parity_by_bits = true;
+                parity_mask = static_cast<uint8_t>(m);
+            }
+        }
+        if (! parity_by_bits || dilute) return;
+        
+        parity_bytes.assign(num_bytes, 0);
+        for (uint32_t site = 0; site < num_sites; site++) {
+            for (uint32_t b = 0; b < bits_per_site; b++) {
+                if (! ((parity_mask >> b) & 1)) continue;
+                uint32_t bit_pos = site * bits_per_site + b;
+                parity_bytes[bit_pos / 8] |= static_cast<uint8_t>(1 << (bit_pos % 8));
+            }
+        }
+    }
+    
+    // byte k of the orbital holds sites k*spb, ..., k*spb+spb-1, with spb = 8 / bits_per_site, so that:
+    // label   = sum_k label_table[byte_k]       * label_weight[k]
+    // label_1 = sum_k label_table[256+byte_k]   * label_weight[num_bytes+k]      (even sites)
+    // label_2 = sum_k label_table[512+byte_k]   * label_weight[2*num_bytes+k]    (odd sites)
+    // when dim_local is a power of 2, the tables for even/odd sites simply deinterleave the bits
+    void basis_prop::init_label()
+    {
+        label_table.clear();
+        label_weight.clear();
+        label_by_bytes = (! dilute && bits_per_site > 0 && 8 % bits_per_site == 0);
+        if (! label_by_bytes) return;
+        
+        uint32_t spb  = 8 / bits_per_site;                                      // sites per byte
+        uint8_t  mask = static_cast<uint8_t>((1 << bits_per_site) - 1);
+        label_table.assign(3 * 256, 0);
+        for (uint32_t v = 0; v < 256; v++) {
+            uint32_t full = 0, even = 0, odd = 0, pw = 1, pw_even = 1, pw_odd = 1;
+            for (uint32_t i = 0; i < spb; i++) {
+                uint32_t val = (v >> (i * bits_per_site)) & mask;
+                full += val * pw;
+                pw *= dim_local;
+                if (spb == 1) {                                                 // one site per byte, parity decided by weights
+                    even = odd = val;
+                } else if (i % 2 == 0) {
+                    even += val * pw_even;
+                    pw_even *= dim_local;
+                } else {
+                    odd += val * pw_odd;
+                    pw_odd *= dim_local;
+                }
+            }
+            label_table[v]       = static_cast<uint16_t>(full);
+            label_table[256 + v] = static_cast<uint16_t>(even);
+            label_table[512 + v] = static_cast<uint16_t>(odd);
+        }
+        
+        label_weight.assign(3 * num_bytes, 0);
+        for (uint32_t k = 0; k < num_bytes; k++) {
+            label_weight[k] = int_pow<uint32_t, uint64_t>(dim_local, k * spb);
+            if (spb == 1) {
+                if (k % 2 == 0) {
+                    label_weight[num_bytes + k]     = int_pow<uint32_t, uint64_t>(dim_local, k / 2);
+                } else {
+                    label_weight[2 * num_bytes + k] = int_pow<uint32_t, uint64_t>(dim_local, k / 2);
+                }
+            } else {
+                label_weight[num_bytes + k]     = int_pow<uint32_t, uint64_t>(dim_local, k * spb / 2);
+                label_weight[2 * num_bytes + k] = int_pow<uint32_t, uint64_t>(dim_local, k * spb / 2);
+            }
+        }
     }
     
     void basis_prop::split(basis_prop &sub1, basis_prop &sub2) const
@@ -95,6 +186,10 @@ namespace qbasis {
             sub2.bits_ignore = static_cast<uint8_t>(sub2.num_bytes * 8 - sub2.bits_per_site * sub2.num_sites);
             assert(sub1.num_sites + sub2.num_sites == num_sites);
         }
+        sub1.init_parity();
+        sub2.init_parity();
+        sub1.init_label();
+        sub2.init_label();
     }
     
     void basis_props_split(const std::vector<basis_prop> &parent,
@@ -122,7 +217,8 @@ namespace qbasis {
     {
         uint16_t total_bytes = 2; // first 2 bytes used for storing the length (in terms of bytes) of mbits
         for (decltype(props.size()) orb = 0; orb < props.size(); orb++) total_bytes += props[orb].num_bytes;
-        mbits = static_cast<uint8_t*>(malloc(total_bytes * sizeof(uint8_t)));
+        mbits = nullptr;
+        allocate(total_bytes);
         
         mbits[0] = total_bytes / 256;
         mbits[1] = total_bytes % 256;
@@ -131,14 +227,12 @@ namespace qbasis {
         for (uint16_t byte_pos = 2; byte_pos < total_bytes; byte_pos++) mbits[byte_pos] = 0;
     }
     
-    mbasis_elem::mbasis_elem(const mbasis_elem& old)
+    mbasis_elem::mbasis_elem(const mbasis_elem& old) : mbits(nullptr)
     {
         if (old.mbits != nullptr) {
             uint16_t total_bytes = static_cast<uint16_t>(old.mbits[0] * 256) + static_cast<uint16_t>(old.mbits[1]);
-            mbits = static_cast<uint8_t*>(malloc(total_bytes * sizeof(uint8_t)));
+            allocate(total_bytes);
             std::memcpy(mbits, old.mbits, total_bytes);
-        } else {
-            mbits = nullptr;
         }
 #ifdef DEBUG
 //        printf("copy from &mbits = %p  to  %p\n",static_cast<void*>(old.mbits),static_cast<void*>(mbits));
@@ -150,7 +244,13 @@ namespace qbasis {
 #ifdef DEBUG
 //        printf("move from &mbits = %p\n",static_cast<void*>(old.mbits));
 #endif
-        mbits = old.mbits;
+        if (old.q_inline()) {
+            uint16_t total_bytes = static_cast<uint16_t>(old.mbits[0] * 256) + static_cast<uint16_t>(old.mbits[1]);
+            std::memcpy(mbits_inline, old.mbits_inline, total_bytes);
+            mbits = mbits_inline;
+        } else {
+            mbits = old.mbits;
+        }
         old.mbits = nullptr;
     }
     
@@ -161,11 +261,21 @@ namespace qbasis {
 #endif
         if (mbits != nullptr)
         {
-            free(mbits);
+            if (! q_inline()) free(mbits);
             mbits = nullptr;
         }
     }
     
+    void mbasis_elem::allocate(const uint16_t &total_bytes)
+    {
+        if (mbits != nullptr && ! q_inline()) free(mbits);
+        if (total_bytes <= QBASIS_MBITS_INLINE) {
+            mbits = mbits_inline;
+        } else {
+            mbits = static_cast<uint8_t*>(malloc(total_bytes * sizeof(uint8_t)));
+        }
+    }
+    
     uint8_t mbasis_elem::siteRead(const std::vector<basis_prop> &props,
                                   const uint32_t &site, const uint32_t &orbital) const
     {
@@ -362,6 +472,30 @@ namespace qbasis {
         return true;
     }
     
+    int mbasis_elem::fermion_parity(const std::vector<basis_prop> &props, const uint32_t &site, const uint32_t &orbital) const
+    {
+        assert(orbital < props.size());
+        assert(site < props[orbital].num_sites);
+        uint64_t acc = 0;
+        int sgn = 0;
+        uint16_t byte_pos = 2;
+        for (uint32_t orb = 0; orb <= orbital; orb++) {
+            const auto &prop = props[orb];
+            if (prop.q_fermion()) {
+                uint32_t sites = (orb < orbital) ? prop.num_sites : site;
+                if (prop.parity_by_bits) {
+                    acc ^= masked_xor(mbits + byte_pos, prop.parity_bytes.data(), prop.bits_per_site * sites);
+                } else {
+                    for (uint32_t site_cnt = 0; site_cnt < sites; site_cnt++) {
+                        sgn = (sgn + prop.Nfermion_map[siteRead(props, site_cnt, orb)]) % 2;
+                    }
+                }
+            }
+            byte_pos += prop.num_bytes;
+        }
+        return (sgn + bit_parity(acc)) % 2;
+    }
+    
     uint64_t mbasis_elem::label(const std::vector<basis_prop> &props, const uint32_t &orbital,
                                 std::vector<uint8_t> &work) const
     {
@@ -376,6 +510,13 @@ namespace qbasis {
             for (uint16_t byte_pos = byte_pos_end - 1; byte_pos > byte_pos_bgn; byte_pos--)
                 res = (res + mbits[byte_pos]) * 256;
             res += mbits[byte_pos_bgn];
+        } else if (props[orbital].label_by_bytes) {
+            uint16_t byte_pos_bgn = 2;
+            for (uint32_t orb = 0; orb < orbital; orb++) byte_pos_bgn += props[orb].num_bytes;
+            const uint8_t *bits     = mbits + byte_pos_bgn;
+            const uint16_t *table   = props[orbital].label_table.data();
+            const uint64_t *weights = props[orbital].label_weight.data();
+            for (uint16_t k = 0; k < props[orbital].num_bytes; k++) res += table[bits[k]] * weights[k];
         } else {
             if (work.size() < num_sites + num_sites) work.resize(num_sites + num_sites);
             std::fill(work.begin(), work.end(), dim_local);
@@ -416,6 +557,22 @@ namespace qbasis {
         uint32_t num_sites_sub1 = (num_sites + 1) / 2;
         uint32_t num_sites_sub2 = num_sites - num_sites_sub1;
         
+        if (props[orbital].label_by_bytes) {
+            uint16_t byte_pos_bgn = 2;
+            for (uint32_t orb = 0; orb < orbital; orb++) byte_pos_bgn += props[orb].num_bytes;
+            uint16_t num_bytes      = props[orbital].num_bytes;
+            const uint8_t *bits     = mbits + byte_pos_bgn;
+            const uint16_t *table   = props[orbital].label_table.data();
+            const uint64_t *weights = props[orbital].label_weight.data();
+            label1 = 0;
+            label2 = 0;
+            for (uint16_t k = 0; k < num_bytes; k++) {
+                label1 += table[256 + bits[k]] * weights[num_bytes + k];
+                label2 += table[512 + bits[k]] * weights[2 * num_bytes + k];
+            }
+            return;
+        }
+        
         if (work.size() < num_sites + num_sites) work.resize(num_sites + num_sites);
         std::fill(work.begin(), work.end(), dim_local);
         uint8_t* nums_sub1 = work.data();
@@ -526,22 +683,43 @@ namespace qbasis {
     mbasis_elem &mbasis_elem::transform(const std::vector<basis_prop> &props,
                                         const std::vector<uint32_t> &plan, int &sgn,
                                         const uint32_t &orbital) {
+        assert(plan.size() == props[orbital].num_sites);
+        return transform(props, plan.data(), sgn, orbital);
+    }
+    
+    mbasis_elem &mbasis_elem::transform(const std::vector<basis_prop> &props,
+                                        const std::vector<uint32_t> &plan, int &sgn) {
+        for (uint32_t orb = 0; orb < props.size(); orb++) assert(plan.size() == props[orb].num_sites);
+        return transform(props, plan.data(), sgn);
+    }
+    
+    int mbasis_elem::transform_sign(const std::vector<basis_prop> &props,
+                                    const std::vector<uint32_t> &plan, const uint32_t &orbital) const
+    {
+        assert(plan.size() == props[orbital].num_sites);
+        return transform_sign(props, plan.data(), orbital);
+    }
+    
+    int mbasis_elem::transform_sign(const std::vector<basis_prop> &props,
+                                    const std::vector<uint32_t> &plan) const
+    {
+        for (uint32_t orb = 0; orb < props.size(); orb++) assert(plan.size() == props[orb].num_sites);
+        return transform_sign(props, plan.data());
+    }
+    
+    mbasis_elem &mbasis_elem::transform(const std::vector<basis_prop> &props,
+                                        const uint32_t *plan, int &sgn,
+                                        const uint32_t &orbital) {
         uint32_t total_sites = props[orbital].num_sites;
-        assert(plan.size() == total_sites);
-        if (! props[orbital].q_fermion()) {
-            sgn = 0;
-        } else {
-            std::vector<uint32_t> plan_fermion;
-            for (uint32_t site = 0; site < total_sites; site++) {
-                uint8_t state = siteRead(props, site, orbital);
-                // keeps all the sites which have fermion
-                if (props[orbital].Nfermion_map[state] % 2 != 0) plan_fermion.push_back(plan[site]);
-            }
-            // using bubble sort to count how many times we are exchanging fermions
-            sgn = bubble_sort(plan_fermion, 0, static_cast<int>(plan_fermion.size())) % 2;
+        sgn = transform_sign(props, plan, orbital);
+        // store the values (on stack for up to 256 sites)
+        uint8_t vals_stack[256];
+        std::vector<uint8_t> vals_heap;
+        uint8_t *vals = vals_stack;
+        if (total_sites > 256) {
+            vals_heap.resize(total_sites);
+            vals = vals_heap.data();
         }
-        // store the values
-        std::vector<uint8_t> vals(plan.size());
         for (decltype(total_sites) site = 0; site < total_sites; site++) {
             vals[site] = siteRead(props, site, orbital);
         }
@@ -553,7 +731,7 @@ namespace qbasis {
     }
     
     mbasis_elem &mbasis_elem::transform(const std::vector<basis_prop> &props,
-                                        const std::vector<uint32_t> &plan, int &sgn) {
+                                        const uint32_t *plan, int &sgn) {
         sgn = 0;
         for (uint32_t orb = 0; orb < props.size(); orb++) {
             int sgn0;
@@ -563,6 +741,46 @@ namespace qbasis {
         return *this;
     }
     
+    // the sign is the parity of the permutation restricted to the sites with odd number of fermions:
+    // sum over such sites (in order) of the number of previous targets larger than the current target,
+    // counted by the parity of the 1 bits in a bit set of visited targets
+    int mbasis_elem::transform_sign(const std::vector<basis_prop> &props,
+                                    const uint32_t *plan, const uint32_t &orbital) const
+    {
+        const auto &prop = props[orbital];
+        if (! prop.q_fermion()) return 0;
+        uint32_t total_sites = prop.num_sites;
+        
+        uint32_t num_words = (total_sites + 63) / 64;
+        uint64_t visited_stack[4] = {0, 0, 0, 0};
+        std::vector<uint64_t> visited_heap;
+        uint64_t *visited = visited_stack;
+        if (num_words > 4) {
+            visited_heap.resize(num_words, 0);
+            visited = visited_heap.data();
+        }
+        uint64_t acc = 0;
+        for (uint32_t site = 0; site < total_sites; site++) {
+            uint8_t state = siteRead(props, site, orbital);
+            bool odd = prop.parity_by_bits ? (bit_parity(state & prop.parity_mask) == 1) : (prop.Nfermion_map[state] % 2 != 0);
+            if (! odd) continue;
+            uint32_t word = plan[site] / 64;
+            uint32_t bit  = plan[site] % 64;
+            acc ^= (visited[word] & ~((static_cast<uint64_t>(2) << bit) - 1));   // visited targets > plan[site]
+            for (uint32_t w = word + 1; w < num_words; w++) acc ^= visited[w];
+            visited[word] |= (static_cast<uint64_t>(1) << bit);
+        }
+        return bit_parity(acc);
+    }
+    
+    int mbasis_elem::transform_sign(const std::vector<basis_prop> &props,
+                                    const uint32_t *plan) const
+    {
+        int sgn = 0;
+        for (uint32_t orb = 0; orb < props.size(); orb++) sgn ^= transform_sign(props, plan, orb);
+        return sgn;
+    }
+    
     mbasis_elem &mbasis_elem::transform(const std::vector<basis_prop> &props,
                                         const std::vector<std::vector<std::pair<uint32_t, uint32_t>>> &plan, int &sgn) {
         sgn = 0;
@@ -598,7 +816,6 @@ namespace qbasis {
             assert(latt.boundary()[j-1] == latt.boundary()[j]); // relax in future
         }
         std::vector<uint32_t> scratch_plan;
-        std::vector<int> scratch_coor, scratch_work;
         uint32_t total_sites    = props[0].num_sites;
         uint32_t total_orbitals = props.size();
         assert(latt.total_sites() == total_sites);
@@ -647,7 +864,7 @@ namespace qbasis {
                     disp[j] = static_cast<int>(linear_size[j]) - 1 - coor_smart[j];
                 auto state_new = *this;
                 int sgn;
-                latt.translation_plan(scratch_plan, disp, scratch_coor, scratch_work);
+                latt.translation_plan(scratch_plan, disp);
                 state_new.transform(props, scratch_plan, sgn);
                 if(state_new < state_min) {
                     state_min = state_new;
@@ -688,7 +905,7 @@ namespace qbasis {
                     disp_vec[dim]--;
                 }
             }
-            latt.translation_plan(scratch_plan, disp_vec, scratch_coor, scratch_work);
+            latt.translation_plan(scratch_plan, disp_vec);
             this->transform(props, scratch_plan, sgn);
         }
         return *this;
@@ -762,7 +979,23 @@ namespace qbasis {
     void swap(mbasis_elem &lhs, mbasis_elem &rhs)
     {
         using std::swap;
-        swap(lhs.mbits, rhs.mbits);
+        if (&lhs == &rhs) return;
+        bool lhs_inline = lhs.q_inline();
+        bool rhs_inline = rhs.q_inline();
+        if (lhs_inline || rhs_inline) {
+            uint8_t temp[QBASIS_MBITS_INLINE];
+            uint16_t lhs_bytes = lhs_inline ? static_cast<uint16_t>(lhs.mbits[0] * 256) + static_cast<uint16_t>(lhs.mbits[1]) : 0;
+            uint16_t rhs_bytes = rhs_inline ? static_cast<uint16_t>(rhs.mbits[0] * 256) + static_cast<uint16_t>(rhs.mbits[1]) : 0;
+            std::memcpy(temp, lhs.mbits_inline, lhs_bytes);
+            std::memcpy(lhs.mbits_inline, rhs.mbits_inline, rhs_bytes);
+            std::memcpy(rhs.mbits_inline, temp, lhs_bytes);
+            uint8_t *lhs_new = rhs_inline ? lhs.mbits_inline : rhs.mbits;
+            uint8_t *rhs_new = lhs_inline ? rhs.mbits_inline : lhs.mbits;
+            lhs.mbits = lhs_new;
+            rhs.mbits = rhs_new;
+        } else {
+            swap(lhs.mbits, rhs.mbits);
+        }
     }
     
     bool operator<(const mbasis_elem &lhs, const mbasis_elem &rhs)
@@ -802,7 +1035,6 @@ namespace qbasis {
             assert(latt.boundary()[j-1] == latt.boundary()[j]); // relax in future
         }
         std::vector<uint32_t> scratch_plan;
-        std::vector<int> scratch_coor, scratch_work;
         uint32_t total_sites    = props[0].num_sites;
         uint32_t total_orbitals = props.size();
         assert(latt.total_sites() == total_sites);
@@ -926,7 +1158,7 @@ namespace qbasis {
             if (flag) continue;
             auto rhs_new = rhs;
             int sgn;
-            latt.translation_plan(scratch_plan, disp, scratch_coor, scratch_work);
+            latt.translation_plan(scratch_plan, disp);
             rhs_new.transform(props, scratch_plan, sgn);
             if (lhs == rhs_new) return true;
         }
@@ -1368,7 +1600,6 @@ namespace qbasis {
         std::vector<uint32_t> disp(base.size());
         std::vector<int> disp2;
         std::vector<uint32_t> scratch_plan(latt.total_sites());
-        std::vector<int> scratch_coor(latt.dimension()), scratch_work(latt.dimension());
         
         for (uint64_t i = 0; i < dim_all; i++) {
             if (belong2rep[i] != unreachable) continue;          // already fixed
@@ -1390,7 +1621,7 @@ namespace qbasis {
                     }
                     auto basis_temp = basis_all[i];
                     int sgn;
-                    latt.translation_plan(scratch_plan, disp2, scratch_coor, scratch_work);
+                    latt.translation_plan(scratch_plan, disp2);
                     basis_temp.transform(props, scratch_plan, sgn);
                     uint64_t j = binary_search<mbasis_elem,uint64_t>(basis_all, basis_temp, 0, dim_all);
                     if (j < dim_all) {                          // found
@@ -1431,7 +1662,6 @@ namespace qbasis {
         #pragma omp parallel for schedule(dynamic,1)
         for (uint64_t j = 0; j < dim_repr; j++) {
             std::vector<uint32_t> scratch_plan(latt.total_sites());
-            std::vector<int> scratch_coor(latt.dimension()), scratch_work(latt.dimension());
             
             // loop over groups, to check which one the repr belongs to
             for (uint32_t g = 0; g < num_groups; g++) {
@@ -1442,7 +1672,7 @@ namespace qbasis {
                     int sgn;
                     for (uint32_t i = 0; i < dim; i++) disp[i] = groups[g].first[d][i];
                     auto basis_temp = reps[j];
-                    latt.translation_plan(scratch_plan, disp, scratch_coor, scratch_work);
+                    latt.translation_plan(scratch_plan, disp);
                     basis_temp.transform(props, scratch_plan, sgn);
                     if (basis_temp != reps[j]) {
                         flag = false;
@@ -1735,7 +1965,6 @@ namespace qbasis {
         }
         std::vector<uint32_t> plan_parent(latt_parent.total_sites());
         std::vector<uint32_t> plan_sub(latt_sub.total_sites());
-        std::vector<int> scratch_coor(latt_parent.dimension()), scratch_work(latt_parent.dimension());
         std::vector<uint8_t> scratch_work1;
         std::vector<uint64_t> scratch_work2;
         
@@ -1817,7 +2046,7 @@ namespace qbasis {
                         std::vector<int> disp_j_int(latt_sub_dim);
                         for (uint32_t j = 0; j < latt_sub_dim; j++) disp_j_int[j] = static_cast<int>(disp_j[j]);
                         int sgn;
-                        latt_sub.translation_plan(plan_sub, disp_j_int, scratch_coor, scratch_work);
+                        latt_sub.translation_plan(plan_sub, disp_j_int);
                         rb_new.transform(props_sub, plan_sub, sgn);                               // Tj |rb>
                         auto rb_new_label = rb_new.label(props_sub, scratch_work1, scratch_work2);
                         assert(basis_sub_repr[belong2rep[rb_new_label]] == rb);
@@ -1834,7 +2063,7 @@ namespace qbasis {
                             std::vector<int> disp_i_int(latt_sub_dim);
                             for (uint32_t j = 0; j < latt_sub_dim; j++) disp_i_int[j] = static_cast<int>(disp_i[j]);
                             auto Ti_ra_z_Tj_rb = ra_z_Tj_rb;
-                            latt_parent.translation_plan(plan_parent, disp_i_int, scratch_coor, scratch_work);
+                            latt_parent.translation_plan(plan_parent, disp_i_int);
                             Ti_ra_z_Tj_rb.transform(props_parent, plan_parent, sgn);                  // Ti (|ra> z Tj |rb>)
                             // now need find ja, jb
                             uint64_t state_sub1_label, state_sub2_label;
@@ -1878,7 +2107,7 @@ namespace qbasis {
                         std::vector<int> disp_j_int(latt_sub_dim);
                         for (uint32_t j = 0; j < latt_sub_dim; j++) disp_j_int[j] = static_cast<int>(disp_j[j]);
                         int sgn;
-                        latt_sub.translation_plan(plan_sub, disp_j_int, scratch_coor, scratch_work);
+                        latt_sub.translation_plan(plan_sub, disp_j_int);
                         rb_new.transform(props_sub, plan_sub, sgn);                               // Tj |rb>
                         auto rb_new_label = rb_new.label(props_sub, scratch_work1, scratch_work2);
                         assert(basis_sub_repr[belong2rep[rb_new_label]] == rb);
@@ -1895,7 +2124,7 @@ namespace qbasis {
                             std::vector<int> disp_i_int(latt_sub_dim);
                             for (uint32_t j = 0; j < latt_sub_dim; j++) disp_i_int[j] = static_cast<int>(disp_i[j]);
                             auto Ti_ra_z_Tj_rb = ra_z_Tj_rb;
-                            latt_parent.translation_plan(plan_parent, disp_i_int, scratch_coor, scratch_work);
+                            latt_parent.translation_plan(plan_parent, disp_i_int);
                             Ti_ra_z_Tj_rb.transform(props_parent, plan_parent, sgn);                  // Ti (|ra> z Tj |rb>)
                             // now need find ja, jb
                             uint64_t state_sub1_label, state_sub2_label;
@@ -1938,7 +2167,7 @@ namespace qbasis {
                         std::vector<int> disp_j_int(latt_sub_dim);
                         for (uint32_t j = 0; j < latt_sub_dim; j++) disp_j_int[j] = static_cast<int>(disp_j[j]);
                         int sgn;
-                        latt_sub.translation_plan(plan_sub, disp_j_int, scratch_coor, scratch_work);
+                        latt_sub.translation_plan(plan_sub, disp_j_int);
                         rb_new.transform(props_sub, plan_sub, sgn);                               // Tj |rb>
                         auto rb_new_label = rb_new.label(props_sub, scratch_work1, scratch_work2);
                         assert(basis_sub_repr[belong2rep[rb_new_label]] == rb);
@@ -1955,7 +2184,7 @@ namespace qbasis {
                             std::vector<int> disp_i_int(latt_sub_dim);
                             for (uint32_t j = 0; j < latt_sub_dim; j++) disp_i_int[j] = static_cast<int>(disp_i[j]);
                             auto Ti_ra_z_Tj_rb = ra_z_Tj_rb;
-                            latt_parent.translation_plan(plan_parent, disp_i_int, scratch_coor, scratch_work);
+                            latt_parent.translation_plan(plan_parent, disp_i_int);
                             Ti_ra_z_Tj_rb.transform(props_parent, plan_parent, sgn);              // Ti (|ra> z Tj |rb>)
                             // now need find ja, jb
                             uint64_t state_sub1_label, state_sub2_label;
@@ -2002,7 +2231,7 @@ namespace qbasis {
                         auto rb_new = examples[gb].back();
                         assert(ra < rb_new);
                         int sgn;
-                        latt_sub.translation_plan(plan_sub, disp_j_int, scratch_coor, scratch_work);
+                        latt_sub.translation_plan(plan_sub, disp_j_int);
                         rb_new.transform(props_sub, plan_sub, sgn);                               // Tj |rb>
                         mbasis_elem ra_z_Tj_rb;
                         zipper_basis(props_parent, props_sub, props_sub, ra, rb_new, ra_z_Tj_rb); // |ra> z Tj |rb>
@@ -2014,7 +2243,7 @@ namespace qbasis {
                                 std::vector<int> disp(latt_sub_dim);
                                 for (uint32_t i = 0; i < latt_sub_dim; i++) disp[i] = groups_parent[g].first[d][i];
                                 auto temp = ra_z_Tj_rb;
-                                latt_parent.translation_plan(plan_parent, disp, scratch_coor, scratch_work);
+                                latt_parent.translation_plan(plan_parent, disp);
                                 temp.transform(props_parent, plan_parent, sgn);
                                 if (temp != ra_z_Tj_rb) {
                                     flag = false;
@@ -2035,7 +2264,7 @@ namespace qbasis {
                         auto rb_new = examples[gb].front();
                         assert(ra == rb_new);
                         int sgn;
-                        latt_sub.translation_plan(plan_sub, disp_j_int, scratch_coor, scratch_work);
+                        latt_sub.translation_plan(plan_sub, disp_j_int);
                         rb_new.transform(props_sub, plan_sub, sgn);                               // Tj |rb>
                         mbasis_elem ra_z_Tj_rb;
                         zipper_basis(props_parent, props_sub, props_sub, ra, rb_new, ra_z_Tj_rb); // |ra> z Tj |rb>
@@ -2047,7 +2276,7 @@ namespace qbasis {
                                 std::vector<int> disp(latt_sub_dim);
                                 for (uint32_t i = 0; i < latt_sub_dim; i++) disp[i] = groups_parent[g].first[d][i];
                                 auto temp = ra_z_Tj_rb;
-                                latt_parent.translation_plan(plan_parent, disp, scratch_coor, scratch_work);
+                                latt_parent.translation_plan(plan_parent, disp);
                                 temp.transform(props_parent, plan_parent, sgn);
                                 if (temp != ra_z_Tj_rb) {
                                     flag = false;
@@ -2085,7 +2314,7 @@ namespace qbasis {
                         auto rb_new = examples[gb].front();
                         assert(rb_new < ra);
                         int sgn;
-                        latt_sub.translation_plan(plan_sub, disp_j_int, scratch_coor, scratch_work);
+                        latt_sub.translation_plan(plan_sub, disp_j_int);
                         rb_new.transform(props_sub, plan_sub, sgn);                               // Tj |rb>
                         mbasis_elem ra_z_Tj_rb;
                         zipper_basis(props_parent, props_sub, props_sub, ra, rb_new, ra_z_Tj_rb); // |ra> z Tj |rb>
@@ -2097,7 +2326,7 @@ namespace qbasis {
                                 std::vector<int> disp(latt_sub_dim);
                                 for (uint32_t i = 0; i < latt_sub_dim; i++) disp[i] = groups_parent[g].first[d][i];
                                 auto temp = ra_z_Tj_rb;
-                                latt_parent.translation_plan(plan_parent, disp, scratch_coor, scratch_work);
+                                latt_parent.translation_plan(plan_parent, disp);
                                 temp.transform(props_parent, plan_parent, sgn);
                                 if (temp != ra_z_Tj_rb) {
                                     flag = false;
@@ -2133,7 +2362,6 @@ namespace qbasis {
         uint32_t N   = latt_parent.total_sites();
         auto L       = latt_parent.Linear_size();
         std::vector<uint32_t> plan_parent(latt_parent.total_sites());
-        std::vector<int> scratch_work(latt_parent.dimension()), scratch_coor(latt_parent.dimension());
         
         std::vector<uint32_t> zerovec(dim,0);
         assert(std::any_of(group_parent.first.begin(), group_parent.first.end(), [zerovec](std::vector<uint32_t> i){ return i != zerovec; }));
@@ -2158,10 +2386,8 @@ namespace qbasis {
             if (! bosonic) {
                 std::vector<int> disp(dim);
                 for (uint32_t d_in = 0; d_in < dim; d_in++) disp[d_in] = static_cast<int>(xyz[d_in]);
-                int sgn;
-                auto basis_temp = repr;
-                latt_parent.translation_plan(plan_parent, disp, scratch_coor, scratch_work);
-                basis_temp.transform(props, plan_parent, sgn);
+                latt_parent.translation_plan(plan_parent, disp);
+                int sgn = repr.transform_sign(props, plan_parent);
                 numerator += static_cast<uint32_t>(sgn % 2) * N / 2;
             }
             
@@ -2199,7 +2425,7 @@ namespace qbasis {
             latt_parent.site2coor(disp, sub, site);
             
             auto basis_temp = repr;
-            latt_parent.translation_plan(plan_parent, disp, scratch_coor, scratch_work);
+            latt_parent.translation_plan(plan_parent, disp);
             basis_temp.transform(props, plan_parent, sgn);
             if (basis_temp != repr) continue;
             double exp_coef = 0.0;
@@ -2651,17 +2877,8 @@ namespace qbasis {
             // count # of fermions traversed by this operator
             int sgn = 0;
             if (lhs.fermion) {
-                for (uint32_t orb_cnt = 0; orb_cnt < lhs.orbital; orb_cnt++) {
-                    if (props[orb_cnt].q_fermion()) {
-                        for (uint32_t site_cnt = 0; site_cnt < props[orb_cnt].num_sites; site_cnt++) {
-                            sgn = (sgn + props[orb_cnt].Nfermion_map[rhs.first.siteRead(props, site_cnt, orb_cnt)]) % 2;
-                        }
-                    }
-                }
                 assert(props[lhs.orbital].q_fermion());
-                for (uint32_t site_cnt = 0; site_cnt < lhs.site; site_cnt++) {
-                    sgn = (sgn + props[lhs.orbital].Nfermion_map[rhs.first.siteRead(props, site_cnt, lhs.orbital)]) % 2;
-                }
+                sgn = rhs.first.fermion_parity(props, lhs.site, lhs.orbital);
             }
             
             // write down new elements in wavefunction
@@ -2718,17 +2935,8 @@ namespace qbasis {
             if (flag) return;                                     // the full column == 0
             int sgn = 0;
             if (lhs.fermion) {                                    // count # of fermions traversed by this operator
-                for (uint32_t orb_cnt = 0; orb_cnt < lhs.orbital; orb_cnt++) {
-                    if (props[orb_cnt].q_fermion()) {
-                        for (uint32_t site_cnt = 0; site_cnt < props[orb_cnt].num_sites; site_cnt++) {
-                            sgn = (sgn + props[orb_cnt].Nfermion_map[rhs.siteRead(props, site_cnt, orb_cnt)]) % 2;
-                        }
-                    }
-                }
                 assert(props[lhs.orbital].q_fermion());
-                for (uint32_t site_cnt = 0; site_cnt < lhs.site; site_cnt++) {
-                    sgn = (sgn + props[lhs.orbital].Nfermion_map[rhs.siteRead(props, site_cnt, lhs.orbital)]) % 2;
-                }
+                sgn = rhs.fermion_parity(props, lhs.site, lhs.orbital);
             }
             
             for (uint8_t row = 0; row < dim; row++) {
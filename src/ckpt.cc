@@ -171,6 +171,12 @@ namespace qbasis {
     template void ckpt_lanczos_init(MKL_INT &k, const MKL_INT &maxit, const MKL_INT &dim,
                                     int &cnt_accuE0, double &accuracy, double &theta0_prev, double &theta1_prev,
                                     std::complex<double> v[], double hessenberg[], const std::string &purpose);
+    template void ckpt_lanczos_init(MKL_INT &k, const MKL_INT &maxit, const MKL_INT &dim,
+                                    int &cnt_accuE0, double &accuracy, double &theta0_prev, double &theta1_prev,
+                                    float v[], double hessenberg[], const std::string &purpose);
+    template void ckpt_lanczos_init(MKL_INT &k, const MKL_INT &maxit, const MKL_INT &dim,
+                                    int &cnt_accuE0, double &accuracy, double &theta0_prev, double &theta1_prev,
+                                    std::complex<float> v[], double hessenberg[], const std::string &purpose);
     
     
     template <typename T>
@@ -264,7 +270,7 @@ namespace qbasis {
             if (! fs::exists(fs::path("out_Qckpt/HessenbergA.dat")))
                 vec_disk_write("out_Qckpt/HessenbergA.dat", maxit, hessenberg + maxit);
             if (! fs::exists(fs::path("out_Qckpt/HessenbergB.dat")))
-                vec_disk_write("out_Qckpt/HessenbergA.dat", maxit, hessenberg);
+                vec_disk_write("out_Qckpt/HessenbergB.dat", maxit, hessenberg);
             if (m > 0 && ! fs::exists(fs::path("out_Qckpt/lanczosV" + std::to_string(m-1) + ".dat")))
                 vec_disk_write("out_Qckpt/lanczosV" + std::to_string(m-1) + ".dat", dim, v + ((m-1)%2) * dim);
             vec_disk_write("out_Qckpt/lanczosV" + std::to_string(m) + ".dat", dim, v + (m%2) * dim);
@@ -299,6 +305,12 @@ namespace qbasis {
     template void ckpt_lanczos_update(const MKL_INT &m, const MKL_INT &maxit, const MKL_INT &dim,
                                       int &cnt_accuE0, double &accuracy, double &theta1_prev, double &theta_prev1,
                                       std::complex<double> v[], double hessenberg[], const std::string &purpose);
+    template void ckpt_lanczos_update(const MKL_INT &m, const MKL_INT &maxit, const MKL_INT &dim,
+                                      int &cnt_accuE0, double &accuracy, double &theta0_prev, double &theta_prev1,
+                                      float v[], double hessenberg[], const std::string &purpose);
+    template void ckpt_lanczos_update(const MKL_INT &m, const MKL_INT &maxit, const MKL_INT &dim,
+                                      int &cnt_accuE0, double &accuracy, double &theta0_prev, double &theta_prev1,
+                                      std::complex<float> v[], double hessenberg[], const std::string &purpose);
     
     void ckpt_lanczos_clean()
     {
@@ -424,6 +436,10 @@ namespace qbasis {
                                double v[], double r[], double p[]);
     template void ckpt_CG_init(MKL_INT &m, const MKL_INT &maxit, const MKL_INT &dim,
                                std::complex<double> v[], std::complex<double> r[], std::complex<double> p[]);
+    template void ckpt_CG_init(MKL_INT &m, const MKL_INT &maxit, const MKL_INT &dim,
+                               float v[], float r[], float p[]);
+    template void ckpt_CG_init(MKL_INT &m, const MKL_INT &maxit, const MKL_INT &dim,
+                               std::complex<float> v[], std::complex<float> r[], std::complex<float> p[]);
     
     template <typename T>
     void ckpt_CG_update(const MKL_INT &m, const MKL_INT &dim,
@@ -476,6 +492,10 @@ namespace qbasis {
                                  double v[], double r[], double p[]);
     template void ckpt_CG_update(const MKL_INT &m, const MKL_INT &dim,
                                  std::complex<double> v[], std::complex<double> r[], std::complex<double> p[]);
+    template void ckpt_CG_update(const MKL_INT &m, const MKL_INT &dim,
+                                 float v[], float r[], float p[]);
+    template void ckpt_CG_update(const MKL_INT &m, const MKL_INT &dim,
+                                 std::complex<float> v[], std::complex<float> r[], std::complex<float> p[]);
     
     void ckpt_CG_clean()
     {
@@ -512,4 +532,170 @@ namespace qbasis {
         fout << "Log end: " << date_and_time() << std::endl;
         fout.close();
     }
+    
+    
+    template <typename T>
+    void ckpt_trlan_init(MKL_INT &iter, MKL_INT &k, MKL_INT &nlock, const MKL_INT &dim, const MKL_INT &ncv,
+                         T v[], double tmat[])
+    {
+        assert(dim > 0 && ncv > 0);
+        if (! enable_ckpt) return;
+        fs::path outdir("out_Qckpt");
+        if (fs::exists(outdir)) {
+            if (! fs::is_directory(outdir)) {
+                fs::remove_all(outdir);
+                fs::create_directory(outdir);
+            }
+        } else {
+            fs::create_directory(outdir);
+        }
+        
+        std::ofstream fout("out_Qckpt/log_TRLan_ckpt.txt", std::ios::out | std::ios::app);
+        fout << std::endl << "Log start: " << date_and_time() << std::endl;
+        fout << "Initializing thick-restart Lanczos" << std::endl;
+        fout << "Current files on disk: " << std::endl;
+        for (auto &p : fs::directory_iterator("out_Qckpt")) fout << p << std::endl;
+        auto size_Qckpt1 = sizeof(MKL_INT);
+        bool updating = (fs::exists(fs::path("out_Qckpt/TRLan_updt.Qckpt1")) &&
+                         fs::file_size(fs::path("out_Qckpt/TRLan_updt.Qckpt1")) == size_Qckpt1) ? true : false;
+        
+        fout << "Resuming from an interrupted update? " << updating << std::endl;
+        if (updating) {
+            fout << "Cleaning up junks from last update." << std::endl;
+            bool finished = fs::exists(fs::path("out_Qckpt/TRLan_updt.Qckpt2"));  // if new data finished writing
+            std::vector<std::string> names_new;
+            for (auto &p : fs::directory_iterator("out_Qckpt")) {
+                auto name = p.path().filename().string();
+                if (std::regex_match(name, std::regex("TRLan_.+\\.dat\\.new"))) names_new.push_back(name);
+            }
+            for (auto &name : names_new) {
+                if (finished) {                                                  // then continue renaming
+                    auto name_old = name.substr(0, name.size() - 4);
+                    fs::remove(fs::path("out_Qckpt/" + name_old));
+                    fs::rename(fs::path("out_Qckpt/" + name), fs::path("out_Qckpt/" + name_old));
+                } else {                                                         // rewind to the last restart
+                    fs::remove(fs::path("out_Qckpt/" + name));
+                }
+            }
+            fs::remove(fs::path("out_Qckpt/TRLan_updt.Qckpt1"));
+            fs::remove(fs::path("out_Qckpt/TRLan_updt.Qckpt2"));
+        } else {
+            fs::remove(fs::path("out_Qckpt/TRLan_updt.Qckpt1"));
+            fs::remove(fs::path("out_Qckpt/TRLan_updt.Qckpt2"));
+        }
+        
+        iter  = 0;
+        k     = 0;
+        nlock = 0;
+        if (fs::exists(fs::path("out_Qckpt/TRLan_mlns.dat"))) {
+            std::ifstream fmlns("out_Qckpt/TRLan_mlns.dat", std::ios::in | std::ios::binary);
+            fmlns.read(reinterpret_cast<char*>(&iter), sizeof(MKL_INT));
+            fmlns.read(reinterpret_cast<char*>(&k), sizeof(MKL_INT));
+            fmlns.read(reinterpret_cast<char*>(&nlock), sizeof(MKL_INT));
+            fmlns.close();
+            assert(k < ncv && nlock <= k);
+            fout << "Loading thick-restart Lanczos data from disk (restart " << iter << ", k = " << k
+                 << ", nlock = " << nlock << ")..." << std::endl;
+            auto info = vec_disk_read("out_Qckpt/TRLan_T.dat", ncv * ncv, tmat);
+            assert(info == 0);
+            for (MKL_INT j = 0; j <= k; j++) {
+                fout << "out_Qckpt/TRLan_V" << j << ".dat" << std::endl;
+                info = vec_disk_read("out_Qckpt/TRLan_V" + std::to_string(j) + ".dat", dim,
+                                     v + static_cast<uint64_t>(dim) * j);
+                assert(info == 0);
+            }
+        }
+        fout << "Initializing/Resuming from restart " << iter << std::endl;
+        fout << "Log end: " << date_and_time() << std::endl << std::endl;
+        fout.close();
+    }
+    template void ckpt_trlan_init(MKL_INT &iter, MKL_INT &k, MKL_INT &nlock, const MKL_INT &dim, const MKL_INT &ncv,
+                                  double v[], double tmat[]);
+    template void ckpt_trlan_init(MKL_INT &iter, MKL_INT &k, MKL_INT &nlock, const MKL_INT &dim, const MKL_INT &ncv,
+                                  std::complex<double> v[], double tmat[]);
+    
+    template <typename T>
+    void ckpt_trlan_update(const MKL_INT &iter, const MKL_INT &k, const MKL_INT &nlock, const MKL_INT &dim,
+                           const MKL_INT &ncv, T v[], double tmat[])
+    {
+        if (! enable_ckpt) return;
+        fs::path outdir("out_Qckpt");
+        if (fs::exists(outdir)) {
+            if (! fs::is_directory(outdir)) {
+                fs::remove_all(outdir);
+                fs::create_directory(outdir);
+            }
+        } else {
+            fs::create_directory(outdir);
+        }
+        
+        std::ofstream fout("out_Qckpt/log_TRLan_ckpt.txt", std::ios::out | std::ios::app);
+        fout << std::endl << "Log start: " << date_and_time() << std::endl;
+        fout << "Updating thick-restart Lanczos, restart " << iter << ", k = " << k << ", nlock = " << nlock << std::endl;
+        
+        fs::remove(fs::path("out_Qckpt/TRLan_updt.Qckpt1"));
+        fs::remove(fs::path("out_Qckpt/TRLan_updt.Qckpt2"));
+        std::ofstream ftemp1("out_Qckpt/TRLan_updt.Qckpt1", std::ios::out | std::ios::binary);
+        ftemp1.write(reinterpret_cast<const char*>(&iter), sizeof(MKL_INT));
+        ftemp1.close();
+        
+        for (MKL_INT j = 0; j <= k; j++)
+            vec_disk_write("out_Qckpt/TRLan_V" + std::to_string(j) + ".dat.new", dim, v + static_cast<uint64_t>(dim) * j);
+        vec_disk_write("out_Qckpt/TRLan_T.dat.new", ncv * ncv, tmat);
+        std::ofstream f_mlns("out_Qckpt/TRLan_mlns.dat.new", std::ios::out | std::ios::binary);
+        f_mlns.write(reinterpret_cast<const char*>(&iter), sizeof(MKL_INT));
+        f_mlns.write(reinterpret_cast<const char*>(&k), sizeof(MKL_INT));
+        f_mlns.write(reinterpret_cast<const char*>(&nlock), sizeof(MKL_INT));
+        f_mlns.close();
+        
+        // before/after this point, have to use old/new data
+        fs::copy(fs::path("out_Qckpt/TRLan_updt.Qckpt1"), fs::path("out_Qckpt/TRLan_updt.Qckpt2"));
+        
+        // new data fully written, replace the old ones
+        for (MKL_INT j = 0; j <= k; j++) {
+            fs::remove(fs::path("out_Qckpt/TRLan_V" + std::to_string(j) + ".dat"));
+            fs::rename(fs::path("out_Qckpt/TRLan_V" + std::to_string(j) + ".dat.new"),
+                       fs::path("out_Qckpt/TRLan_V" + std::to_string(j) + ".dat"));
+        }
+        MKL_INT j = k + 1;
+        while (fs::exists(fs::path("out_Qckpt/TRLan_V" + std::to_string(j) + ".dat"))) {
+            fs::remove(fs::path("out_Qckpt/TRLan_V" + std::to_string(j) + ".dat"));
+            j++;
+        }
+        fs::remove(fs::path("out_Qckpt/TRLan_T.dat"));
+        fs::rename(fs::path("out_Qckpt/TRLan_T.dat.new"), fs::path("out_Qckpt/TRLan_T.dat"));
+        fs::remove(fs::path("out_Qckpt/TRLan_mlns.dat"));
+        fs::rename(fs::path("out_Qckpt/TRLan_mlns.dat.new"), fs::path("out_Qckpt/TRLan_mlns.dat"));
+        
+        fs::remove(fs::path("out_Qckpt/TRLan_updt.Qckpt1"));
+        fs::remove(fs::path("out_Qckpt/TRLan_updt.Qckpt2"));
+        fout << "Files after updating: " << std::endl;
+        for (auto &p : fs::directory_iterator("out_Qckpt")) fout << p << std::endl;
+        fout << "Log end: " << date_and_time() << std::endl << std::endl;
+        fout.close();
+    }
+    template void ckpt_trlan_update(const MKL_INT &iter, const MKL_INT &k, const MKL_INT &nlock, const MKL_INT &dim,
+                                    const MKL_INT &ncv, double v[], double tmat[]);
+    template void ckpt_trlan_update(const MKL_INT &iter, const MKL_INT &k, const MKL_INT &nlock, const MKL_INT &dim,
+                                    const MKL_INT &ncv, std::complex<double> v[], double tmat[]);
+    
+    void ckpt_trlan_clean()
+    {
+        if (! enable_ckpt) return;
+        fs::path outdir("out_Qckpt");
+        if (! fs::exists(outdir) || ! fs::is_directory(outdir)) return;
+        
+        std::ofstream fout("out_Qckpt/log_TRLan_ckpt.txt", std::ios::out | std::ios::app);
+        fout << std::endl << "Log start: " << date_and_time() << std::endl;
+        fout << "Cleaning up thick-restart Lanczos..." << std::endl;
+        for (auto &p : fs::directory_iterator("out_Qckpt"))
+        {
+            if (std::regex_match(p.path().filename().string(), std::regex("TRLan_.+\\.dat(\\.new)?"))) fs::remove(p.path());
+        }
+        fout << "Current files after clean: " << std::endl;
+        for (auto &p : fs::directory_iterator("out_Qckpt")) fout << p << std::endl;
+        
+        fout << "Log end: " << date_and_time() << std::endl;
+        fout.close();
+    }
 }
@@ -21,20 +21,12 @@ namespace qbasis {
         
         vec_randomize(dim, vpt[0]);
         for (MKL_INT j = 0; j < dim; j++) vpt[1][j] = static_cast<T>(0.0);       // v[1] = 0
-        mat.MultMv2(vpt[0], vpt[1]);                                             // v[1] = H * v[0] + v[1]
-        Hessenberg[iters] = std::real(dotc(dim, vpt[0], 1, vpt[1], 1));          // a[0] = (v[0], v[1])
-        axpy(dim, -Hessenberg[iters], vpt[0], 1, vpt[1], 1);                     // v[1] = v[1] - a[0] * v[0]
-        Hessenberg[1] = nrm2(dim, vpt[1], 1);                                    // b[1] = || v[1] ||
-        scal(dim, 1.0 / Hessenberg[1], vpt[1], 1);                               // v[1] = v[1] / b[1]
         
-        for (MKL_INT m = 2; m <= mm; m++) {
-            for (MKL_INT l = 0; l < dim; l++)
-                vpt[m][l] = -Hessenberg[m-1] * vpt[m-2][l];                      // v[m] = -b[m-1] * v[m-2]
-            mat.MultMv2(vpt[m-1], vpt[m]);                                       // v[m] = H * v[m-1] + v[m]
-            Hessenberg[iters+m-1] = std::real(dotc(dim, vpt[m-1], 1, vpt[m], 1));// a[m-1] = (v[m-1], v[m])
-            axpy(dim, -Hessenberg[iters+m-1], vpt[m-1], 1, vpt[m], 1);           // v[m] = v[m] - a[m-1] * v[m-1]
-            Hessenberg[m] = nrm2(dim, vpt[m], 1);                                // b[m] = || v[m] ||
-            scal(dim, 1.0 / Hessenberg[m], vpt[m], 1);                           // v[m] = v[m] / b[m]
+        double nv = 1.0;
+        for (MKL_INT m = 1; m <= mm; m++) {                                      // see lanczos
+            auto &a = Hessenberg[iters+m-1];
+            double w2 = mat.lanczos_step(vpt[m-1], vpt[m], Hessenberg[m-1], a);  // v[m] = H * v[m-1] - b[m-1] * v[m-2]
+            Hessenberg[m] = lanczos_step_normalize(dim, vpt[m-1], vpt[m], a, w2, nv);
         }
         hess_eigen(Hessenberg.data(), iters, mm, "sr", ritz, s);                 // calculate {theta, s}
         
@@ -58,5 +50,11 @@ namespace qbasis {
     template void energy_scale(const MKL_INT &dim, const model<std::complex<double>> &mat,
                                std::complex<double> v[], double &lo, double &hi,
                                const double &extend, const MKL_INT &iters);
+    template void energy_scale(const MKL_INT &dim, const csr_mat<double> &mat,
+                               float v[], double &lo, double &hi,
+                               const double &extend, const MKL_INT &iters);
+    template void energy_scale(const MKL_INT &dim, const csr_mat<std::complex<double>> &mat,
+                               std::complex<float> v[], double &lo, double &hi,
+                               const double &extend, const MKL_INT &iters);
     
 }
@@ -1,6 +1,9 @@
 #include <algorithm>
 #include <iostream>
 #include <iomanip>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include "qbasis.h"
 #include "areig.h"
 namespace qbasis {
@@ -18,6 +21,16 @@ namespace qbasis {
     
     
     
+    template <typename T>
+    void ckpt_trlan_init(MKL_INT &iter, MKL_INT &k, MKL_INT &nlock, const MKL_INT &dim, const MKL_INT &ncv,
+                         T v[], double tmat[]);
+    
+    template <typename T>
+    void ckpt_trlan_update(const MKL_INT &iter, const MKL_INT &k, const MKL_INT &nlock, const MKL_INT &dim,
+                           const MKL_INT &ncv, T v[], double tmat[]);
+    
+    void ckpt_trlan_clean();
+    
     template <typename T>
     void ckpt_CG_init(MKL_INT &m, const MKL_INT &maxit, const MKL_INT &dim, T v[], T r[], T p[]);
     
@@ -52,27 +65,100 @@ namespace qbasis {
         fout.close();
     }
     
+    template <typename T, typename MAT>
+    double lanczos_step_generic(const MKL_INT &dim, const MAT &mat, const T v[], T w[], const double &b, double &a)
+    {
+        scal(dim, -b, w, 1);                                                     // w = -b * w
+        mat.MultMv2(v, w);                                                       // w = H * v + w
+        double dot = 0.0, nrm = 0.0;
+        #pragma omp parallel for reduction(+:dot,nrm)
+        for (MKL_INT l = 0; l < dim; l++) {
+            dot += std::real(conjugate(v[l]) * w[l]);
+            nrm += std::norm(w[l]);
+        }
+        a = dot;
+        return nrm;
+    }
+    template double lanczos_step_generic(const MKL_INT &dim, const csr_mat<double> &mat,
+                                         const double v[], double w[], const double &b, double &a);
+    template double lanczos_step_generic(const MKL_INT &dim, const csr_mat<std::complex<double>> &mat,
+                                         const std::complex<double> v[], std::complex<double> w[], const double &b, double &a);
+    template double lanczos_step_generic(const MKL_INT &dim, const model<std::complex<double>> &mat,
+                                         const std::complex<double> v[], std::complex<double> w[], const double &b, double &a);
+    
+    
+    template <typename T>
+    double lanczos_step_finish(const MKL_INT &dim, const T v[], T w[], const double &a, const double &b)
+    {
+        typedef typename precision_policy<T>::wide W;                           // single precision: rounded only when stored
+        double b_inv = 1.0 / b;
+        double nrm = 0.0;
+        #pragma omp parallel for reduction(+:nrm)
+        for (MKL_INT l = 0; l < dim; l++) {
+            W u = static_cast<W>(w[l]) - a * static_cast<W>(v[l]);
+            nrm += std::norm(u);
+            w[l] = static_cast<T>(b_inv * u);
+        }
+        return std::sqrt(nrm);
+    }
+    template double lanczos_step_finish(const MKL_INT &dim, const double v[], double w[], const double &a, const double &b);
+    template double lanczos_step_finish(const MKL_INT &dim, const std::complex<double> v[], std::complex<double> w[],
+                                        const double &a, const double &b);
+    template double lanczos_step_finish(const MKL_INT &dim, const float v[], float w[], const double &a, const double &b);
+    template double lanczos_step_finish(const MKL_INT &dim, const std::complex<float> v[], std::complex<float> w[],
+                                        const double &a, const double &b);
+    
+    
+    template <typename T>
+    double lanczos_step_normalize(const MKL_INT &dim, const T v[], T w[], const double &a, const double &w2, double &nv)
+    {
+        // || w - a * v ||^2 = (w, w) - a^2 * (2 - (v, v)), trusted only without severe cancellation,
+        // otherwise w - a * v is computed first (the division by 1 being exact), and rescaled afterwards
+        double b2 = w2 - a * a * (2.0 - nv);
+        double b = (b2 > 1e-2 * w2) ? std::sqrt(b2) : 1.0;
+        double b_true = lanczos_step_finish(dim, v, w, a, b);
+        if (b != b_true && std::abs(b_true - b) > 0.1 * precision_policy<T>::tol() * b_true) {
+            // the replay of this step in lanczos() divides by b_true directly, so the two agree only up to round-off
+            scal(dim, b / b_true, w, 1);
+            b = b_true;
+        }
+        nv = (b_true / b) * (b_true / b);
+        return b;
+    }
+    template double lanczos_step_normalize(const MKL_INT &dim, const double v[], double w[],
+                                           const double &a, const double &w2, double &nv);
+    template double lanczos_step_normalize(const MKL_INT &dim, const std::complex<double> v[], std::complex<double> w[],
+                                           const double &a, const double &w2, double &nv);
+    template double lanczos_step_normalize(const MKL_INT &dim, const float v[], float w[],
+                                           const double &a, const double &w2, double &nv);
+    template double lanczos_step_normalize(const MKL_INT &dim, const std::complex<float> v[], std::complex<float> w[],
+                                           const double &a, const double &w2, double &nv);
+    
+    
     // need further classification:
     // 1. ask lanczos to restart with a new linearly independent vector when v_m+1 = 0
     // 2. add DGKS re-orthogonalization (when purpose == iram)
     // 3. add partial and selective re-orthogonalization
     template <typename T, typename MAT>
     void lanczos(MKL_INT k, MKL_INT np, const MKL_INT &maxit, MKL_INT &m, const MKL_INT &dim,
-                 const MAT &mat, T v[], double hessenberg[], const std::string &purpose)
+                 const MAT &mat, T v[], double hessenberg[], const std::string &purpose,
+                 krylov_basis<T> *basis)
     {
         auto &npos = std::string::npos;
         MKL_INT mm = k + np;
         double theta0_prev, theta1_prev;                                         // record Ritz values from last step
         int cnt_accuE0 = 0;
         double accuracy;
+        const double tol = precision_policy<T>::tol();                           // lanczos_precision, unless stored in single precision
         
         ckpt_lanczos_init(k, maxit, dim, cnt_accuE0, accuracy, theta0_prev, theta1_prev, v, hessenberg, purpose);
         m = k;
         np = mm - k;
         assert(mm < maxit && k >= 0 && np >= 0);
         assert(purpose != "iram" || mm < dim);                                   // # of orthogonal vectors: at most dim
-        if ( cnt_accuE0 > 15 && accuracy < lanczos_precision) return;
+        if ( cnt_accuE0 > 15 && accuracy < tol) return;
         if (np == 0) return;
+        if (k > 0 || purpose.find("val") == npos) basis = nullptr;               // resumed: earlier vectors lost
         
         T zero = static_cast<T>(0.0);
         std::vector<T*> vpt(mm+1);                                               // pointers of v[0],v[1],...,v[m]
@@ -86,69 +172,62 @@ namespace qbasis {
         }
         
         std::vector<double> ritz(mm), s(mm * mm);                                // Ritz values and eigenvecs of Hess
-        if (purpose.find("vec") != npos) hess_eigen(hessenberg, maxit, mm, "sr", ritz, s);
+        if (purpose.find("vec") != npos) hess_eigen(hessenberg, maxit, mm + 1, "sr", ritz, s); // v[0], ..., v[mm]
+        
+        assert(std::abs(nrm2(dim, vpt[k], 1) - 1.0) < tol);                      // v[k] should be normalized
+        bool fill_hess = (purpose == "iram" || purpose.find("val") != npos || purpose == "dnmcs");
+        assert(fill_hess || purpose.find("vec") != npos);
+        // v[m] = (H * v[m-1] - a[m-1] * v[m-1] - b[m-1] * v[m-2]) / b[m], in two sweeps (see MAT::lanczos_step)
+        // except for iram, v[m] and v[m-2] share the storage
+        double nv = 1.0;                                                         // (v[m], v[m]), up to round-off
+        auto recurrence = [&](const MKL_INT &j) {
+            if (purpose == "iram" && j > 1) copy(dim, vpt[j-2], 1, vpt[j], 1);
+            double a;
+            double w2 = mat.lanczos_step(vpt[j-1], vpt[j], hessenberg[j-1], a);  // v[j] = H * v[j-1] - b[j-1] * v[j-2]
+            if (fill_hess) {
+                hessenberg[maxit+j-1] = a;                                       // a[j-1] = (v[j-1], v[j])
+                // v[j] = (v[j] - a[j-1] * v[j-1]) / b[j]
+                hessenberg[j] = lanczos_step_normalize(dim, vpt[j-1], vpt[j], a, w2, nv);
+            } else {                                                             // replay with the stored a, b (equal up to round-off)
+                assert(std::abs(hessenberg[maxit+j-1] - a) < tol);
+                double b = lanczos_step_finish(dim, vpt[j-1], vpt[j], hessenberg[maxit+j-1], hessenberg[j]);
+                assert(std::abs(hessenberg[j] - b) < tol);
+            }
+        };
         
-        assert(std::abs(nrm2(dim, vpt[k], 1) - 1.0) < lanczos_precision);        // v[k] should be normalized
         if (k == 0) {                                                            // prepare 2 vectors to start
             hessenberg[0] = 0.0;
             for (MKL_INT l = 0; l < dim; l++) vpt[1][l] = zero;                  // v[1] = 0
-            mat.MultMv2(vpt[0], vpt[1]);                                         // v[1] = H * v[0] + v[1]
-            if (purpose == "iram" || purpose.find("val") != npos || purpose == "dnmcs") {
-                hessenberg[maxit] = std::real(dotc(dim, vpt[0], 1, vpt[1], 1));  // a[0] = (v[0], v[1])
-            } else if (purpose.find("vec") != npos) {
-                assert(std::abs(hessenberg[maxit] - std::real(dotc(dim, vpt[0], 1, vpt[1], 1))) < lanczos_precision);
-            } else {
-                assert(false);
-            }
-            axpy(dim, -hessenberg[maxit], vpt[0], 1, vpt[1], 1);                 // v[1] = v[1] - a[0] * v[0]
-            if (purpose == "iram" || purpose.find("val") != npos || purpose == "dnmcs") {
-                hessenberg[1] = nrm2(dim, vpt[1], 1);                            // b[1] = || v[1] ||
-            } else if (purpose.find("vec") != npos) {
-                assert(std::abs(hessenberg[1] - nrm2(dim, vpt[1], 1)) < lanczos_precision);
-            } else {
-                assert(false);
+            if (purpose.find("vec") != npos) {                                   // y = s[0] * v[0]
+                copy(dim, vpt[0], 1, ypt, 1);
+                scal(dim, s[0], ypt, 1);
             }
-            scal(dim, 1.0 / hessenberg[1], vpt[1], 1);                           // v[1] = v[1] / b[1]
+            if (basis != nullptr) basis->push(vpt[0]);
+            recurrence(1);
+            if (basis != nullptr) basis->push(vpt[1]);
             m = ++k;
             --np;
             if (purpose.find("vec") != npos) axpy(dim, s[m], vpt[m], 1, ypt, 1); // y += s[m] * v[m]
             ckpt_lanczos_update(m, maxit, dim, cnt_accuE0, accuracy, theta0_prev, theta1_prev, v, hessenberg, purpose);
         }
         
-        do {                                                                     // while m < mm
+        while (m < mm) {
             m++;
-            for (MKL_INT l = 0; l < dim; l++)
-                vpt[m][l] = -hessenberg[m-1] * vpt[m-2][l];                      // v[m] = -b[m-1] * v[m-2]
-            mat.MultMv2(vpt[m-1], vpt[m]);                                       // v[m] = H * v[m-1] + v[m]
+            recurrence(m);
             
-            if (purpose == "iram" || purpose.find("val") != npos || purpose == "dnmcs") {
-                hessenberg[maxit+m-1] = std::real(dotc(dim, vpt[m-1], 1, vpt[m], 1)); // a[m-1] = (v[m-1], v[m])
-            } else if (purpose.find("vec") != npos) {
-                assert(std::abs(hessenberg[maxit+m-1] - std::real(dotc(dim, vpt[m-1], 1, vpt[m], 1))) < lanczos_precision);
-            } else {
-                assert(false);
-            }
-            axpy(dim, -hessenberg[maxit+m-1], vpt[m-1], 1, vpt[m], 1);           // v[m] = v[m] - a[m-1] * v[m-1]
-            if (purpose == "iram" || purpose.find("val") != npos || purpose == "dnmcs") {
-                hessenberg[m] = nrm2(dim, vpt[m], 1);                            // b[m] = || v[m] ||
-            } else if (purpose.find("vec") != npos) {
-                assert(std::abs(hessenberg[m] - nrm2(dim, vpt[m], 1)) < lanczos_precision);
-            } else {
-                assert(false);
-            }
-            scal(dim, 1.0 / hessenberg[m], vpt[m], 1);                           // v[m] = v[m] / b[m]
-            
-            if (std::abs(hessenberg[m]) < lanczos_precision) break;
+            if (std::abs(hessenberg[m]) < tol) break;
             
             if (purpose.find("val1") != npos || purpose.find("vec1") != npos) {  // re-orthogonalization again phi0
                 auto temp = dotc(dim, phipt, 1, vpt[m], 1);
-                if (std::abs(temp) > lanczos_precision) {
+                if (std::abs(temp) > tol) {
                     std::cout << "-" << std::flush;
-                    axpy(dim, -temp, phipt, 1, vpt[m], 1);
+                    axpy(dim, static_cast<T>(-temp), phipt, 1, vpt[m], 1);
                     double rnorm = nrm2(dim, vpt[m], 1);
                     scal(dim, 1.0 / rnorm, vpt[m], 1);
+                    nv = 1.0;
                 }
             }
+            if (basis != nullptr) basis->push(vpt[m]);
             
             if (purpose.find("val") != npos) {
                 hess_eigen(hessenberg, maxit, m, "sr", ritz, s);                  // calculate {theta, s}
@@ -157,12 +236,12 @@ namespace qbasis {
                     double accu_E0  = std::abs((ritz[0] - theta0_prev) / ritz[0]);
                     double accu_E1  = std::abs((ritz[1] - theta1_prev) / ritz[1]);
                     log_Lanczos_srval(m, ritz, hessenberg, maxit, accuracy, accu_E0, accu_E1, "log_Lanczos_"+purpose+".txt");
-                    if (accu_E0 < lanczos_precision) {
+                    if (accu_E0 < tol) {
                         cnt_accuE0++;
                     } else {
                         cnt_accuE0 = 0;
                     }
-                    if ( cnt_accuE0 > 15 && accuracy < lanczos_precision)
+                    if ( cnt_accuE0 > 15 && accuracy < tol)
                     {
                         ckpt_lanczos_update(m, maxit, dim, cnt_accuE0, accuracy, theta0_prev, theta1_prev, v, hessenberg, purpose);
                         break;
@@ -179,30 +258,117 @@ namespace qbasis {
                 for (MKL_INT l = 0; l < m-1; l++) {
                     auto q = dotc(dim, vpt[l], 1, vpt[m], 1);
                     double qabs = std::abs(q);
-                    if (qabs > lanczos_precision) {
-                        axpy(dim, -q, vpt[l], 1, vpt[m], 1);
+                    if (qabs > tol) {
+                        axpy(dim, static_cast<T>(-q), vpt[l], 1, vpt[m], 1);
                         scal(dim, 1.0 / std::sqrt(1.0 - qabs * qabs), vpt[m], 1);
+                        nv = 1.0;
                     }
                 }
             }
             ckpt_lanczos_update(m, maxit, dim, cnt_accuE0, accuracy, theta0_prev, theta1_prev, v, hessenberg, purpose);
-        } while (m < mm);
+        }
         std::cout << std::endl;
     }
     template void lanczos(MKL_INT k, MKL_INT np, const MKL_INT &maxit, MKL_INT &m, const MKL_INT &dim,
                           const csr_mat<double> &mat, double v[],
-                          double hessenberg[], const std::string &purpose);
+                          double hessenberg[], const std::string &purpose, krylov_basis<double> *basis);
     template void lanczos(MKL_INT k, MKL_INT np, const MKL_INT &maxit, MKL_INT &m, const MKL_INT &dim,
                           const csr_mat<std::complex<double>> &mat, std::complex<double> v[],
-                          double hessenberg[], const std::string &purpose);
+                          double hessenberg[], const std::string &purpose, krylov_basis<std::complex<double>> *basis);
     template void lanczos(MKL_INT k, MKL_INT np, const MKL_INT &maxit, MKL_INT &m, const MKL_INT &dim,
                           const model<std::complex<double>> &mat, std::complex<double> v[],
-                          double hessenberg[], const std::string &purpose);
+                          double hessenberg[], const std::string &purpose, krylov_basis<std::complex<double>> *basis);
+    template void lanczos(MKL_INT k, MKL_INT np, const MKL_INT &maxit, MKL_INT &m, const MKL_INT &dim,
+                          const csr_mat<double> &mat, float v[],
+                          double hessenberg[], const std::string &purpose, krylov_basis<float> *basis);
+    template void lanczos(MKL_INT k, MKL_INT np, const MKL_INT &maxit, MKL_INT &m, const MKL_INT &dim,
+                          const csr_mat<std::complex<double>> &mat, std::complex<float> v[],
+                          double hessenberg[], const std::string &purpose, krylov_basis<std::complex<float>> *basis);
 //    template void lanczos(MKL_INT k, MKL_INT np, MKL_INT &mm, const MKL_INT &dim,
 //                          const model<double> &mat, double v[],
 //                          double hessenberg[], const MKL_INT &ldh, const std::string &purpose);
     
     
+    template <typename T>
+    krylov_basis<T>::krylov_basis(const MKL_INT &dim_, const MKL_INT &nvec_, const std::string &file, const bool &single_) :
+        dim(dim_), nvec(nvec_), single(single_), name(file)
+    {
+        assert(dim > 0 && nvec >= 0);
+        if (nvec == 0) return;
+        len = (single ? sizeof(S) : sizeof(T)) * static_cast<uint64_t>(dim) * static_cast<uint64_t>(nvec);
+        void *p;
+        if (name.empty()) {
+            p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        } else {
+            int fd = open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) std::cout << "Cannot open " << name << std::endl;
+            assert(fd >= 0);
+            int info = ftruncate(fd, static_cast<off_t>(len));                  // sparse, blocks allocated when written
+            assert(info == 0);
+            p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+        }
+        assert(p != MAP_FAILED);
+        addr = p;
+        if (! name.empty()) madvise(p, len, MADV_SEQUENTIAL);                    // written and read back in order
+        std::cout << "Lanczos vectors kept in " << (name.empty() ? std::string("memory") : name)
+                  << " (room for " << nvec << (single ? ", single precision" : "") << ")" << std::endl;
+    }
+    
+    template <typename T>
+    krylov_basis<T>::~krylov_basis()
+    {
+        if (addr == nullptr) return;
+        munmap(addr, len);
+        if (! name.empty()) fs::remove(fs::path(name));
+    }
+    
+    template <typename T>
+    void krylov_basis<T>::push(const T v[])
+    {
+        if (cnt >= nvec) return;
+        auto pos = static_cast<uint64_t>(cnt) * dim;
+        if (single) {
+            S *dst = static_cast<S*>(addr) + pos;
+            #pragma omp parallel for schedule(static)
+            for (MKL_INT l = 0; l < dim; l++) dst[l] = static_cast<S>(v[l]);
+        } else {
+            copy(dim, v, 1, static_cast<T*>(addr) + pos, 1);
+        }
+        cnt++;
+    }
+    
+    template <typename T>
+    void krylov_basis<T>::combine(const MKL_INT &m, const double s[], T y[]) const
+    {
+        assert(m > 0 && m <= cnt);
+        if (! single) {
+            std::vector<T> coef(s, s + m);
+            gemm('N', 'N', dim, 1, m, static_cast<T>(1.0), static_cast<const T*>(addr), dim,
+                 coef.data(), m, static_cast<T>(0.0), y, dim);
+            return;
+        }
+        // blocks of rows, each vector read sequentially within a block, y accumulated in double
+        typedef typename precision_policy<T>::wide W;
+        const MKL_INT block = 4096;
+        const S *base = static_cast<const S*>(addr);
+        #pragma omp parallel for schedule(static)
+        for (MKL_INT i0 = 0; i0 < dim; i0 += block) {
+            MKL_INT i1 = std::min(dim, i0 + block);
+            for (MKL_INT i = i0; i < i1; i++) y[i] = static_cast<T>(0.0);
+            for (MKL_INT j = 0; j < m; j++) {
+                const S *vj = base + static_cast<uint64_t>(j) * dim;
+                for (MKL_INT i = i0; i < i1; i++) y[i] += s[j] * static_cast<W>(vj[i]);
+            }
+        }
+    }
+    
+    template class krylov_basis<double>;
+    template class krylov_basis<std::complex<double>>;
+    template class krylov_basis<float>;
+    template class krylov_basis<std::complex<float>>;
+    
+    
     
     
     
@@ -220,10 +386,11 @@ namespace qbasis {
             accu = nrm2(dim, r, 1);
         }
         
+        const double tol = precision_policy<T>::tol();                           // lanczos_precision, unless stored in single precision
         while (m < maxit) {
-            if (accu < lanczos_precision) {
+            if (accu < tol) {
                 double rnorm = nrm2(dim, v, 1);
-                if (m == 0 || std::abs(rnorm - 1.0) > lanczos_precision) {       // re-normalize and restart
+                if (m == 0 || std::abs(rnorm - 1.0) > tol) {                     // re-normalize and restart
                     std::cout << "1" << std::flush;
                     scal(dim, 1.0/rnorm, v, 1);
                     for (MKL_INT j = 0; j < dim; j++) r[j] = 0.0;
@@ -241,16 +408,16 @@ namespace qbasis {
                     ckpt_CG_update(m, dim, v, r, p);
                     
                     
-                    if (accu < lanczos_precision) break;
+                    if (accu < tol) break;
                 } else {
                     break;
                 }
             } else {
                 copy(dim, p, 1, pp, 1);
-                scal(dim, machine_prec - E0, pp, 1);
+                scal(dim, static_cast<T>(machine_prec) - E0, pp, 1);
                 mat.MultMv2(p,pp);                                               // pp[m]    = (H - E0) * p[m]
-                T delta = dotc(dim, p, 1, pp, 1);                                // delta[m] = (p[m], pp[m])
-                T alpha = accu * accu / delta;                                   // alpha[m] = gamma[m]^2 / delta[m]
+                auto delta = dotc(dim, p, 1, pp, 1);                             // delta[m] = (p[m], pp[m])
+                T alpha = static_cast<T>(accu * accu / delta);                   // alpha[m] = gamma[m]^2 / delta[m]
                 axpy(dim,  alpha,  p, 1, v, 1);                                  // v[m+1]   = v[m] + alpha[m] * p[m]
                 axpy(dim, -alpha, pp, 1, r, 1);                                  // r[m+1]   = r[m] - alpha[m] * pp[m]
                 double beta = nrm2(dim, r, 1) / accu;                            // beta[m]  = gamma[m+1] / gamma[m]
@@ -279,6 +446,13 @@ namespace qbasis {
                               const model<std::complex<double>> &mat, const std::complex<double> &E0, double &accu,
                               std::complex<double> v[], std::complex<double> r[],
                               std::complex<double> p[], std::complex<double> pp[]);
+    template void eigenvec_CG(const MKL_INT &dim, const MKL_INT &maxit, MKL_INT &m,
+                              const csr_mat<double> &mat, const float &E0, double &accu,
+                              float v[], float r[], float p[], float pp[]);
+    template void eigenvec_CG(const MKL_INT &dim, const MKL_INT &maxit, MKL_INT &m,
+                              const csr_mat<std::complex<double>> &mat, const std::complex<float> &E0, double &accu,
+                              std::complex<float> v[], std::complex<float> r[],
+                              std::complex<float> p[], std::complex<float> pp[]);
     
     
     void hess_eigen(const double hessenberg[], const MKL_INT &maxit, const MKL_INT &m,
@@ -640,5 +814,438 @@ namespace qbasis {
                        const MKL_INT &maxit, const std::string &order,
                        MKL_INT &nconv, double eigenvals[], std::complex<double> eigenvecs[],
                        const bool &use_arpack);
-
+    
+    
+    // V[0:cnt-1] = V[0:m-1] * Y[:,0:cnt-1], with Y of size m*m, in place and row by row (no dim * cnt workspace)
+    template <typename T>
+    void rotate_basis(const MKL_INT &dim, const MKL_INT &m, const MKL_INT &cnt, const double Y[], T V[])
+    {
+        #pragma omp parallel
+        {
+            std::vector<T> row(cnt);
+            #pragma omp for schedule(static)
+            for (MKL_INT l = 0; l < dim; l++) {
+                for (MKL_INT c = 0; c < cnt; c++) {
+                    T sum = static_cast<T>(0.0);
+                    for (MKL_INT j = 0; j < m; j++) sum += Y[j + c * m] * V[static_cast<uint64_t>(j) * dim + l];
+                    row[c] = sum;
+                }
+                for (MKL_INT c = 0; c < cnt; c++) V[static_cast<uint64_t>(c) * dim + l] = row[c];
+            }
+        }
+    }
+    
+    template <typename T, typename MAT>
+    void trlan(const MKL_INT &dim, const MAT &mat, const T v0[], const MKL_INT &nev, const MKL_INT &ncv,
+               const MKL_INT &maxit, const std::string &order,
+               MKL_INT &nconv, double eigenvals[], T eigenvecs[])
+    {
+        std::string orderC(order);
+        std::transform(orderC.begin(), orderC.end(), orderC.begin(), ::toupper);
+        assert(orderC == "SR" || orderC == "SA" || orderC == "LR" || orderC == "LA");
+        bool smallest = (orderC == "SR" || orderC == "SA");
+        const MKL_INT m = std::min(ncv, dim);                                    // basis size before a restart
+        assert(nev > 0 && nev <= m && (m >= nev + 2 || m == dim) && maxit > 0);
+        const double eps = machine_prec;
+        const double eta = std::pow(machine_prec, 0.75);                         // partial reorthogonalization threshold,
+                                                                                 // below sqrt(eps) to keep the Ritz vectors accurate
+        
+        std::vector<T> V(static_cast<uint64_t>(dim) * (m + 1));
+        std::vector<double> tmat(m * m, 0.0);                                    // projected matrix, arrowhead + tridiagonal
+        std::vector<double> omega(m + 1), omega_prev(m + 1), omega_next(m + 1);  // estimated loss of orthogonality
+        std::vector<double> theta, Y;
+        auto vpt = [&V, &dim](const MKL_INT &j) { return V.data() + static_cast<uint64_t>(j) * dim; };
+        auto orth = [&](const MKL_INT &lo, const MKL_INT &hi, T *w) {           // w -= V[lo:hi-1] * (V[lo:hi-1], w)
+            for (MKL_INT i = lo; i < hi; i++) {
+                auto q = dotc(dim, vpt(i), 1, w, 1);
+                axpy(dim, -q, vpt(i), 1, w, 1);
+            }
+        };
+        
+        // V[0:nlock-1]: locked Ritz vectors, V[nlock:k-1]: kept Ritz vectors, V[k]: the residual vector
+        MKL_INT iter = 0, k = 0, nlock = 0;
+        ckpt_trlan_init(iter, k, nlock, dim, m, V.data(), tmat.data());
+        if (iter == 0) {
+            copy(dim, v0, 1, vpt(0), 1);
+            double rnorm = nrm2(dim, vpt(0), 1);
+            assert(rnorm > lanczos_precision);
+            scal(dim, 1.0 / rnorm, vpt(0), 1);
+        }
+        
+        double b_last = 0.0, anorm = 0.0;
+        MKL_INT cnt_new = 0;
+        while (true) {
+            // extend the factorization: H * V[0:m-1] = V[0:m-1] * tmat + b_last * V[m] * e_m^T
+            bool reorth_next = false;
+            omega[k] = 1.0;
+            for (MKL_INT j = k; j < m; j++) {
+                T *w = vpt(j+1);
+                double bj = (j > k) ? tmat[(j-1) + j * m] : 0.0;                 // b[j]
+                if (j > k) {
+                    copy(dim, vpt(j-1), 1, w, 1);
+                } else {
+                    for (MKL_INT l = 0; l < dim; l++) w[l] = static_cast<T>(0.0);
+                }
+                double a;
+                mat.lanczos_step(vpt(j), w, bj, a);                              // w = H * v[j] - b[j] * v[j-1]
+                if (j == k) {                                                    // the arrow from the kept Ritz vectors
+                    for (MKL_INT i = nlock; i < k; i++) axpy(dim, -tmat[i + k * m], vpt(i), 1, w, 1);
+                }
+                axpy(dim, -a, vpt(j), 1, w, 1);
+                tmat[j + j * m] = a;
+                orth(0, k, w);                                                   // selective: against the Ritz vectors
+                double b = nrm2(dim, w, 1);
+                
+                // partial reorthogonalization against v[k], ..., v[j], following the omega recurrence
+                // round-off of each step ~ eps * ||H||, with ||H|| estimated from the projected matrix
+                anorm = std::max(anorm, std::abs(a) + b + bj);
+                double psi = (b < lanczos_precision) ? eps : eps * anorm / b;
+                double omega_max = 0.0;
+                for (MKL_INT i = k; i < j; i++) {
+                    if (b < lanczos_precision) {                                 // reset below anyway
+                        omega_next[i] = eps;
+                        continue;
+                    }
+                    double x = tmat[i + (i+1) * m] * omega[i+1] + (tmat[i + i * m] - a) * omega[i] - bj * omega_prev[i];
+                    if (i > k) x += tmat[(i-1) + i * m] * omega[i-1];
+                    x /= b;
+                    omega_next[i] = x + (x > 0.0 ? psi : -psi);
+                    omega_max = std::max(omega_max, std::abs(omega_next[i]));
+                }
+                omega_next[j] = psi;
+                omega_next[j+1] = 1.0;
+                if (omega_max > eta || reorth_next) {
+                    orth(k, j + 1, w);
+                    b = nrm2(dim, w, 1);
+                    for (MKL_INT i = k; i <= j; i++) omega_next[i] = eps;
+                    reorth_next = ! reorth_next;                                 // once more in the next step
+                }
+                
+                if (b < lanczos_precision) {                                     // invariant subspace, continue with a random vector
+                    b = 0.0;
+                    if (j + 1 < dim) {
+                        vec_randomize(dim, w, static_cast<uint32_t>(iter * m + j + 2));
+                        orth(0, j + 1, w);
+                        orth(0, j + 1, w);
+                        double rnorm = nrm2(dim, w, 1);
+                        scal(dim, 1.0 / rnorm, w, 1);
+                    }
+                } else {
+                    scal(dim, 1.0 / b, w, 1);
+                }
+                if (j + 1 < m) {
+                    tmat[j + (j+1) * m] = b;
+                    tmat[(j+1) + j * m] = b;
+                } else {
+                    b_last = b;
+                }
+                swap(omega_prev, omega);
+                swap(omega, omega_next);
+            }
+            
+            // Rayleigh-Ritz on the active part V[nlock:m-1]
+            MKL_INT ma = m - nlock;
+            std::vector<double> A(ma * ma);
+            for (MKL_INT c = 0; c < ma; c++)
+                for (MKL_INT r = 0; r < ma; r++) A[r + c * ma] = tmat[(nlock + r) + (nlock + c) * m];
+            theta.resize(ma);
+            int info = heevd(LAPACK_COL_MAJOR, 'V', 'U', ma, A.data(), ma, theta.data()); // ascending
+            assert(info == 0);
+            Y.resize(ma * ma);
+            for (MKL_INT c = 0; c < ma; c++) {
+                MKL_INT c_src = smallest ? c : ma - 1 - c;
+                copy(ma, A.data() + c_src * ma, 1, Y.data() + c * ma, 1);
+            }
+            if (! smallest) std::reverse(theta.begin(), theta.end());
+            
+            // lock the leading converged Ritz pairs
+            MKL_INT nwant = nev - nlock;
+            cnt_new = 0;
+            while (cnt_new < nwant &&
+                   std::abs(b_last * Y[(ma-1) + cnt_new * ma]) < lanczos_precision * std::max(1.0, std::abs(theta[cnt_new]))) cnt_new++;
+            iter++;
+            std::cout << "TRLan restart " << std::setw(4) << iter << ", converged " << nlock + cnt_new << "/" << nev << ":";
+            for (MKL_INT j = 0; j < nlock; j++) std::cout << std::setw(16) << tmat[j + j * m];
+            for (MKL_INT j = 0; j < nwant; j++) std::cout << std::setw(16) << theta[j];
+            std::cout << std::endl;
+            if (cnt_new == nwant || iter >= maxit) break;
+            
+            // thick restart, keeping nwant + (m - nev) / 2 Ritz vectors of the active part
+            MKL_INT keep = std::max(nwant, std::min(nwant + (m - nev) / 2, ma - 2));
+            assert(nlock + keep < m);
+            rotate_basis(dim, ma, keep, Y.data(), vpt(nlock));
+            k = nlock + keep;
+            copy(dim, vpt(m), 1, vpt(k), 1);
+            for (MKL_INT c = nlock; c < m; c++)
+                for (MKL_INT r = 0; r < m; r++) {
+                    tmat[r + c * m] = 0.0;
+                    tmat[c + r * m] = 0.0;
+                }
+            for (MKL_INT c = 0; c < keep; c++) {
+                tmat[(nlock + c) * (m + 1)] = theta[c];
+                if (c < cnt_new) continue;                                       // deflated
+                double s = b_last * Y[(ma-1) + c * ma];
+                tmat[(nlock + c) + k * m] = s;
+                tmat[k + (nlock + c) * m] = s;
+            }
+            nlock += cnt_new;
+            ckpt_trlan_update(iter, k, nlock, dim, m, V.data(), tmat.data());
+        }
+        
+        // Ritz vectors V[0:nev-1], locked ones first, then sorted together
+        MKL_INT nwant = nev - nlock;
+        rotate_basis(dim, m - nlock, nwant, Y.data(), vpt(nlock));
+        nconv = nlock + cnt_new;
+        for (MKL_INT j = 0; j < nlock; j++) eigenvals[j] = tmat[j + j * m];
+        for (MKL_INT j = 0; j < nwant; j++) eigenvals[nlock + j] = theta[j];
+        for (MKL_INT j = 0; j < nev; j++) copy(dim, vpt(j), 1, eigenvecs + static_cast<uint64_t>(dim) * j, 1);
+        using std::swap;
+        for (MKL_INT j = 1; j < nev; j++) {
+            bool sorted = true;
+            for (MKL_INT i = 0; i < nev - j; i++) {
+                if (smallest ? (eigenvals[i+1] < eigenvals[i]) : (eigenvals[i] < eigenvals[i+1])) {
+                    swap(eigenvals[i], eigenvals[i+1]);
+                    vec_swap(dim, eigenvecs + static_cast<uint64_t>(dim) * i, eigenvecs + static_cast<uint64_t>(dim) * (i+1));
+                    sorted = false;
+                }
+            }
+            if (sorted) break;
+        }
+        for (MKL_INT j = 0; j < nev; j++) std::cout << "E_" << j << " = " << eigenvals[j] << std::endl;
+        if (nconv < nev) {                                                       // ckpt kept, to resume with a larger maxit
+            std::cout << "Warning: only " << nconv << " of " << nev << " eigenpairs converged after "
+                      << iter << " restarts!" << std::endl;
+        } else {
+            ckpt_trlan_clean();
+        }
+    }
+    template void trlan(const MKL_INT &dim, const csr_mat<double> &mat, const double v0[], const MKL_INT &nev,
+                        const MKL_INT &ncv, const MKL_INT &maxit, const std::string &order,
+                        MKL_INT &nconv, double eigenvals[], double eigenvecs[]);
+    template void trlan(const MKL_INT &dim, const csr_mat<std::complex<double>> &mat, const std::complex<double> v0[],
+                        const MKL_INT &nev, const MKL_INT &ncv, const MKL_INT &maxit, const std::string &order,
+                        MKL_INT &nconv, double eigenvals[], std::complex<double> eigenvecs[]);
+    template void trlan(const MKL_INT &dim, const model<std::complex<double>> &mat, const std::complex<double> v0[],
+                        const MKL_INT &nev, const MKL_INT &ncv, const MKL_INT &maxit, const std::string &order,
+                        MKL_INT &nconv, double eigenvals[], std::complex<double> eigenvecs[]);
+    
+    // G = A^H * B (pa * pb, column major), for pa vectors in A and pb vectors in B, both interleaved (A[i * pa + s])
+    template <typename T>
+    void block_gram(const MKL_INT &dim, const MKL_INT &pa, const T A[], const MKL_INT &pb, const T B[], std::vector<T> &G)
+    {
+        std::vector<T> Gt(pa * pb);
+        gemm('N', 'C', pb, pa, dim, static_cast<T>(1.0), B, pb, A, pa, static_cast<T>(0.0), Gt.data(), pb);
+        G.resize(pa * pb);
+        for (MKL_INT s = 0; s < pa; s++)
+            for (MKL_INT t = 0; t < pb; t++) G[s + t * pa] = Gt[t + s * pb];
+    }
+    
+    // Y = alpha * A * C + beta * Y, A and Y interleaved (pa and pc vectors), C of size pa * pc (column major)
+    template <typename T>
+    void block_mult(const MKL_INT &dim, const MKL_INT &pa, const T A[], const MKL_INT &pc, const T C[],
+                    const T &alpha, const T &beta, T Y[])
+    {
+        gemm('T', 'N', pc, dim, pa, alpha, C, pa, A, pa, beta, Y, pc);
+    }
+    
+    template <typename T, typename MAT>
+    void lobpcg(const MKL_INT &dim, const MAT &mat, const T v0[], const MKL_INT &nev, const MKL_INT &p,
+                const MKL_INT &maxit, const std::string &order,
+                MKL_INT &nconv, double eigenvals[], T eigenvecs[])
+    {
+        std::string orderC(order);
+        std::transform(orderC.begin(), orderC.end(), orderC.begin(), ::toupper);
+        assert(orderC == "SR" || orderC == "SA" || orderC == "LR" || orderC == "LA");
+        const double sgn = (orderC == "SR" || orderC == "SA") ? 1.0 : -1.0;      // largest ones as the smallest of -H
+        assert(nev > 0 && p >= nev && 3 * p <= dim && maxit > 0);
+        const T one = static_cast<T>(1.0), zero = static_cast<T>(0.0);
+        const uint64_t len = static_cast<uint64_t>(dim) * p;
+        
+        // X: Ritz vectors, W: residuals of the active ones, P: the implicit search directions, and H times them
+        // Xn, AXn, Pn, APn: workspace for the update
+        std::vector<T> X(len), AX(len), W(len), AW(len), P(len), AP(len), Xn(len), AXn(len), Pn(len), APn(len);
+        std::vector<double> theta(p), rnorm(p);
+        std::vector<T> C;
+        for (MKL_INT s = 0; s < p; s++)
+            for (MKL_INT i = 0; i < dim; i++) X[static_cast<uint64_t>(i) * p + s] = v0[static_cast<uint64_t>(s) * dim + i];
+        auto apply_H = [&](const T *Z, T *AZ, const MKL_INT &k) {
+            mat.MultMm(Z, AZ, k);
+            if (sgn < 0.0) scal(dim * k, sgn, AZ, 1);
+        };
+        
+        // Rayleigh-Ritz in the span of the blocks S = [X, W, P] (W, P with na, np vectors):
+        // S^H S orthonormalized in the SVQB way (linearly dependent directions dropped), then the p lowest Ritz pairs,
+        // C (n * p) the coefficients of the Ritz vectors in S
+        auto rayleigh_ritz = [&](const MKL_INT &na, const MKL_INT &np, const T *Pa, const T *APa) {
+            std::vector<const T*> Sb{X.data(), W.data(), Pa}, ASb{AX.data(), AW.data(), APa};
+            std::vector<MKL_INT> nb{p, na, np}, off{0, p, p + na};
+            MKL_INT n = p + na + np;
+            std::vector<T> gA(n * n), gB(n * n), G;
+            for (int bi = 0; bi < 3; bi++) {
+                for (int bj = bi; bj < 3; bj++) {
+                    if (nb[bi] == 0 || nb[bj] == 0) continue;
+                    block_gram(dim, nb[bi], Sb[bi], nb[bj], Sb[bj], G);
+                    for (MKL_INT s = 0; s < nb[bi]; s++)
+                        for (MKL_INT t = 0; t < nb[bj]; t++) {
+                            gB[(off[bi] + s) + (off[bj] + t) * n] = G[s + t * nb[bi]];
+                            gB[(off[bj] + t) + (off[bi] + s) * n] = conjugate(G[s + t * nb[bi]]);
+                        }
+                    block_gram(dim, nb[bi], Sb[bi], nb[bj], ASb[bj], G);
+                    for (MKL_INT s = 0; s < nb[bi]; s++)
+                        for (MKL_INT t = 0; t < nb[bj]; t++) {
+                            gA[(off[bi] + s) + (off[bj] + t) * n] = G[s + t * nb[bi]];
+                            gA[(off[bj] + t) + (off[bi] + s) * n] = conjugate(G[s + t * nb[bi]]);
+                        }
+                }
+            }
+            for (MKL_INT s = 0; s < n; s++) gA[s + s * n] = std::real(gA[s + s * n]);
+            
+            std::vector<double> d(n), mu(n);
+            for (MKL_INT s = 0; s < n; s++) d[s] = 1.0 / std::sqrt(std::real(gB[s + s * n]));
+            for (MKL_INT t = 0; t < n; t++)
+                for (MKL_INT s = 0; s < n; s++) gB[s + t * n] *= d[s] * d[t];
+            int info = heevd(LAPACK_COL_MAJOR, 'V', 'U', n, gB.data(), n, mu.data()); // ascending
+            assert(info == 0);
+            MKL_INT r0 = 0;
+            while (r0 < n && mu[r0] < 1e-14 * mu[n-1]) r0++;                     // drop the dependent directions
+            MKL_INT r = n - r0;
+            assert(r >= p);
+            std::vector<T> Q(n * r), QA(n * r), Ared(r * r);
+            for (MKL_INT c = 0; c < r; c++)
+                for (MKL_INT s = 0; s < n; s++) Q[s + c * n] = gB[s + (r0 + c) * n] * (d[s] / std::sqrt(mu[r0 + c]));
+            for (MKL_INT c = 0; c < r; c++)                                      // QA = gA * Q
+                for (MKL_INT s = 0; s < n; s++) {
+                    T sum = zero;
+                    for (MKL_INT t = 0; t < n; t++) sum += gA[s + t * n] * Q[t + c * n];
+                    QA[s + c * n] = sum;
+                }
+            for (MKL_INT c = 0; c < r; c++)                                      // Ared = Q^H * gA * Q
+                for (MKL_INT s = 0; s < r; s++) {
+                    T sum = zero;
+                    for (MKL_INT t = 0; t < n; t++) sum += conjugate(Q[t + s * n]) * QA[t + c * n];
+                    Ared[s + c * r] = sum;
+                }
+            std::vector<double> ritz(r);
+            info = heevd(LAPACK_COL_MAJOR, 'V', 'U', r, Ared.data(), r, ritz.data());
+            assert(info == 0);
+            C.assign(n * p, zero);
+            for (MKL_INT c = 0; c < p; c++) {
+                theta[c] = ritz[c];
+                for (MKL_INT s = 0; s < n; s++) {
+                    T sum = zero;
+                    for (MKL_INT t = 0; t < r; t++) sum += Q[s + t * n] * Ared[t + c * r];
+                    C[s + c * n] = sum;
+                }
+            }
+        };
+        
+        apply_H(X.data(), AX.data(), p);
+        rayleigh_ritz(0, 0, nullptr, nullptr);
+        block_mult(dim, p, X.data(),  p, C.data(), one, zero, Xn.data());
+        block_mult(dim, p, AX.data(), p, C.data(), one, zero, AXn.data());
+        swap(X, Xn);
+        swap(AX, AXn);
+        
+        MKL_INT iter = 0, np = 0;
+        std::vector<MKL_INT> active, active_prev;
+        while (true) {
+            // residuals R = AX - X * theta, computed in AW and compressed to the active ones in W
+            std::fill(rnorm.begin(), rnorm.end(), 0.0);
+            #pragma omp parallel
+            {
+                std::vector<double> rn(p, 0.0);
+                #pragma omp for schedule(static)
+                for (MKL_INT i = 0; i < dim; i++) {
+                    for (MKL_INT s = 0; s < p; s++) {
+                        uint64_t l = static_cast<uint64_t>(i) * p + s;
+                        AW[l] = AX[l] - theta[s] * X[l];
+                        rn[s] += std::norm(AW[l]);
+                    }
+                }
+                #pragma omp critical
+                for (MKL_INT s = 0; s < p; s++) rnorm[s] += rn[s];
+            }
+            nconv = 0;
+            active.clear();
+            for (MKL_INT s = 0; s < p; s++) {
+                rnorm[s] = std::sqrt(rnorm[s]);
+                bool conv = rnorm[s] < lanczos_precision * std::max(1.0, std::abs(theta[s]));
+                if (conv && nconv == s) nconv++;
+                if (! conv) active.push_back(s);                                 // soft locking of the converged ones
+            }
+            iter++;
+            std::cout << "LOBPCG iter " << std::setw(4) << iter << ", converged " << std::min(nconv, nev) << "/" << nev << ":";
+            for (MKL_INT j = 0; j < nev; j++) std::cout << std::setw(16) << sgn * theta[j];
+            std::cout << std::endl;
+            if (nconv >= nev || iter > maxit) break;
+            
+            MKL_INT na = static_cast<MKL_INT>(active.size());
+            #pragma omp parallel for schedule(static)
+            for (MKL_INT i = 0; i < dim; i++)
+                for (MKL_INT c = 0; c < na; c++)
+                    W[static_cast<uint64_t>(i) * na + c] = AW[static_cast<uint64_t>(i) * p + active[c]];
+            std::vector<T> G;                                                    // W -= X * (X^H W), then normalized
+            block_gram(dim, p, X.data(), na, W.data(), G);
+            block_mult(dim, p, X.data(), na, G.data(), -one, one, W.data());
+            block_gram(dim, na, W.data(), na, W.data(), G);
+            std::vector<T> Dw(na * na, zero);
+            for (MKL_INT c = 0; c < na; c++) Dw[c + c * na] = 1.0 / std::sqrt(std::real(G[c + c * na]));
+            block_mult(dim, na, W.data(), na, Dw.data(), one, zero, AW.data());
+            swap(W, AW);
+            apply_H(W.data(), AW.data(), na);
+            
+            // the active part of P (in Xn, AXn, free at this point)
+            np = (iter > 1) ? na : 0;
+            if (np > 0) {
+                #pragma omp parallel for schedule(static)
+                for (MKL_INT i = 0; i < dim; i++)
+                    for (MKL_INT c = 0; c < np; c++) {
+                        Xn[static_cast<uint64_t>(i) * np + c]  = P[static_cast<uint64_t>(i) * p + active[c]];
+                        AXn[static_cast<uint64_t>(i) * np + c] = AP[static_cast<uint64_t>(i) * p + active[c]];
+                    }
+            }
+            rayleigh_ritz(na, np, Xn.data(), AXn.data());
+            MKL_INT n = p + na + np;
+            std::vector<T> Cx(p * p), Cw(na * p), Cp(np * p);
+            for (MKL_INT c = 0; c < p; c++) {
+                for (MKL_INT s = 0; s < p; s++)  Cx[s + c * p]  = C[s + c * n];
+                for (MKL_INT s = 0; s < na; s++) Cw[s + c * na] = C[p + s + c * n];
+                for (MKL_INT s = 0; s < np; s++) Cp[s + c * np] = C[p + na + s + c * n];
+            }
+            // P = W * Cw + P * Cp, X = X * Cx + P, and the same for H times them
+            block_mult(dim, na, W.data(),  p, Cw.data(), one, zero, Pn.data());
+            block_mult(dim, na, AW.data(), p, Cw.data(), one, zero, APn.data());
+            if (np > 0) {
+                block_mult(dim, np, Xn.data(),  p, Cp.data(), one, one, Pn.data());
+                block_mult(dim, np, AXn.data(), p, Cp.data(), one, one, APn.data());
+            }
+            copy(len, Pn.data(),  1, Xn.data(),  1);
+            copy(len, APn.data(), 1, AXn.data(), 1);
+            block_mult(dim, p, X.data(),  p, Cx.data(), one, one, Xn.data());
+            block_mult(dim, p, AX.data(), p, Cx.data(), one, one, AXn.data());
+            swap(X, Xn);
+            swap(AX, AXn);
+            swap(P, Pn);
+            swap(AP, APn);
+        }
+        
+        nconv = std::min(nconv, nev);
+        for (MKL_INT j = 0; j < nev; j++) {
+            eigenvals[j] = sgn * theta[j];
+            for (MKL_INT i = 0; i < dim; i++) eigenvecs[static_cast<uint64_t>(j) * dim + i] = X[static_cast<uint64_t>(i) * p + j];
+            std::cout << "E_" << j << " = " << eigenvals[j] << std::endl;
+        }
+        if (nconv < nev) std::cout << "Warning: only " << nconv << " of " << nev << " eigenpairs converged after "
+                                   << iter << " iterations!" << std::endl;
+    }
+    template void lobpcg(const MKL_INT &dim, const csr_mat<double> &mat, const double v0[], const MKL_INT &nev,
+                         const MKL_INT &p, const MKL_INT &maxit, const std::string &order,
+                         MKL_INT &nconv, double eigenvals[], double eigenvecs[]);
+    template void lobpcg(const MKL_INT &dim, const csr_mat<std::complex<double>> &mat, const std::complex<double> v0[],
+                         const MKL_INT &nev, const MKL_INT &p, const MKL_INT &maxit, const std::string &order,
+                         MKL_INT &nconv, double eigenvals[], std::complex<double> eigenvecs[]);
+    template void lobpcg(const MKL_INT &dim, const model<std::complex<double>> &mat, const std::complex<double> v0[],
+                         const MKL_INT &nev, const MKL_INT &p, const MKL_INT &maxit, const std::string &order,
+                         MKL_INT &nconv, double eigenvals[], std::complex<double> eigenvecs[]);
+    
 }
@@ -76,17 +76,42 @@ namespace qbasis {
             assert(bc[j] == "pbc" || bc[j] == "PBC" || bc[j] == "obc" || bc[j] == "OBC");
         }
         
+        init_maps();
+    }
+    
+    void lattice::init_maps()
+    {
         site2coor_map.resize(Nsites);
-        coor2site_map.resize(num_sub);
+        coor2site_map.assign(Nsites, 0);
         for (uint32_t j = 0; j < Nsites; j++) {
             std::vector<int> coor;
             int sub;
             site2coor_old(coor, sub, j);
             site2coor_map[j].first  = coor;
             site2coor_map[j].second = sub;
-            coor2site_map[sub][coor] = j;
+            uint32_t pos = 0;
+            for (uint32_t d = dim; d-- > 0; ) pos = pos * L[d] + static_cast<uint32_t>(coor[d]);
+            coor2site_map[static_cast<uint32_t>(sub) + num_sub * pos] = j;
         }
         
+        // all translation plans, Nsites * Nsites / num_sub entries
+        uint32_t num_trans = Nsites / num_sub;
+        assert(static_cast<uint64_t>(num_trans) * Nsites < (static_cast<uint64_t>(1) << 28));
+        plans_trans.resize(static_cast<uint64_t>(num_trans) * Nsites);
+        std::vector<int> disp(dim), coor(dim), work(dim);
+        for (uint32_t n = 0; n < num_trans; n++) {
+            auto temp = n;
+            for (uint32_t d = 0; d < dim; d++) {
+                disp[d] = static_cast<int>(temp % L[d]);
+                temp /= L[d];
+            }
+            int sub;
+            for (uint32_t site = 0; site < Nsites; site++) {
+                site2coor(coor, sub, site);
+                for (uint32_t d = 0; d < dim; d++) coor[d] += disp[d];
+                coor2site(coor, sub, plans_trans[static_cast<uint64_t>(n) * Nsites + site], work);
+            }
+        }
     }
     
     bool lattice::q_dividable() const {
@@ -107,7 +132,9 @@ namespace qbasis {
             if (work[d] < 0 || work[d] >= static_cast<int>(L[d])) work[d] = coor[d] % static_cast<int>(L[d]);
             if (work[d] < 0) work[d] += static_cast<int>(L[d]);
         }
-        site = coor2site_map[sub_temp].at(work);
+        uint32_t pos = 0;
+        for (uint32_t d = dim; d-- > 0; ) pos = pos * L[d] + static_cast<uint32_t>(work[d]);
+        site = coor2site_map[static_cast<uint32_t>(sub_temp) + num_sub * pos];
     }
     
     void lattice::coor2site_old(const std::vector<int> &coor, const int &sub, uint32_t &site) const
@@ -524,19 +551,22 @@ namespace qbasis {
     }
     */
     
-    void lattice::translation_plan(std::vector<uint32_t> &plan, const std::vector<int> &disp,
-                                   std::vector<int> &scratch_coor, std::vector<int> &scratch_work) const
+    void lattice::translation_plan(std::vector<uint32_t> &plan, const std::vector<int> &disp) const
+    {
+        auto plan_cached = translation_plan(disp);
+        plan.assign(plan_cached, plan_cached + Nsites);
+    }
+    
+    const uint32_t *lattice::translation_plan(const std::vector<int> &disp) const
     {
-        if (plan.size() != Nsites) plan.resize(Nsites);
         assert(disp.size() == dim);
-        if (scratch_coor.size() != dim) scratch_coor.resize(dim);
-        if (scratch_work.size() != dim) scratch_work.resize(dim);
-        int sub;
-        for (uint32_t site = 0; site < Nsites; site++) {
-            site2coor(scratch_coor, sub, site);
-            for (uint32_t j = 0; j < dim; j++) scratch_coor[j] += disp[j];
-            coor2site(scratch_coor,sub,plan[site], scratch_work);
+        uint64_t pos = 0;
+        for (uint32_t d = dim; d-- > 0; ) {
+            int disp_d = disp[d] % static_cast<int>(L[d]);
+            if (disp_d < 0) disp_d += static_cast<int>(L[d]);
+            pos = pos * L[d] + static_cast<uint64_t>(disp_d);
         }
+        return plans_trans.data() + pos * Nsites;
     }
     
     std::vector<uint32_t> lattice::rotation_plan(const uint32_t &origin, const double &angle) const
@@ -645,16 +675,8 @@ namespace qbasis {
         
         child.site2coor_map.clear();
         child.coor2site_map.clear();
-        child.site2coor_map.resize(child.Nsites);
-        child.coor2site_map.resize(child.num_sub);
-        for (uint32_t j = 0; j < child.Nsites; j++) {
-            std::vector<int> coor;
-            int sub;
-            child.site2coor_old(coor, sub, j);
-            child.site2coor_map[j].first  = coor;
-            child.site2coor_map[j].second = sub;
-            child.coor2site_map[sub][coor] = j;
-        }
+        child.plans_trans.clear();
+        child.init_maps();
         
         return child;
     }
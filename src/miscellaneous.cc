@@ -1,6 +1,8 @@
+#include <cstring>
 #include <ctime>
 #include <random>
 #include <fstream>
+#include <unistd.h>
 #include <boost/crc.hpp>
 #include <boost/version.hpp>
 #include "qbasis.h"
@@ -77,6 +79,31 @@ namespace qbasis {
         return res;
     }
     
+    uint64_t mem_available()
+    {
+        uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#if defined(_SC_AVPHYS_PAGES)
+        return page * static_cast<uint64_t>(sysconf(_SC_AVPHYS_PAGES));
+#else
+        return page * static_cast<uint64_t>(sysconf(_SC_PHYS_PAGES)) / 2;        // no such query on mac, guess half
+#endif
+    }
+    
+    uint64_t masked_xor(const uint8_t *bits, const uint8_t *masks, const uint32_t &nbits)
+    {
+        uint64_t res = 0, w, m;
+        uint32_t nbytes = nbits / 8;
+        uint32_t j = 0;
+        for (; j + 8 <= nbytes; j += 8) {
+            std::memcpy(&w, bits + j, 8);
+            std::memcpy(&m, masks + j, 8);
+            res ^= (w & m);
+        }
+        for (; j < nbytes; j++) res ^= static_cast<uint64_t>(bits[j] & masks[j]);
+        if (nbits % 8 != 0) res ^= static_cast<uint64_t>(bits[j] & masks[j] & ((1u << (nbits % 8)) - 1));
+        return res;
+    }
+    
     template <typename T1, typename T2>
     T2 int_pow(const T1 &base, const T1 &index)
     {
@@ -319,18 +346,20 @@ namespace qbasis {
         if (seed == 0) {
             T ele = static_cast<T>(sqrt(1.0 / n));
             for (MKL_INT j = 0; j < n; j++) x[j] = ele;
-            assert(std::abs(nrm2(n, x, 1) - 1.0) < lanczos_precision);
+            assert(std::abs(nrm2(n, x, 1) - 1.0) < precision_policy<T>::tol());
         } else {
             std::minstd_rand0 g(seed);
             double pref = 1.0 / 2147483647.0;
             for (MKL_INT j = 0; j < n; j++) x[j] = g() * pref - 0.5;
             double rnorm = nrm2(n, x, 1);
             scal(n, 1.0/rnorm, x, 1);
-            assert(std::abs(nrm2(n, x, 1) - 1.0) < lanczos_precision);
+            assert(std::abs(nrm2(n, x, 1) - 1.0) < precision_policy<T>::tol());
         }
     }
     template void vec_randomize(const MKL_INT &n, double *x, const uint32_t &seed);
     template void vec_randomize(const MKL_INT &n, std::complex<double> *x, const uint32_t &seed);
+    template void vec_randomize(const MKL_INT &n, float *x, const uint32_t &seed);
+    template void vec_randomize(const MKL_INT &n, std::complex<float> *x, const uint32_t &seed);
     
 
     template <typename T>
@@ -380,6 +409,8 @@ namespace qbasis {
     }
     template int vec_disk_read(const std::string &filename, MKL_INT n, double *x);
     template int vec_disk_read(const std::string &filename, MKL_INT n, std::complex<double> *x);
+    template int vec_disk_read(const std::string &filename, MKL_INT n, float *x);
+    template int vec_disk_read(const std::string &filename, MKL_INT n, std::complex<float> *x);
     
     template <typename T>
     int vec_disk_write(const std::string &filename, MKL_INT n, T *x)
@@ -414,6 +445,8 @@ namespace qbasis {
     }
     template int vec_disk_write(const std::string &filename, MKL_INT n, double *x);
     template int vec_disk_write(const std::string &filename, MKL_INT n, std::complex<double> *x);
+    template int vec_disk_write(const std::string &filename, MKL_INT n, float *x);
+    template int vec_disk_write(const std::string &filename, MKL_INT n, std::complex<float> *x);
     
     
     int basis_disk_read(const std::string &filename, std::vector<mbasis_elem> &basis)
@@ -446,8 +479,7 @@ namespace qbasis {
         }
         
         for (MKL_INT j = 0; j < n; j++) {
-            if (basis[j].mbits != nullptr) free(basis[j].mbits);
-            basis[j].mbits = static_cast<uint8_t*>(malloc(total_bytes * sizeof(uint8_t)));
+            basis[j].allocate(total_bytes);
             char* pos = reinterpret_cast<char*>(basis[j].mbits);
             fin.read(pos, total_bytes);
             res_crc.process_bytes(pos, total_bytes);
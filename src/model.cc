@@ -4,6 +4,8 @@
 #include <iomanip>
 #include <random>
 #include <regex>
+#include <sstream>
+#include <boost/crc.hpp>
 #include "qbasis.h"
 #include "graph.h"
 
@@ -15,6 +17,8 @@ namespace qbasis {
     template <typename T>
     model<T>::model(const lattice &latt, const uint32_t &num_secs, const double &fake_pos_):
                     matrix_free(true),
+                    matrix_free_upper_triangle(false),
+                    mixed_precision(false),
                     nconv(0),
                     sec_mat(0),
                     dim_full(std::vector<MKL_INT>(num_secs,0)),
@@ -22,7 +26,12 @@ namespace qbasis {
                     dim_vrnl(std::vector<MKL_INT>(num_secs,0)),
                     gs_E0_vrnl(100.0),
                     fake_pos(fake_pos_),
-                    latt_parent(latt)
+                    latt_parent(latt),
+                    Ham_off_diag_split(true),
+                    Ham_off_diag_dirty(true),
+                    scratch_allocs(0),
+                    sym_sec(0),
+                    sym_ok(false)
     {
         momenta.resize(num_secs);
         momenta_vrnl.resize(num_secs);
@@ -30,11 +39,14 @@ namespace qbasis {
         basis_repr.resize(num_secs);
         basis_vrnl.resize(num_secs);
         norm_repr.resize(num_secs);
+        phase_repr.resize(num_secs);
         gs_norm_vrnl.resize(num_secs);
         Lin_Ja_full.resize(num_secs);
         Lin_Jb_full.resize(num_secs);
         Lin_Ja_repr.resize(num_secs);
         Lin_Jb_repr.resize(num_secs);
+        perm_full.resize(num_secs);
+        perm_repr.resize(num_secs);
         HamMat_csr_full.resize(num_secs);
         HamMat_csr_repr.resize(num_secs);
         HamMat_csr_vrnl.resize(num_secs);
@@ -58,6 +70,7 @@ namespace qbasis {
             Ham_diag += rhs;
         } else {
             Ham_off_diag += rhs;
+            Ham_off_diag_dirty = true;
         }
     }
     
@@ -68,6 +81,7 @@ namespace qbasis {
             Ham_diag += rhs;
         } else {
             Ham_off_diag += rhs;
+            Ham_off_diag_dirty = true;
         }
     }
     
@@ -79,10 +93,61 @@ namespace qbasis {
                 Ham_diag += rhs[j];
             } else {
                 Ham_off_diag += rhs[j];
+                Ham_off_diag_dirty = true;
             }
         }
     }
     
+    template <typename T>
+    void model<T>::compile_Ham_off_diag() const
+    {
+        if (! Ham_off_diag_dirty) return;
+        Ham_off_diag_compiled = mopr_compiled<T>(Ham_off_diag, props);
+        mopr<T> half, self;
+        Ham_off_diag_split = Ham_off_diag.split_hermitian(half, self);
+        Ham_off_diag_half_compiled = mopr_compiled<T>(half, props);
+        Ham_off_diag_self_compiled = mopr_compiled<T>(self, props);
+        Ham_off_diag_dirty = false;
+        sym_part.clear();
+    }
+    
+    template <typename T>
+    uint64_t model<T>::scratch_thread::footprint() const
+    {
+        uint64_t res = static_cast<uint64_t>(intermediate_state.ele.capacity()) * sizeof(std::pair<mbasis_elem,T>);
+        res += (disp_i_int.capacity() + disp_j_int.capacity()) * sizeof(int);
+        res += cart.capacity() * sizeof(double);
+        res += work1.capacity() * sizeof(uint8_t);
+        res += work2.capacity() * sizeof(uint64_t);
+        res += values.capacity() * sizeof(std::pair<MKL_INT,T>);
+        res += y_private.capacity() * sizeof(T);
+        return res;
+    }
+    
+    template <typename T>
+    int model<T>::scratch_prepare() const
+    {
+        int num_threads = omp_get_max_threads();
+        if (static_cast<int>(scratch.size()) != num_threads) {
+            scratch.clear();
+            scratch.reserve(num_threads);
+            for (int tid = 0; tid < num_threads; tid++) scratch.emplace_back(props, latt_parent.dimension());
+            scratch_allocs++;
+        }
+        return num_threads;
+    }
+    
+    template <typename T>
+    bool model<T>::q_mixed_precision() const
+    {
+        if (! mixed_precision) return false;
+        if (enable_ckpt) {
+            std::cout << "Warning: mixed_precision ignored with checkpoints on!" << std::endl;
+            return false;
+        }
+        return true;
+    }
+    
     template <typename T>
     void model<T>::add_Ham_vrnl(const opr<T> &rhs)
     {
@@ -180,9 +245,47 @@ namespace qbasis {
         assert(check_dim_sub_full == static_cast<uint64_t>(basis_sub_full.size()));
         
         std::cout << "Generating maps (ga,gb,ja,jb) -> (i,j) and (ga,gb,j) -> (w) ... " << std::flush;
+        MltArray_PairVec Weisse_e_lt, Weisse_e_eq, Weisse_e_gt;
+        MltArray_uint32  Weisse_w_lt, Weisse_w_eq, Weisse_w_gt;
         classify_Weisse_tables(props, props_sub, basis_sub_repr, latt_parent, trans_sym,
                                belong2rep_sub, dist2rep_sub, belong2group_sub, groups_parent, groups_sub,
                                Weisse_e_lt, Weisse_e_eq, Weisse_e_gt, Weisse_w_lt, Weisse_w_eq, Weisse_w_gt);
+        if (dim_spec_involved) {
+            assert(Weisse_w_gt.size() == 0);
+        } else {
+            assert(Weisse_w_lt.size() == Weisse_w_gt.size());
+        }
+        
+        // flatten the tables
+        uint32_t latt_sub_dim = latt_sub.dimension();
+        auto linear_size      = Weisse_w_lt.linear_size();
+        assert(linear_size.size() == latt_sub_dim + 2);
+        Weisse_size.assign(linear_size.begin() + 2, linear_size.end());
+        std::vector<const MltArray_PairVec*> tables_e{&Weisse_e_lt, &Weisse_e_eq, &Weisse_e_gt};
+        std::vector<const MltArray_uint32*>  tables_w{&Weisse_w_lt, &Weisse_w_eq, &Weisse_w_gt};
+        Weisse_w_flat.assign(3 * Weisse_w_lt.size(), static_cast<uint32_t>(groups_parent.size() + 10));
+        for (uint32_t c = 0; c < 3; c++) {
+            if (tables_w[c]->size() == 0) continue;
+            for (uint64_t n = 0; n < tables_w[c]->size(); n++) Weisse_w_flat[c + 3 * n] = (*tables_w[c])[n];
+        }
+        Weisse_e_flat.assign(3 * Weisse_e_lt.size() * 2 * latt_sub_dim, 999999999);
+        for (uint32_t c = 0; c < 3; c++) {
+            for (uint64_t n = 0; n < tables_e[c]->size(); n++) {
+                auto &rec = (*tables_e[c])[n];
+                assert(rec.first.size() == latt_sub_dim && rec.second.size() == latt_sub_dim);
+                auto pos = (c + 3 * n) * 2 * latt_sub_dim;
+                std::copy(rec.first.begin(),  rec.first.end(),  Weisse_e_flat.begin() + pos);
+                std::copy(rec.second.begin(), rec.second.end(), Weisse_e_flat.begin() + pos + latt_sub_dim);
+            }
+        }
+        uint64_t num_trans_sub = 1;
+        for (uint32_t d = 0; d < latt_sub_dim; d++) num_trans_sub *= Weisse_size[d];
+        Weisse_off_a.resize(dist2rep_sub.size());
+        Weisse_off_b.resize(dist2rep_sub.size());
+        for (decltype(dist2rep_sub.size()) label = 0; label < dist2rep_sub.size(); label++) {
+            Weisse_off_a[label] = Weisse_offset(dist2rep_sub[label]);
+            Weisse_off_b[label] = num_trans_sub * Weisse_off_a[label];
+        }
         end = std::chrono::system_clock::now();
         elapsed_seconds = end - start;
         std::cout << elapsed_seconds.count() << "s." << std::endl;
@@ -190,6 +293,19 @@ namespace qbasis {
     }
     
     
+    template <typename T>
+    uint64_t model<T>::Weisse_offset(const std::vector<int> &disp) const
+    {
+        assert(disp.size() == Weisse_size.size());
+        uint64_t num_groups = groups_sub.size();
+        uint64_t res = 0;
+        for (auto d = Weisse_size.size(); d-- > 0; ) {
+            assert(disp[d] >= 0 && static_cast<uint64_t>(disp[d]) < Weisse_size[d]);
+            res = res * Weisse_size[d] + static_cast<uint64_t>(disp[d]);
+        }
+        return 3 * num_groups * num_groups * res;
+    }
+    
     // need further optimization! (for example, special treatment of dilute limit; special treatment of quantum numbers; quick sort of sign)
     template <typename T>
     void model<T>::enumerate_basis_full(std::vector<mopr<T>> conserve_lst,
@@ -199,6 +315,7 @@ namespace qbasis {
         enumerate_basis<T>(props, basis_full[sec_full], conserve_lst, val_lst);
         
         dim_full[sec_full] = static_cast<MKL_INT>(basis_full[sec_full].size());
+        sym_part.clear();
         
         sort_basis_Lin_order(props, basis_full[sec_full]);
         
@@ -220,20 +337,31 @@ namespace qbasis {
     {
         assert(latt_parent.dimension() == static_cast<uint32_t>(momentum.size()));
         assert(conserve_lst.size() == val_lst.size());
-        assert(Weisse_e_lt.size() > 0);
+        assert(Weisse_e_flat.size() > 0);
         assert(basis_sub_repr.size() > 0);   // should be already generated when filling Weisse Tables
         
         momenta[sec_repr] = momentum;
         
-        if (dim_spec_involved) {
-            assert(Weisse_w_gt.size() == 0);
-        } else {
-            assert(Weisse_w_lt.size() == Weisse_w_gt.size());
-        }
-        
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
         auto L        = latt_parent.Linear_size();
+        
+        // phase factors for all translations of the parent lattice
+        uint64_t num_trans = 1;
+        for (uint32_t d = 0; d < latt_parent.dimension(); d++) num_trans *= L[d];
+        phase_repr[sec_repr].resize(num_trans);
+        std::vector<int> disp(latt_parent.dimension());
+        for (uint64_t n = 0; n < num_trans; n++) {
+            auto temp = n;
+            double exp_coef = 0.0;
+            for (uint32_t d = 0; d < latt_parent.dimension(); d++) {
+                disp[d] = static_cast<int>(temp % L[d]);
+                temp /= L[d];
+                if (trans_sym[d]) exp_coef += momentum[d] * disp[d] / static_cast<double>(L[d]);
+            }
+            assert(phase_pos(disp, L) == n);
+            phase_repr[sec_repr][n] = std::exp(std::complex<double>(0.0, 2.0 * pi * exp_coef));
+        }
         auto base_sub = latt_sub.Linear_size();
         std::cout << "Momentum: (" << std::flush;
         for (uint32_t j = 0; j < momentum.size(); j++) {
@@ -287,42 +415,28 @@ namespace qbasis {
             dim_repr[sec_repr] = 0;
             auto report = basis_sub_repr.size() > 100 ? (basis_sub_repr.size() / 10) : basis_sub_repr.size();
             
-            std::vector<std::vector<uint32_t>> plans_parent(num_threads);
-            std::vector<std::vector<uint32_t>> plans_sub(num_threads);
-            std::vector<std::vector<int>> scratch_works(num_threads);
-            std::vector<std::vector<int>> scratch_coors(num_threads);
-            
             #pragma omp parallel for schedule(dynamic,256)
             for (decltype(basis_sub_repr.size()) ra = 0; ra < basis_sub_repr.size(); ra++) {
-                int tid = omp_get_thread_num();
                 if (ra > 0 && ra % report == 0) {
                     std::cout << "progress: "
                     << (static_cast<double>(ra) / static_cast<double>(basis_sub_repr.size()) * 100.0) << "%" << std::endl;
                 }
                 std::vector<qbasis::mbasis_elem> basis_temp_job;
-                auto ga = belong2group_sub[ra];
+                uint64_t ga = belong2group_sub[ra];
+                uint64_t num_groups = groups_sub.size();
                 int sgn;
                 for (decltype(ra) rb = (dim_spec_involved?ra:0); rb < basis_sub_repr.size(); rb++) {
-                    auto gb = belong2group_sub[rb];
+                    uint64_t gb = belong2group_sub[rb];
+                    uint64_t pos_g = static_cast<uint64_t>((ra > rb) + (ra >= rb)) + 3 * (ga + num_groups * gb);
                     std::vector<uint32_t> disp_j(latt_sub.dimension(),0);
                     std::vector<int> disp_j_int(disp_j.size());
                     while (! dynamic_base_overflow(disp_j, base_sub)) {
-                        auto pos = std::vector<uint64_t>{ga,gb};
-                        pos.insert(pos.end(), disp_j.begin(), disp_j.end());
-                        uint32_t omega;
-                        if (ra < rb) {
-                            omega = Weisse_w_lt.index(pos);
-                        } else if (ra == rb) {
-                            omega = Weisse_w_eq.index(pos);
-                        } else {
-                            omega = Weisse_w_gt.index(pos);
-                        }
+                        for (uint32_t j = 0; j < latt_sub.dimension(); j++) disp_j_int[j] = static_cast<int>(disp_j[j]);
+                        uint32_t omega = Weisse_w_flat[pos_g + Weisse_offset(disp_j_int)];
                         
                         if (omega < groups_parent.size()) {  // valid representative
                             mbasis_elem rb_new = basis_sub_repr[rb];
-                            for (uint32_t j = 0; j < latt_sub.dimension(); j++) disp_j_int[j] = static_cast<int>(disp_j[j]);
-                            latt_sub.translation_plan(plans_sub[tid], disp_j_int, scratch_coors[tid], scratch_works[tid]);
-                            rb_new.transform(props_sub_b, plans_sub[tid], sgn);
+                            rb_new.transform(props_sub_b, latt_sub.translation_plan(disp_j_int), sgn);
                             mbasis_elem ra_z_Tj_rb;
                             zipper_basis(props, props_sub_a, props_sub_b, basis_sub_repr[ra], rb_new, ra_z_Tj_rb);
                             // check if the symmetries are obeyed
@@ -398,22 +512,15 @@ namespace qbasis {
             uint64_t state_sub1_label, state_sub2_label;
             basis_repr[sec_repr][j].label_sub(props, state_sub1_label, state_sub2_label,
                                               scratch_works1[tid], scratch_works2[tid]);
-            auto &ra_label = belong2rep_sub[state_sub1_label];
-            auto &rb_label = belong2rep_sub[state_sub2_label];
-            auto &ga = belong2group_sub[ra_label];
-            auto &gb = belong2group_sub[rb_label];
-            std::vector<uint64_t> pos_w{ga, gb};
-            pos_w.insert(pos_w.end(), dist2rep_sub[state_sub2_label].begin(), dist2rep_sub[state_sub2_label].end());
-            uint32_t g_label;
-            if (ra_label < rb_label) {
-                g_label = Weisse_w_lt.index(pos_w);
-            } else if (ra_label == rb_label) {
-                g_label = Weisse_w_eq.index(pos_w);
-            } else {
-                g_label = Weisse_w_gt.index(pos_w);
-            }
+            auto ra_label = belong2rep_sub[state_sub1_label];
+            auto rb_label = belong2rep_sub[state_sub2_label];
+            uint64_t ga = belong2group_sub[ra_label];
+            uint64_t gb = belong2group_sub[rb_label];
+            uint64_t num_groups = groups_sub.size();
+            uint32_t g_label = Weisse_w_flat[static_cast<uint64_t>((ra_label > rb_label) + (ra_label >= rb_label))
+                                             + 3 * (ga + num_groups * gb) + Weisse_off_a[state_sub2_label]];
             
-            norm_repr[sec_repr][j] = norm_trans_repr(props, basis_repr[sec_repr][j], latt_parent, groups_parent[g_label], momentum);
+            norm_repr[sec_repr][j] = std::sqrt(norm_trans_repr(props, basis_repr[sec_repr][j], latt_parent, groups_parent[g_label], momentum));
             if (std::abs(norm_repr[sec_repr][j]) < lanczos_precision) {
                 #pragma omp atomic
                 extra++;
@@ -529,8 +636,7 @@ namespace qbasis {
             if (sub != 0) continue;
             
             std::vector<uint32_t> plan;
-            std::vector<int> scratch_work, scratch_coor;
-            latt_parent.translation_plan(plan, disp, scratch_coor, scratch_work);
+            latt_parent.translation_plan(plan, disp);
             auto basis_temp = gs_vrnl;
             basis_temp.transform(props, plan, sgn);
             if (basis_temp == gs_vrnl) cnt_repeat++;
@@ -557,8 +663,125 @@ namespace qbasis {
     
     
     template <typename T>
-    void model<T>::generate_Ham_sparse_full(const uint32_t &sec_full,
-                                            const bool &upper_triangle)
+    std::string model<T>::Ham_hash(const std::string &basis_type, const uint32_t &sec, const bool &upper_triangle,
+                                   const uint32_t &sec_full) const
+    {
+        typedef boost::crc_optimal<64, 0x42F0E1EBA9EA3693ULL, 0xFFFFFFFFFFFFFFFFULL, 0xFFFFFFFFFFFFFFFFULL, true, true> crc_64_type;
+        crc_64_type res_crc;
+        auto add = [&res_crc](const void *pos, const uint64_t &size) { res_crc.process_bytes(pos, size); };
+        auto add_size = [&add](const uint64_t &n) { add(&n, sizeof(n)); };
+        auto add_str = [&](const std::string &s) {
+            add_size(s.size());
+            add(s.data(), s.size());
+        };
+        // a large basis is hashed in blocks of states, in parallel
+        auto add_basis = [&](const std::vector<mbasis_elem> &basis) {
+            uint64_t n = basis.size();
+            add_size(n);
+            if (n == 0) return;
+            uint16_t total_bytes = static_cast<uint16_t>(basis[0].mbits[0] * 256) + static_cast<uint16_t>(basis[0].mbits[1]);
+            const uint64_t blk = 65536;
+            std::vector<uint64_t> checksums((n + blk - 1) / blk);
+            #pragma omp parallel for schedule(dynamic,1)
+            for (uint64_t b = 0; b < checksums.size(); b++) {
+                crc_64_type blk_crc;
+                for (uint64_t j = b * blk; j < std::min(n, (b + 1) * blk); j++)
+                    blk_crc.process_bytes(basis[j].mbits, total_bytes);
+                checksums[b] = blk_crc.checksum();
+            }
+            add(checksums.data(), sizeof(uint64_t) * checksums.size());
+        };
+        auto add_latt = [&]() {
+            auto L  = latt_parent.Linear_size();
+            auto bc = latt_parent.boundary();
+            add_size(L.size());
+            add(L.data(), sizeof(uint32_t) * L.size());
+            for (auto &b : bc) add_str(b);
+            add_size(latt_parent.num_sublattice());
+            std::vector<double> cart;
+            for (uint32_t d = 0; d <= L.size(); d++) {                            // origin, and the unit vectors
+                std::vector<int> coor(L.size(), 0);
+                if (d < L.size()) coor[d] = 1;
+                for (uint32_t sub = 0; sub < latt_parent.num_sublattice(); sub++) {
+                    latt_parent.coor2cart(coor, static_cast<int>(sub), cart);
+                    add(cart.data(), sizeof(double) * cart.size());
+                }
+            }
+        };
+        
+        add_str(basis_type);
+        uint64_t sizes[3] = {sizeof(T), sizeof(MKL_INT), static_cast<uint64_t>(upper_triangle)};
+        add(sizes, sizeof(sizes));
+        for (auto &prop : props) {
+            add(&prop.dim_local, sizeof(prop.dim_local));
+            add(&prop.num_sites, sizeof(prop.num_sites));
+            add(&prop.dilute, sizeof(prop.dilute));
+            add_str(prop.name);
+            add_size(prop.Nfermion_map.size());
+            add(prop.Nfermion_map.data(), sizeof(uint32_t) * prop.Nfermion_map.size());
+        }
+        for (auto Ham : {&Ham_diag, &Ham_off_diag}) {
+            add_size(Ham->mats.size());
+            for (auto &prod : Ham->mats) {
+                add(&prod.coeff, sizeof(T));
+                add_size(prod.mat_prod.size());
+                for (auto &op : prod.mat_prod) {
+                    add(&op.site, sizeof(op.site));
+                    add(&op.orbital, sizeof(op.orbital));
+                    add(&op.dim, sizeof(op.dim));
+                    add(&op.fermion, sizeof(op.fermion));
+                    add(&op.diagonal, sizeof(op.diagonal));
+                    add(op.mat, sizeof(T) * (op.diagonal ? op.dim : op.dim * op.dim));
+                }
+            }
+        }
+        
+        if (basis_type == "full") {
+            add_basis(basis_full[sec]);
+        } else if (basis_type == "repr") {
+            add_basis(basis_repr[sec]);
+            add(momenta[sec].data(), sizeof(int) * momenta[sec].size());
+            for (bool t : trans_sym) add_size(t);
+            add(&fake_pos, sizeof(fake_pos));
+            add_latt();
+        } else if (basis_type == "vrnl") {
+            add_basis(basis_vrnl[sec]);
+            add(momenta_vrnl[sec].data(), sizeof(double) * momenta_vrnl[sec].size());
+            add_basis({gs_vrnl});
+            add_latt();
+        } else if (basis_type == "repr_deprecated") {
+            add_basis(basis_full[sec_full]);
+            add_size(basis_repr_deprec[sec].size());
+            add(basis_repr_deprec[sec].data(), sizeof(MKL_INT) * basis_repr_deprec[sec].size());
+            add(basis_belong_deprec[sec_full].data(), sizeof(MKL_INT) * basis_belong_deprec[sec_full].size());
+            add(basis_coeff_deprec[sec_full].data(), sizeof(std::complex<double>) * basis_coeff_deprec[sec_full].size());
+            add(&fake_pos, sizeof(fake_pos));
+        } else {
+            assert(false);
+        }
+        
+        std::ostringstream res;
+        res << std::hex << std::setw(16) << std::setfill('0') << res_crc.checksum();
+        return res.str();
+    }
+    
+    template <typename T>
+    std::string model<T>::csr_cache_file(const std::string &basis_type, const uint32_t &sec, const bool &upper_triangle,
+                                         const uint32_t &sec_full) const
+    {
+        if (csr_cache.empty()) return "";
+        fs::path dir(csr_cache);
+        if (! fs::exists(dir)) fs::create_directories(dir);
+        auto file = dir / ("H_" + basis_type + "_" + Ham_hash(basis_type, sec, upper_triangle, sec_full) + ".qbcsr");
+        return file.string();
+    }
+    
+    template <typename T>
+        void model<T>::generate_Ham_sparse_full(const uint32_t &sec_full,
+                                            const bool &upper_triangle,
+                                            const bool &check_hermitian,
+                                            const std::string &csr_index,
+                                            const std::string &csr_file)
     {
         if (matrix_free) matrix_free = false;
         MKL_INT dim      = dim_full[sec_full];
@@ -567,55 +790,51 @@ namespace qbasis {
         auto &Lin_Jb     = Lin_Jb_full[sec_full];
         auto &HamMat_csr = HamMat_csr_full[sec_full];
         assert(dim > 0);
+        perm_full[sec_full].clear();
         
-        int num_threads = 1;
-        #pragma omp parallel
-        {
-            int tid = omp_get_thread_num();
-            if (tid == 0) num_threads = omp_get_num_threads();
+        auto cache_file = csr_cache_file("full", sec_full, upper_triangle);
+        if (! cache_file.empty() && HamMat_csr.load(cache_file, ! csr_file.empty()) == 0) {
+            if (csr_index != "mkl_int") HamMat_csr.set_index(csr_index);
+            HamMat_csr.use_real_values();
+            std::cout << "Hamiltonian CSR matrix (full) reloaded, skipping the generation." << std::endl;
+            return;
         }
-        // prepare intermediates in advance
-        std::vector<wavefunction<T>> intermediate_states(num_threads, {basis[0]});
-        std::vector<std::vector<uint8_t>> scratch_works1(num_threads);
-        std::vector<std::vector<uint64_t>> scratch_works2(num_threads);
         
-        std::cout << "Generating LIL Hamiltonian matrix (full)..." << std::endl;
+        scratch_prepare();
+        compile_Ham_off_diag();
+        
+        std::cout << "Generating CSR Hamiltonian matrix (full)..." << std::endl;
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
-        lil_mat<T> matrix_lil(dim, upper_triangle);
-        #pragma omp parallel for schedule(dynamic,1)
-        for (MKL_INT i = 0; i < dim; i++) {
-            int tid = omp_get_thread_num();
+        auto gen_row = [&](const MKL_INT &i, std::vector<std::pair<MKL_INT,T>> &row) {
+            auto &sc = scratch[omp_get_thread_num()];
             // diagonal part:
             for (auto it = Ham_diag.mats.begin(); it != Ham_diag.mats.end(); it++) {
-                matrix_lil.add(i, i, basis[i].diagonal_operator(props, *it));
+                row.emplace_back(i, basis[i].diagonal_operator(props, *it));
             }
             
             // non-diagonal part:
             uint64_t i_a, i_b;
             MKL_INT j;
-            for (auto it = Ham_off_diag.mats.begin(); it != Ham_off_diag.mats.end(); it++) {
-                intermediate_states[tid].copy(basis[i]);
-                oprXphi(*it, props, intermediate_states[tid]);
-                for (MKL_INT cnt = 0; cnt < intermediate_states[tid].size(); cnt++) {
-                    auto &ele_new = intermediate_states[tid][cnt];
-                    if (std::abs(ele_new.second) < machine_prec) continue;
-                    if (Lin_Ja.size() > 0 && Lin_Jb.size() > 0) {
-                        ele_new.first.label_sub(props, i_a, i_b, scratch_works1[tid], scratch_works2[tid]);
-                        j = Lin_Ja[i_a] + Lin_Jb[i_b];
-                    } else {
-                        j = binary_search<mbasis_elem,MKL_INT>(basis, ele_new.first, 0, dim);
-                    }
-                    if (j < 0 || j >= dim) continue;
-                    if (upper_triangle) {
-                        if (i <= j) matrix_lil.add(i, j, conjugate(ele_new.second));
-                    } else {
-                        matrix_lil.add(i, j, conjugate(ele_new.second));
-                    }
+            Ham_off_diag_compiled.apply(basis[i], sc.intermediate_state);
+            for (MKL_INT cnt = 0; cnt < sc.intermediate_state.size(); cnt++) {
+                auto &ele_new = sc.intermediate_state[cnt];
+                if (std::abs(ele_new.second) < machine_prec) continue;
+                if (Lin_Ja.size() > 0 && Lin_Jb.size() > 0) {
+                    ele_new.first.label_sub(props, i_a, i_b, sc.work1, sc.work2);
+                    j = Lin_Ja[i_a] + Lin_Jb[i_b];
+                } else {
+                    j = binary_search<mbasis_elem,MKL_INT>(basis, ele_new.first, 0, dim);
                 }
+                if (j < 0 || j >= dim) continue;
+                if (upper_triangle && i > j) continue;
+                row.emplace_back(j, conjugate(ele_new.second));
             }
-        }
-        HamMat_csr = csr_mat<T>(matrix_lil);
+        };
+        HamMat_csr = csr_mat<T>(dim, upper_triangle, gen_row, check_hermitian, csr_file);
+        if (! cache_file.empty()) HamMat_csr.save(cache_file);
+        if (csr_index != "mkl_int") HamMat_csr.set_index(csr_index);
+        HamMat_csr.use_real_values();
         std::cout << "Hamiltonian CSR matrix (full) generated." << std::endl;
         end = std::chrono::system_clock::now();
         std::chrono::duration<double> elapsed_seconds = end - start;
@@ -624,7 +843,10 @@ namespace qbasis {
     
     template <typename T>
     void model<T>::generate_Ham_sparse_repr(const uint32_t &sec_repr,
-                                            const bool &upper_triangle)
+                                            const bool &upper_triangle,
+                                            const bool &check_hermitian,
+                                            const std::string &csr_index,
+                                            const std::string &csr_file)
     {
         if (matrix_free) matrix_free = false;
         MKL_INT dim      = dim_repr[sec_repr];
@@ -632,138 +854,96 @@ namespace qbasis {
         auto &norm       = norm_repr[sec_repr];
         auto &Lin_Ja     = Lin_Ja_repr[sec_repr];
         auto &Lin_Jb     = Lin_Jb_repr[sec_repr];
-        auto &momentum   = momenta[sec_repr];
         auto &HamMat_csr = HamMat_csr_repr[sec_repr];
         assert(dim > 0);
-        
-        if (dim_spec_involved) {
-            assert(Weisse_w_gt.size() == 0);
-        } else {
-            assert(Weisse_w_lt.size() == Weisse_w_gt.size());
-        }
-        int num_threads = 1;
-        #pragma omp parallel
-        {
-            int tid = omp_get_thread_num();
-            if (tid == 0) num_threads = omp_get_num_threads();
+        perm_repr[sec_repr].clear();
+        
+        assert(Weisse_e_flat.size() > 0);
+        auto cache_file = csr_cache_file("repr", sec_repr, upper_triangle);
+        if (! cache_file.empty() && HamMat_csr.load(cache_file, ! csr_file.empty()) == 0) {
+            if (csr_index != "mkl_int") HamMat_csr.set_index(csr_index);
+            HamMat_csr.use_real_values();
+            std::cout << "Hamiltonian CSR matrix (repr) reloaded, skipping the generation." << std::endl;
+            return;
         }
-        // prepare intermediates in advance
-        std::vector<wavefunction<T>> intermediate_states(num_threads, {basis[0]});
-        auto dim_latt = latt_parent.dimension();
+        
+        scratch_prepare();
+        compile_Ham_off_diag();
         auto L = latt_parent.Linear_size();
         bool bosonic = q_bosonic(props);
-        std::vector<std::vector<uint32_t>> plans_parent(num_threads);
-        std::vector<std::vector<uint32_t>> plans_sub(num_threads);
-        std::vector<std::vector<int>> scratch_works(num_threads);
-        std::vector<std::vector<int>> scratch_coors(num_threads);
-        std::vector<std::vector<uint8_t>> scratch_works1(num_threads);
-        std::vector<std::vector<uint64_t>> scratch_works2(num_threads);
         
-        std::cout << "Generating LIL Hamiltonian Matrix (repr)..." << std::endl;
+        std::cout << "Generating CSR Hamiltonian Matrix (repr)..." << std::endl;
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
         
-        lil_mat<std::complex<double>> matrix_lil(dim, upper_triangle);
-        #pragma omp parallel for schedule(dynamic,1)
-        for (MKL_INT i = 0; i < dim; i++) {
-            int tid = omp_get_thread_num();
+        auto gen_row = [&](const MKL_INT &i, std::vector<std::pair<MKL_INT,std::complex<double>>> &row) {
+            auto &sc = scratch[omp_get_thread_num()];
             
             double nu_i = norm[i];                                               // normalization factor for repr i
             if (std::abs(nu_i) < lanczos_precision) {
-                matrix_lil.add(i, i, static_cast<T>(fake_pos + static_cast<double>(i)/static_cast<double>(dim)));
-                continue;
+                row.emplace_back(i, static_cast<T>(fake_pos + static_cast<double>(i)/static_cast<double>(dim)));
+                return;
             }
             
             // diagonal part:
             for (uint32_t cnt = 0; cnt < Ham_diag.size(); cnt++)
-                matrix_lil.add(i, i, basis[i].diagonal_operator(props,Ham_diag[cnt]));
+                row.emplace_back(i, basis[i].diagonal_operator(props,Ham_diag[cnt]));
             
             // non-diagonal part:
             uint64_t state_sub1_label, state_sub2_label;
-            std::vector<uint32_t> disp_i(dim_latt), disp_j(dim_latt);
-            std::vector<int> disp_i_int(dim_latt), disp_j_int(dim_latt);
             int sgn;
-            mbasis_elem state_sub_new1, state_sub_new2, ra_z_Tj_rb;
             uint64_t i_a, i_b;
             MKL_INT j;
-            for (auto it = Ham_off_diag.mats.begin(); it != Ham_off_diag.mats.end(); it++) {
-                intermediate_states[tid].copy(basis[i]);
-                oprXphi(*it, props, intermediate_states[tid]);
+            Ham_off_diag_compiled.apply(basis[i], sc.intermediate_state);
+            for (MKL_INT cnt = 0; cnt < sc.intermediate_state.size(); cnt++) {
+                auto &ele_new = sc.intermediate_state[cnt];
+                // use Weisse Tables to find the representative |ra,rb,j>
+                ele_new.first.label_sub(props, state_sub1_label, state_sub2_label,
+                                        sc.work1, sc.work2);
+                auto &state_rep1_label = belong2rep_sub[state_sub1_label];       // ra
+                auto &state_rep2_label = belong2rep_sub[state_sub2_label];       // rb
+                const uint32_t *disp = Weisse_e_flat.data() + Weisse_e_pos(state_sub1_label, state_sub2_label);
+                for (uint32_t d = 0; d < sc.disp_j_int.size(); d++) {
+                    sc.disp_i_int[d] = static_cast<int>(disp[d]);
+                    sc.disp_j_int[d] = static_cast<int>(disp[sc.disp_j_int.size() + d]);
+                }
                 
-                for (MKL_INT cnt = 0; cnt < intermediate_states[tid].size(); cnt++) {
-                    auto &ele_new = intermediate_states[tid][cnt];
-                    // use Weisse Tables to find the representative |ra,rb,j>
-                    ele_new.first.label_sub(props, state_sub1_label, state_sub2_label,
-                                            scratch_works1[tid], scratch_works2[tid]);
-                    auto &state_rep1_label = belong2rep_sub[state_sub1_label];       // ra
-                    auto &state_rep2_label = belong2rep_sub[state_sub2_label];       // rb
-                    auto &ga               = belong2group_sub[state_rep1_label];     // ga
-                    auto &gb               = belong2group_sub[state_rep2_label];     // gb
-                    std::vector<uint64_t> pos_e{ga, gb};
-                    pos_e.insert(pos_e.end(), dist2rep_sub[state_sub1_label].begin(), dist2rep_sub[state_sub1_label].end());
-                    pos_e.insert(pos_e.end(), dist2rep_sub[state_sub2_label].begin(), dist2rep_sub[state_sub2_label].end());
-                    if (state_rep1_label < state_rep2_label) {                          // ra < rb
-                        disp_i = Weisse_e_lt.index(pos_e).first;
-                        disp_j = Weisse_e_lt.index(pos_e).second;
-                    } else if (state_rep2_label < state_rep1_label) {                   // ra > rb
-                        disp_i = Weisse_e_gt.index(pos_e).first;
-                        disp_j = Weisse_e_gt.index(pos_e).second;
-                    } else {                                                            // ra == rb
-                        disp_i = Weisse_e_eq.index(pos_e).first;
-                        disp_j = Weisse_e_eq.index(pos_e).second;
-                    }
-                    for (uint32_t j = 0; j < disp_j.size(); j++) {
-                        disp_i_int[j] = static_cast<int>(disp_i[j]);
-                        disp_j_int[j] = static_cast<int>(disp_j[j]);
-                    }
-                    
-                    if (state_rep2_label < state_rep1_label && dim_spec_involved) {
-                        state_sub_new1 = basis_sub_repr[state_rep2_label];
-                        state_sub_new2 = basis_sub_repr[state_rep1_label];
-                    } else {
-                        state_sub_new1 = basis_sub_repr[state_rep1_label];
-                        state_sub_new2 = basis_sub_repr[state_rep2_label];
-                    }
-                    latt_sub.translation_plan(plans_sub[tid], disp_j_int, scratch_coors[tid], scratch_works[tid]);
-                    state_sub_new2.transform(props_sub_b, plans_sub[tid], sgn);    // T_j |rb>
-                    zipper_basis(props, props_sub_a, props_sub_b, state_sub_new1, state_sub_new2, ra_z_Tj_rb); // |ra> z T_j |rb>
-                    
-                    if (Lin_Ja.size() > 0 && Lin_Jb.size() > 0) {
-                        i_a = state_sub_new1.label(props_sub_a, scratch_works1[tid], scratch_works2[tid]);    // use Lin Tables
-                        i_b = state_sub_new2.label(props_sub_b, scratch_works1[tid], scratch_works2[tid]);
-                        j = Lin_Ja[i_a] + Lin_Jb[i_b];
-                    } else {
-                        j = binary_search<mbasis_elem,MKL_INT>(basis, ra_z_Tj_rb, 0, dim);
-                    }
-                    if (j < 0 || j >= dim) continue;
-                    assert(ra_z_Tj_rb == basis[j]);
-                    double nu_j = norm[j];
-                    if (std::abs(nu_j) < lanczos_precision) continue;
-                    
-                    double exp_coef = 0.0;
-                    for (uint32_t d = 0; d < latt_parent.dimension(); d++) {
-                        if (trans_sym[d]) {
-                            exp_coef += momentum[d] * disp_i_int[d] / static_cast<double>(L[d]);
-                        }
-                    }
-                    auto coef = std::sqrt(nu_i / nu_j) * conjugate(ele_new.second) * std::exp(std::complex<double>(0.0, 2.0 * pi * exp_coef));
-                    if (! bosonic) {
-                        latt_parent.translation_plan(plans_parent[tid], disp_i_int, scratch_coors[tid], scratch_works[tid]);
-                        ra_z_Tj_rb.transform(props, plans_parent[tid], sgn);      // to get sgn
-                        assert(ra_z_Tj_rb == ele_new.first);
-                        if (sgn % 2 == 1) coef *= std::complex<double>(-1.0, 0.0);
-                    }
-                    
-                    if (upper_triangle) {
-                        if (i <= j) matrix_lil.add(i, j, coef);
-                    } else {
-                        matrix_lil.add(i, j, coef);
-                    }
+                if (state_rep2_label < state_rep1_label && dim_spec_involved) {
+                    sc.state_sub_new1 = basis_sub_repr[state_rep2_label];
+                    sc.state_sub_new2 = basis_sub_repr[state_rep1_label];
+                } else {
+                    sc.state_sub_new1 = basis_sub_repr[state_rep1_label];
+                    sc.state_sub_new2 = basis_sub_repr[state_rep2_label];
+                }
+                sc.state_sub_new2.transform(props_sub_b, latt_sub.translation_plan(sc.disp_j_int), sgn);    // T_j |rb>
+                zipper_basis(props, props_sub_a, props_sub_b, sc.state_sub_new1, sc.state_sub_new2, sc.ra_z_Tj_rb); // |ra> z T_j |rb>
+                
+                if (Lin_Ja.size() > 0 && Lin_Jb.size() > 0) {
+                    i_a = sc.state_sub_new1.label(props_sub_a, sc.work1, sc.work2);    // use Lin Tables
+                    i_b = sc.state_sub_new2.label(props_sub_b, sc.work1, sc.work2);
+                    j = Lin_Ja[i_a] + Lin_Jb[i_b];
+                } else {
+                    j = binary_search<mbasis_elem,MKL_INT>(basis, sc.ra_z_Tj_rb, 0, dim);
+                }
+                if (j < 0 || j >= dim) continue;
+                assert(sc.ra_z_Tj_rb == basis[j]);
+                double nu_j = norm[j];
+                if (std::abs(nu_j) < lanczos_precision) continue;
+                
+                auto coef = nu_i / nu_j * conjugate(ele_new.second) * phase_repr[sec_repr][phase_pos(sc.disp_i_int, L)];
+                if (! bosonic) {
+                    sgn = sc.ra_z_Tj_rb.transform_sign(props, latt_parent.translation_plan(sc.disp_i_int));   // T_i (|ra> z T_j |rb>) is the new state
+                    if (sgn % 2 == 1) coef *= std::complex<double>(-1.0, 0.0);
                 }
+                
+                if (upper_triangle && i > j) continue;
+                row.emplace_back(j, coef);
             }
-        }
-        
-        HamMat_csr = csr_mat<std::complex<double>>(matrix_lil);
+        };
+        HamMat_csr = csr_mat<std::complex<double>>(dim, upper_triangle, gen_row, check_hermitian, csr_file);
+        if (! cache_file.empty()) HamMat_csr.save(cache_file);
+        if (csr_index != "mkl_int") HamMat_csr.set_index(csr_index);
+        HamMat_csr.use_real_values();
         std::cout << "Hamiltonian CSR matrix (repr) generated." << std::endl;
         end = std::chrono::system_clock::now();
         std::chrono::duration<double> elapsed_seconds = end - start;
@@ -772,7 +952,10 @@ namespace qbasis {
     
     template <typename T>
     void model<T>::generate_Ham_sparse_vrnl(const uint32_t &sec_vrnl,
-                                            const bool &upper_triangle)
+                                            const bool &upper_triangle,
+                                            const bool &check_hermitian,
+                                            const std::string &csr_index,
+                                            const std::string &csr_file)
     {
         if (matrix_free) matrix_free = false;
         MKL_INT dim      = dim_vrnl[sec_vrnl];
@@ -781,21 +964,11 @@ namespace qbasis {
         auto &HamMat_csr = HamMat_csr_vrnl[sec_vrnl];
         assert(dim > 0);
         
-        int num_threads = 1;
-        #pragma omp parallel
-        {
-            int tid = omp_get_thread_num();
-            if (tid == 0) num_threads = omp_get_num_threads();
-        }
-        // prepare intermediates in advance
-        std::vector<wavefunction<T>> intermediate_states(num_threads, {gs_vrnl});
-        std::vector<std::vector<int>> scratch_disp(num_threads);
-        std::vector<std::vector<double>> scratch_cart(num_threads);
+        scratch_prepare();
         
-        std::cout << "Generating LIL Hamiltonian matrix (vrnl)..." << std::endl;
+        std::cout << "Generating CSR Hamiltonian matrix (vrnl)..." << std::endl;
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
-        lil_mat<T> matrix_lil(dim, upper_triangle);
         
         // ground state energy
         if (std::abs(gs_E0_vrnl - 100.0) < lanczos_precision) {
@@ -803,18 +976,19 @@ namespace qbasis {
             gs_E0_vrnl = 0.0;
             for (decltype(Ham_diag.size()) cnt = 0; cnt < Ham_diag.size(); cnt++)
                 gs_E0_vrnl += gs_vrnl.diagonal_operator(props, Ham_diag[cnt]).real();
+            auto &sc = scratch[0];
             for (auto it = Ham_off_diag.mats.begin(); it != Ham_off_diag.mats.end(); it++) {
-                intermediate_states[0].copy(gs_vrnl);
-                oprXphi(*it, props, intermediate_states[0]);
-                for (MKL_INT cnt = 0; cnt < intermediate_states[0].size(); cnt++) {
-                    auto &ele_new = intermediate_states[0][cnt];
+                sc.intermediate_state.copy(gs_vrnl);
+                oprXphi(*it, props, sc.intermediate_state);
+                for (MKL_INT cnt = 0; cnt < sc.intermediate_state.size(); cnt++) {
+                    auto &ele_new = sc.intermediate_state[cnt];
                     auto unique_state = ele_new.first;
-                    unique_state.translate_to_unique_state(props,latt_parent,scratch_disp[0]);
+                    unique_state.translate_to_unique_state(props,latt_parent,sc.disp_i_int);
                     if (unique_state != gs_vrnl) continue;
-                    latt_parent.coor2cart(scratch_disp[0], 0, scratch_cart[0]);
+                    latt_parent.coor2cart(sc.disp_i_int, 0, sc.cart);
                     double exp_coef = 0.0;
                     for (uint32_t d = 0; d < latt_parent.dimension(); d++) {
-                        exp_coef += gs_momentum_vrnl[d] * scratch_cart[0][d];
+                        exp_coef += gs_momentum_vrnl[d] * sc.cart[d];
                     }
                     auto coeff = static_cast<double>(gs_omegaG_vrnl) / NsitesPsublatt * std::exp(std::complex<double>(0.0,exp_coef));
                     gs_E0_vrnl += coeff.real();
@@ -822,36 +996,46 @@ namespace qbasis {
             }
         }
         
-        #pragma omp parallel for schedule(dynamic,256)
-        for (MKL_INT i = 0; i < dim; i++) {
-            int tid = omp_get_thread_num();
+        auto cache_file = csr_cache_file("vrnl", sec_vrnl, upper_triangle);
+        if (! cache_file.empty() && HamMat_csr.load(cache_file, ! csr_file.empty()) == 0) {
+            if (csr_index != "mkl_int") HamMat_csr.set_index(csr_index);
+            HamMat_csr.use_real_values();
+            std::cout << "Hamiltonian CSR matrix (vrnl) reloaded, skipping the generation." << std::endl;
+            return;
+        }
+        
+        auto gen_row = [&](const MKL_INT &i, std::vector<std::pair<MKL_INT,T>> &row) {
+            auto &sc = scratch[omp_get_thread_num()];
             
             // diagonal part
             for (decltype(Ham_diag.size()) cnt = 0; cnt < Ham_diag.size(); cnt++)
-                matrix_lil.add(i, i, basis[i].diagonal_operator(props,Ham_diag[cnt]));
+                row.emplace_back(i, basis[i].diagonal_operator(props,Ham_diag[cnt]));
             
             // non-diagonal part
             for (auto it = Ham_off_diag.mats.begin(); it != Ham_off_diag.mats.end(); it++) {
-                intermediate_states[tid].copy(basis[i]);
-                oprXphi(*it, props, intermediate_states[tid]);
-                for (MKL_INT cnt = 0; cnt < intermediate_states[tid].size(); cnt++) {
-                    auto &ele_new = intermediate_states[tid][cnt];
+                sc.intermediate_state.copy(basis[i]);
+                oprXphi(*it, props, sc.intermediate_state);
+                for (MKL_INT cnt = 0; cnt < sc.intermediate_state.size(); cnt++) {
+                    auto &ele_new = sc.intermediate_state[cnt];
                     auto unique_state = ele_new.first;
-                    unique_state.translate_to_unique_state(props,latt_parent,scratch_disp[tid]);
+                    unique_state.translate_to_unique_state(props,latt_parent,sc.disp_i_int);
                     MKL_INT j = binary_search<mbasis_elem,MKL_INT>(basis, unique_state, 0, dim);   // < j | H | i >
                     if (j < 0 || j >= dim) continue;
                     if (upper_triangle && i > j) continue;
-                    latt_parent.coor2cart(scratch_disp[tid], 0, scratch_cart[tid]);
+                    latt_parent.coor2cart(sc.disp_i_int, 0, sc.cart);
                     double exp_coef = 0.0;
                     for (uint32_t d = 0; d < latt_parent.dimension(); d++) {
-                        exp_coef += momentum[d] * scratch_cart[tid][d];
+                        exp_coef += momentum[d] * sc.cart[d];
                     }
                     auto coeff = std::exp(std::complex<double>(0.0,exp_coef));
-                    matrix_lil.add(i, j, conjugate(coeff*ele_new.second));
+                    row.emplace_back(j, conjugate(coeff*ele_new.second));
                 }
             }
-        }
-        HamMat_csr = csr_mat<T>(matrix_lil);
+        };
+        HamMat_csr = csr_mat<T>(dim, upper_triangle, gen_row, check_hermitian, csr_file);
+        if (! cache_file.empty()) HamMat_csr.save(cache_file);
+        if (csr_index != "mkl_int") HamMat_csr.set_index(csr_index);
+        HamMat_csr.use_real_values();
         std::cout << "Hamiltonian CSR matrix (vrnl) generated." << std::endl;
         end = std::chrono::system_clock::now();
         std::chrono::duration<double> elapsed_seconds = end - start;
@@ -859,6 +1043,59 @@ namespace qbasis {
     }
     
     
+    template <typename T>
+    void model<T>::reorder_Ham_sparse(const uint32_t &sec_sym_, const uint32_t &sec, const std::string &method)
+    {
+        assert(sec_sym_ < 2);
+        assert(method == "rcm" || method == "none");
+        auto &HamMat_csr = (sec_sym_ == 0) ? HamMat_csr_full[sec] : HamMat_csr_repr[sec];
+        auto &perm       = (sec_sym_ == 0) ? perm_full[sec] : perm_repr[sec];
+        assert(HamMat_csr.dimension() > 0);
+        
+        std::vector<MKL_INT> perm_new;
+        if (method == "rcm") {
+            std::cout << "Reordering CSR Hamiltonian matrix (" << (sec_sym_ == 0 ? "full" : "repr") << ")..." << std::endl;
+            perm_new = HamMat_csr.rcm_order();
+        }
+        
+        // the matrix is in the order of perm, first go back to the basis order
+        MKL_INT dim = HamMat_csr.dimension();
+        std::vector<MKL_INT> step(dim);
+        if (perm.empty()) {
+            if (perm_new.empty()) return;
+            step = perm_new;
+        } else if (perm_new.empty()) {
+            for (MKL_INT i = 0; i < dim; i++) step[perm[i]] = i;
+        } else {                                                                 // rcm_order works on the current order
+            for (MKL_INT i = 0; i < dim; i++) step[i] = perm_new[i];
+            for (MKL_INT i = 0; i < dim; i++) perm_new[i] = step[perm[i]];
+        }
+        if (! HamMat_csr.permute(step)) return;
+        swap(perm, perm_new);
+    }
+    
+    template <typename T> template <typename V>
+    void model<T>::perm_vecs(const uint32_t &sec_sym_, const uint32_t &sec, V *vecs, const MKL_INT &ncols, const bool &to_basis) const
+    {
+        if (sec_sym_ > 1) return;
+        auto &perm = (sec_sym_ == 0) ? perm_full[sec] : perm_repr[sec];
+        if (perm.empty()) return;
+        MKL_INT dim = static_cast<MKL_INT>(perm.size());
+        std::vector<V> temp(dim);
+        for (MKL_INT c = 0; c < ncols; c++) {
+            V *vec = vecs + static_cast<uint64_t>(c) * dim;
+            #pragma omp parallel for schedule(static)
+            for (MKL_INT i = 0; i < dim; i++) {
+                if (to_basis) {
+                    temp[i] = vec[perm[i]];
+                } else {
+                    temp[perm[i]] = vec[i];
+                }
+            }
+            std::copy(temp.begin(), temp.end(), vec);
+        }
+    }
+    
     template <typename T>
     std::vector<std::complex<double>> model<T>::to_dense(const uint32_t &sec_mat_)
     {
@@ -875,85 +1112,200 @@ namespace qbasis {
     
     template <typename T>
     void model<T>::MultMv2(const T *x, T *y) const
+    {
+        MultMm2(x, y, 1);
+    }
+    
+    template <typename T>
+    void model<T>::MultMm2(const T *X, T *Y, const MKL_INT &k) const
     {
         assert(matrix_free);
         MKL_INT dim = (sec_sym == 0) ? dim_full[sec_mat] : dim_repr[sec_mat];
         auto &basis = (sec_sym == 0) ? basis_full[sec_mat] : basis_repr[sec_mat];
-        int num_threads = 1;
-        #pragma omp parallel
-        {
-            int tid = omp_get_thread_num();
-            if (tid == 0) num_threads = omp_get_num_threads();
-        }
-        // prepare intermediates in advance
-        std::vector<wavefunction<T>> intermediate_states(num_threads, {basis[0]});
-        std::vector<std::vector<uint32_t>> plans_parent(num_threads);
-        std::vector<std::vector<uint32_t>> plans_sub(num_threads);
-        std::vector<std::vector<int>> scratch_works(num_threads);
-        std::vector<std::vector<int>> scratch_coors(num_threads);
-        std::vector<std::vector<uint8_t>> scratch_works1(num_threads);
-        std::vector<std::vector<uint64_t>> scratch_works2(num_threads);
+        int num_threads = scratch_prepare();
+        compile_Ham_off_diag();
+        const uint64_t ld = static_cast<uint64_t>(k);
+        // row i of X and Y starts at ld * i; helpers acting on the k entries of a row
+        auto nonzero = [k](const T *x) {
+            for (MKL_INT s = 0; s < k; s++) if (std::abs(x[s]) > machine_prec) return true;
+            return false;
+        };
+        auto axpy = [k](const T &a, const T *x, T *y) { for (MKL_INT s = 0; s < k; s++) y[s] += a * x[s]; };
+        #ifdef QBASIS_DEBUG_SCRATCH
+        uint64_t footprint_old = 0, allocs_old = scratch_allocs;
+        for (int tid = 0; tid < num_threads; tid++) footprint_old += scratch[tid].footprint();
+        #endif
         
         std::cout << "*" << std::flush;
-        if (sec_sym == 0) {
+        // row j of the full basis reached from basis state i, -1 if not in the basis
+        auto locate_full = [&](const mbasis_elem &state, scratch_thread &sc) {
+            MKL_INT j;
+            if (Lin_Ja_full[sec_mat].size() > 0 && Lin_Jb_full[sec_mat].size() > 0) {
+                uint64_t i_a, i_b;
+                state.label_sub(props, i_a, i_b, sc.work1, sc.work2);
+                j = Lin_Ja_full[sec_mat][i_a] + Lin_Jb_full[sec_mat][i_b];
+            } else {
+                j = binary_search<mbasis_elem,MKL_INT>(basis, state, 0, dim);
+            }
+            return (j < 0 || j >= dim) ? static_cast<MKL_INT>(-1) : j;
+        };
+        
+        bool upper_triangle = sec_sym == 0 && matrix_free_upper_triangle && Ham_off_diag_split;
+        if (upper_triangle && (sym_sec != sec_mat || static_cast<int>(sym_part.size()) != num_threads + 1)) {
+            // H = half + half^\dagger + self: the transpose conjugate of the hops of block b is scattered to rows outside
+            // of the block only within [sym_lo[b], sym_hi[b]), found here once by generating the hops of each block
+            sym_sec = sec_mat;
+            sym_part.resize(num_threads + 1);
+            for (int b = 0; b <= num_threads; b++)
+                sym_part[b] = static_cast<MKL_INT>(static_cast<int64_t>(dim) * b / num_threads);
+            sym_lo.assign(sym_part.begin(), sym_part.end() - 1);
+            sym_hi.assign(sym_part.begin() + 1, sym_part.end());
+            #pragma omp parallel
+            {
+                auto &sc = scratch[omp_get_thread_num()];
+                int nthreads = omp_get_num_threads();
+                for (int b = omp_get_thread_num(); b < num_threads; b += nthreads) {
+                    for (MKL_INT i = sym_part[b]; i < sym_part[b+1]; i++) {
+                        for (int part = 0; part < 2; part++) {
+                            (part == 0 ? Ham_off_diag_half_compiled : Ham_off_diag_self_compiled).apply(basis[i], sc.intermediate_state);
+                            for (MKL_INT cnt = 0; cnt < sc.intermediate_state.size(); cnt++) {
+                                auto &ele_new = sc.intermediate_state[cnt];
+                                if (std::abs(ele_new.second) < machine_prec) continue;
+                                MKL_INT j = locate_full(ele_new.first, sc);
+                                if (j < 0 || (part == 1 && j <= i)) continue;
+                                sym_lo[b] = std::min(sym_lo[b], j);
+                                sym_hi[b] = std::max(sym_hi[b], j + 1);
+                            }
+                        }
+                    }
+                }
+            }
+            uint64_t len = 0;
+            for (int b = 0; b < num_threads; b++)
+                len += static_cast<uint64_t>(sym_part[b] - sym_lo[b]) + static_cast<uint64_t>(sym_hi[b] - sym_part[b+1]);
+            sym_ok = (len <= static_cast<uint64_t>(dim));
+            if (! sym_ok) {
+                std::cout << "(upper triangle: the hops reach too far for the private buffers, generating all hops)" << std::flush;
+                for (int b = 0; b < num_threads; b++) {                         // release the buffers
+                    scratch[b].y_private.clear();
+                    scratch[b].y_private.shrink_to_fit();
+                }
+            }
+        }
+        
+        if (upper_triangle && sym_ok) {
+            // each element of half is generated only once. rows are cut into one contiguous block per thread,
+            // block b owns Y[sym_part[b] : sym_part[b+1]] and is the only one writing there directly;
+            // the transpose conjugate going outside of the block is scattered into a private buffer covering
+            // [sym_lo[b], sym_part[b]) followed by [sym_part[b+1], sym_hi[b]), and reduced afterwards
+            #pragma omp parallel
+            {
+                auto &sc = scratch[omp_get_thread_num()];
+                int nthreads = omp_get_num_threads();
+                for (int b = omp_get_thread_num(); b < num_threads; b += nthreads) {
+                    MKL_INT row_begin = sym_part[b], row_end = sym_part[b+1];
+                    MKL_INT below = row_begin - sym_lo[b];
+                    auto &yp = scratch[b].y_private;
+                    yp.assign(ld * static_cast<uint64_t>(below + sym_hi[b] - row_end), static_cast<T>(0.0));
+                    for (MKL_INT i = row_begin; i < row_end; i++) {
+                        // diagonal part
+                        if (nonzero(X + ld * i)) {
+                            T diag = static_cast<T>(0.0);
+                            for (uint32_t cnt = 0; cnt < Ham_diag.size(); cnt++)
+                                diag += basis[i].diagonal_operator(props, Ham_diag[cnt]);
+                            axpy(diag, X + ld * i, Y + ld * i);
+                        }
+                        
+                        // non-diagonal part
+                        for (int part = 0; part < 2; part++) {
+                            (part == 0 ? Ham_off_diag_half_compiled : Ham_off_diag_self_compiled).apply(basis[i], sc.intermediate_state);
+                            for (MKL_INT cnt = 0; cnt < sc.intermediate_state.size(); cnt++) {
+                                auto &ele_new = sc.intermediate_state[cnt];
+                                if (std::abs(ele_new.second) < machine_prec) continue;
+                                MKL_INT j = locate_full(ele_new.first, sc);
+                                if (j < 0) continue;
+                                if (part == 1 && j < i) continue;                   // counted when working on row j
+                                axpy(conjugate(ele_new.second), X + ld * j, Y + ld * i);
+                                if (part == 1 && j == i) continue;
+                                if (j >= row_begin && j < row_end) {
+                                    axpy(ele_new.second, X + ld * i, Y + ld * j);
+                                } else {
+                                    MKL_INT pos = (j < row_begin) ? j - sym_lo[b] : below + j - row_end;
+                                    axpy(ele_new.second, X + ld * i, yp.data() + ld * pos);
+                                }
+                            }
+                        }
+                    }
+                }
+                #pragma omp barrier
+                #pragma omp for schedule(dynamic,256)
+                for (MKL_INT j = 0; j < dim; j++) {
+                    for (int b = 0; b < num_threads; b++) {
+                        MKL_INT pos;
+                        if (j >= sym_lo[b] && j < sym_part[b]) {
+                            pos = j - sym_lo[b];
+                        } else if (j >= sym_part[b+1] && j < sym_hi[b]) {
+                            pos = sym_part[b] - sym_lo[b] + j - sym_part[b+1];
+                        } else {
+                            continue;
+                        }
+                        const T *yp = scratch[b].y_private.data() + ld * pos;
+                        for (MKL_INT s = 0; s < k; s++) Y[ld * j + s] += yp[s];
+                    }
+                }
+            }
+        } else if (sec_sym == 0) {
             #pragma omp parallel for schedule(dynamic,256)
             for (MKL_INT i = 0; i < dim; i++) {
                 int tid = omp_get_thread_num();
+                auto &sc = scratch[tid];
                 
                 // diagonal part
-                if (std::abs(x[i]) > machine_prec) {
+                if (nonzero(X + ld * i)) {
+                    T diag = static_cast<T>(0.0);
                     for (uint32_t cnt = 0; cnt < Ham_diag.size(); cnt++)
-                        y[i] += x[i] * basis[i].diagonal_operator(props, Ham_diag[cnt]);
+                        diag += basis[i].diagonal_operator(props, Ham_diag[cnt]);
+                    axpy(diag, X + ld * i, Y + ld * i);
                 }
                 
                 // non-diagonal part
                 uint64_t i_a, i_b;
                 MKL_INT j;
-                for (auto it = Ham_off_diag.mats.begin(); it != Ham_off_diag.mats.end(); it++) {
-                    intermediate_states[tid].copy(basis[i]);
-                    oprXphi(*it, props, intermediate_states[tid]);
-                    for (MKL_INT cnt = 0; cnt < intermediate_states[tid].size(); cnt++) {
-                        auto &ele_new = intermediate_states[tid][cnt];
-                        if (std::abs(ele_new.second) < machine_prec) continue;
-                        if (Lin_Ja_full[sec_mat].size() > 0 && Lin_Jb_full[sec_mat].size() > 0) {
-                            ele_new.first.label_sub(props, i_a, i_b,
-                                                    scratch_works1[tid], scratch_works2[tid]);
-                            j = Lin_Ja_full[sec_mat][i_a] + Lin_Jb_full[sec_mat][i_b];
-                        } else {
-                            j = binary_search<mbasis_elem,MKL_INT>(basis, ele_new.first, 0, dim);
-                        }
-                        if (j < 0 || j >= dim) continue;
-                        if (std::abs(x[j]) > machine_prec) y[i] += (x[j] * conjugate(ele_new.second));
+                Ham_off_diag_compiled.apply(basis[i], sc.intermediate_state);
+                for (MKL_INT cnt = 0; cnt < sc.intermediate_state.size(); cnt++) {
+                    auto &ele_new = sc.intermediate_state[cnt];
+                    if (std::abs(ele_new.second) < machine_prec) continue;
+                    if (Lin_Ja_full[sec_mat].size() > 0 && Lin_Jb_full[sec_mat].size() > 0) {
+                        ele_new.first.label_sub(props, i_a, i_b, sc.work1, sc.work2);
+                        j = Lin_Ja_full[sec_mat][i_a] + Lin_Jb_full[sec_mat][i_b];
+                    } else {
+                        j = binary_search<mbasis_elem,MKL_INT>(basis, ele_new.first, 0, dim);
                     }
+                    if (j < 0 || j >= dim) continue;
+                    axpy(conjugate(ele_new.second), X + ld * j, Y + ld * i);
                 }
             }
         } else {
-            auto dim_latt = latt_parent.dimension();
             auto L        = latt_parent.Linear_size();
             bool bosonic  = q_bosonic(props);
             
-            std::vector<std::vector<uint32_t>> disp_i(num_threads,std::vector<uint32_t>(dim_latt));
-            std::vector<std::vector<uint32_t>> disp_j(num_threads,std::vector<uint32_t>(dim_latt));
-            std::vector<std::vector<int>> disp_i_int(num_threads,std::vector<int>(dim_latt));
-            std::vector<std::vector<int>> disp_j_int(num_threads,std::vector<int>(dim_latt));
-            std::vector<mbasis_elem> state_sub_new1(num_threads);
-            std::vector<mbasis_elem> state_sub_new2(num_threads);
-            std::vector<mbasis_elem> ra_z_Tj_rb(num_threads);
-            
             #pragma omp parallel for schedule(dynamic,256)
             for (MKL_INT i = 0; i < dim; i++) {
                 int tid = omp_get_thread_num();
+                auto &sc = scratch[tid];
                 
                 double nu_i = norm_repr[sec_mat][i];                             // normalization factor for repr i
                 if (std::abs(nu_i) < lanczos_precision) {
-                    y[i] += x[i] * static_cast<T>(fake_pos + static_cast<double>(i)/static_cast<double>(dim));
+                    axpy(static_cast<T>(fake_pos + static_cast<double>(i)/static_cast<double>(dim)), X + ld * i, Y + ld * i);
                     continue;
                 }
                 
                 // diagonal part
-                if (std::abs(x[i]) > machine_prec) {
-                    for (uint32_t cnt = 0; cnt < Ham_diag.size(); cnt++)          // diagonal part:
-                        y[i] += x[i] * basis[i].diagonal_operator(props,Ham_diag[cnt]);
+                if (nonzero(X + ld * i)) {
+                    T diag = static_cast<T>(0.0);
+                    for (uint32_t cnt = 0; cnt < Ham_diag.size(); cnt++)
+                        diag += basis[i].diagonal_operator(props, Ham_diag[cnt]);
+                    axpy(diag, X + ld * i, Y + ld * i);
                 }
                 
                 // non-diagonal part
@@ -961,79 +1313,66 @@ namespace qbasis {
                 int sgn;
                 uint64_t i_a, i_b;
                 MKL_INT j;
-                for (auto it = Ham_off_diag.mats.begin(); it != Ham_off_diag.mats.end(); it++) {
-                    intermediate_states[tid].copy(basis[i]);
-                    oprXphi(*it, props, intermediate_states[tid]);
+                Ham_off_diag_compiled.apply(basis[i], sc.intermediate_state);
+                for (MKL_INT cnt = 0; cnt < sc.intermediate_state.size(); cnt++) {
+                    auto &ele_new = sc.intermediate_state[cnt];
+                    // use Weisse Tables to find the representative |ra,rb,j>
+                    ele_new.first.label_sub(props, state_sub1_label, state_sub2_label, sc.work1, sc.work2);
+                    auto &state_rep1_label = belong2rep_sub[state_sub1_label];       // ra
+                    auto &state_rep2_label = belong2rep_sub[state_sub2_label];       // rb
+                    const uint32_t *disp = Weisse_e_flat.data() + Weisse_e_pos(state_sub1_label, state_sub2_label);
+                    for (uint32_t d = 0; d < sc.disp_j_int.size(); d++) {
+                        sc.disp_i_int[d] = static_cast<int>(disp[d]);
+                        sc.disp_j_int[d] = static_cast<int>(disp[sc.disp_j_int.size() + d]);
+                    }
                     
-                    for (MKL_INT cnt = 0; cnt < intermediate_states[tid].size(); cnt++) {
-                        auto &ele_new = intermediate_states[tid][cnt];
-                        // use Weisse Tables to find the representative |ra,rb,j>
-                        ele_new.first.label_sub(props, state_sub1_label, state_sub2_label,
-                                                scratch_works1[tid], scratch_works2[tid]);
-                        auto &state_rep1_label = belong2rep_sub[state_sub1_label];       // ra
-                        auto &state_rep2_label = belong2rep_sub[state_sub2_label];       // rb
-                        auto &ga               = belong2group_sub[state_rep1_label];     // ga
-                        auto &gb               = belong2group_sub[state_rep2_label];     // gb
-                        std::vector<uint64_t> pos_e{ga, gb};
-                        pos_e.insert(pos_e.end(), dist2rep_sub[state_sub1_label].begin(), dist2rep_sub[state_sub1_label].end());
-                        pos_e.insert(pos_e.end(), dist2rep_sub[state_sub2_label].begin(), dist2rep_sub[state_sub2_label].end());
-                        if (state_rep1_label < state_rep2_label) {                          // ra < rb
-                            disp_i[tid] = Weisse_e_lt.index(pos_e).first;
-                            disp_j[tid] = Weisse_e_lt.index(pos_e).second;
-                        } else if (state_rep2_label < state_rep1_label) {                   // ra > rb
-                            disp_i[tid] = Weisse_e_gt.index(pos_e).first;
-                            disp_j[tid] = Weisse_e_gt.index(pos_e).second;
-                        } else {                                                            // ra == rb
-                            disp_i[tid] = Weisse_e_eq.index(pos_e).first;
-                            disp_j[tid] = Weisse_e_eq.index(pos_e).second;
-                        }
-                        for (uint32_t j = 0; j < disp_j[tid].size(); j++) {
-                            disp_i_int[tid][j] = static_cast<int>(disp_i[tid][j]);
-                            disp_j_int[tid][j] = static_cast<int>(disp_j[tid][j]);
-                        }
-                        
-                        if (state_rep2_label < state_rep1_label && dim_spec_involved) {
-                            state_sub_new1[tid] = basis_sub_repr[state_rep2_label];
-                            state_sub_new2[tid] = basis_sub_repr[state_rep1_label];
-                        } else {
-                            state_sub_new1[tid] = basis_sub_repr[state_rep1_label];
-                            state_sub_new2[tid] = basis_sub_repr[state_rep2_label];
-                        }
-                        latt_sub.translation_plan(plans_sub[tid], disp_j_int[tid], scratch_coors[tid], scratch_works[tid]);
-                        state_sub_new2[tid].transform(props_sub_b, plans_sub[tid], sgn);   // T_j |rb>
-                        zipper_basis(props, props_sub_a, props_sub_b, state_sub_new1[tid], state_sub_new2[tid], ra_z_Tj_rb[tid]); // |ra> z T_j |rb>
-                        if (Lin_Ja_repr[sec_mat].size() > 0 && Lin_Jb_repr[sec_mat].size() > 0) {
-                            i_a = state_sub_new1[tid].label(props_sub_a, scratch_works1[tid], scratch_works2[tid]);     // use Lin Tables
-                            i_b = state_sub_new2[tid].label(props_sub_b, scratch_works1[tid], scratch_works2[tid]);
-                            j = Lin_Ja_repr[sec_mat][i_a] + Lin_Jb_repr[sec_mat][i_b];
-                        } else {
-                            j = binary_search<mbasis_elem,MKL_INT>(basis, ra_z_Tj_rb[tid], 0, dim);
-                        }
-                        if (j < 0 || j >= dim) continue;
-                        assert(ra_z_Tj_rb[tid] == basis[j]);
-                        if (std::abs(x[j]) < machine_prec) continue;
-                        double nu_j = norm_repr[sec_mat][j];
-                        if (std::abs(nu_j) < lanczos_precision) continue;
-                        
-                        double exp_coef = 0.0;
-                        for (uint32_t d = 0; d < latt_parent.dimension(); d++) {
-                            if (trans_sym[d]) {
-                                exp_coef += momenta[sec_mat][d] * disp_i_int[tid][d] / static_cast<double>(L[d]);
-                            }
-                        }
-                        auto coef = std::sqrt(nu_i / nu_j) * conjugate(ele_new.second) * std::exp(std::complex<double>(0.0, 2.0 * pi * exp_coef));
-                        if (! bosonic) {
-                            latt_parent.translation_plan(plans_parent[tid], disp_i_int[tid], scratch_coors[tid], scratch_works[tid]);
-                            ra_z_Tj_rb[tid].transform(props, plans_parent[tid], sgn);   // to get sgn
-                            assert(ra_z_Tj_rb[tid] == ele_new.first);
-                            if (sgn % 2 == 1) coef *= std::complex<double>(-1.0, 0.0);
-                        }
-                        
-                        y[i] += (x[j] * coef);
+                    if (state_rep2_label < state_rep1_label && dim_spec_involved) {
+                        sc.state_sub_new1 = basis_sub_repr[state_rep2_label];
+                        sc.state_sub_new2 = basis_sub_repr[state_rep1_label];
+                    } else {
+                        sc.state_sub_new1 = basis_sub_repr[state_rep1_label];
+                        sc.state_sub_new2 = basis_sub_repr[state_rep2_label];
+                    }
+                    sc.state_sub_new2.transform(props_sub_b, latt_sub.translation_plan(sc.disp_j_int), sgn);         // T_j |rb>
+                    zipper_basis(props, props_sub_a, props_sub_b, sc.state_sub_new1, sc.state_sub_new2, sc.ra_z_Tj_rb); // |ra> z T_j |rb>
+                    if (Lin_Ja_repr[sec_mat].size() > 0 && Lin_Jb_repr[sec_mat].size() > 0) {
+                        i_a = sc.state_sub_new1.label(props_sub_a, sc.work1, sc.work2);     // use Lin Tables
+                        i_b = sc.state_sub_new2.label(props_sub_b, sc.work1, sc.work2);
+                        j = Lin_Ja_repr[sec_mat][i_a] + Lin_Jb_repr[sec_mat][i_b];
+                    } else {
+                        j = binary_search<mbasis_elem,MKL_INT>(basis, sc.ra_z_Tj_rb, 0, dim);
+                    }
+                    if (j < 0 || j >= dim) continue;
+                    assert(sc.ra_z_Tj_rb == basis[j]);
+                    if (! nonzero(X + ld * j)) continue;
+                    double nu_j = norm_repr[sec_mat][j];
+                    if (std::abs(nu_j) < lanczos_precision) continue;
+                    
+                    auto coef = nu_i / nu_j * conjugate(ele_new.second) * phase_repr[sec_mat][phase_pos(sc.disp_i_int, L)];
+                    if (! bosonic) {
+                        sgn = sc.ra_z_Tj_rb.transform_sign(props, latt_parent.translation_plan(sc.disp_i_int));   // T_i (|ra> z T_j |rb>) is the new state
+                        if (sgn % 2 == 1) coef *= std::complex<double>(-1.0, 0.0);
                     }
+                    
+                    axpy(coef, X + ld * j, Y + ld * i);
                 }
             }
         }
+        
+        #ifdef QBASIS_DEBUG_SCRATCH
+        uint64_t footprint_new = 0;
+        for (int tid = 0; tid < num_threads; tid++) footprint_new += scratch[tid].footprint();
+        if (footprint_new > footprint_old) scratch_allocs++;
+        std::cout << "(scratch allocs: " << (scratch_allocs - allocs_old) << ", "
+                  << footprint_new << " bytes)" << std::flush;
+        #endif
+    }
+    
+    template <typename T>
+    double model<T>::lanczos_step(const T *v, T *w, const double &b, double &a) const
+    {
+        MKL_INT dim = (sec_sym == 0) ? dim_full[sec_mat] : dim_repr[sec_mat];
+        return lanczos_step_generic(dim, *this, v, w, b, a);
     }
     
     template <typename T>
@@ -1049,7 +1388,17 @@ namespace qbasis {
     }
     
     template <typename T>
-    void model<T>::locate_E0_lanczos(const uint32_t &sec_sym_, const MKL_INT &nev, const MKL_INT &ncv, MKL_INT maxit)
+    void model<T>::MultMm(const T *X, T *Y, const MKL_INT &k) const
+    {
+        T zero = static_cast<T>(0.0);
+        MKL_INT dim = (sec_sym == 0) ? dim_full[sec_mat] : dim_repr[sec_mat];
+        for (uint64_t j = 0; j < static_cast<uint64_t>(dim) * static_cast<uint64_t>(k); j++) Y[j] = zero;
+        MultMm2(X, Y, k);
+    }
+    
+    template <typename T>
+    void model<T>::locate_E0_lanczos(const uint32_t &sec_sym_, const MKL_INT &nev, const MKL_INT &ncv, MKL_INT maxit,
+                                     const std::string &vec_method, const std::string &basis_file)
     {
         std::cout << "Locating E0 with Lanczos (sec_sym = " << sec_sym_ << ")..." << std::endl;
         assert(nev > 0 && nev <= 2 && ncv >= nev - 1 && ncv <= nev);
@@ -1085,16 +1434,43 @@ namespace qbasis {
         bool V1_done = false;
         ckpt_lczsE0_init(E0_done, V0_done, E1_done, V1_done, v);
         
+        // eigenvectors from the Lanczos runs for the energies, see the header
+        std::string method(vec_method);
+        bool single = q_mixed_precision();                                       // stored vectors in single precision
+        if (method == "auto") {
+            uint64_t bytes = (single ? sizeof(typename precision_policy<T>::single) : sizeof(T))
+                           * static_cast<uint64_t>(dim) * static_cast<uint64_t>(maxit);
+            method = (2 * bytes < mem_available()) ? "store" : "replay";
+        }
+        assert(method == "cg" || method == "replay" || method == "store" || method == "spill");
+        if (ncv > 0) std::cout << "Eigenvectors by:  " << method << std::endl;
+        bool keep = (ncv > 0 && (method == "store" || method == "spill"));
+        krylov_basis<T> basis(dim, keep ? maxit : 0, method == "spill" ? basis_file : "", single);
+        MKL_INT m_E0 = 0, m_E1 = 0;                                              // Lanczos steps run here for E0, E1
+        
+        auto refine = [&](const double &E, T *x, T *pp) {                        // CG in double precision, starting from x
+            double accuracy;
+            MKL_INT m = 0;
+            if (matrix_free) {
+                eigenvec_CG(dim, maxit, m, *this,  static_cast<T>(E), accuracy, x, v.data(), v.data() + dim, pp);
+            } else {
+                eigenvec_CG(dim, maxit, m, HamMat, static_cast<T>(E), accuracy, x, v.data(), v.data() + dim, pp);
+            }
+            std::cout << "CG steps:     " << m << std::endl;
+            std::cout << "Accuracy:     " << accuracy << std::endl;
+        };
+        
         if (! E0_done) {
             std::cout << "Calculating ground state energy (simple Lanczos)..." << std::endl;
             start = std::chrono::system_clock::now();
             MKL_INT m = 0;
             if (matrix_free) {
-                lanczos(0, maxit-1, maxit, m, dim, *this,  v.data(), hessenberg.data(), "sr_val0");
+                lanczos(0, maxit-1, maxit, m, dim, *this,  v.data(), hessenberg.data(), "sr_val0", keep ? &basis : nullptr);
             } else {
-                lanczos(0, maxit-1, maxit, m, dim, HamMat, v.data(), hessenberg.data(), "sr_val0");
+                lanczos(0, maxit-1, maxit, m, dim, HamMat, v.data(), hessenberg.data(), "sr_val0", keep ? &basis : nullptr);
             }
             assert(m < maxit);
+            m_E0 = m;
             hess_eigen(hessenberg.data(), maxit, m, "sr", ritz, s);
             eigenvals.resize(1);
             eigenvals[0] = ritz[0];
@@ -1119,49 +1495,77 @@ namespace qbasis {
         // obtain ground state eigenvector
         if (! V0_done) {
             start = std::chrono::system_clock::now();
-            std::cout << "Calculating ground state eigenvector with CG..." << std::endl;
-            
-            vec_randomize(dim, v.data() + 2 * dim, seed);
-            double accuracy;
-            MKL_INT m = 0;
-            if (matrix_free) {
-                eigenvec_CG(dim, maxit, m, *this,  static_cast<T>(E0), accuracy,
-                            v.data() + 2 * dim, v.data(), v.data() + dim, v.data() + 3 * dim);
+            bool by_cg = false;
+            if (m_E0 > 0 && basis.size() >= m_E0) {
+                std::cout << "Forming ground state eigenvector from the stored Lanczos vectors..." << std::endl;
+                hess_eigen(hessenberg.data(), maxit, m_E0, "sr", ritz, s);
+                basis.combine(m_E0, s.data(), v.data() + 2 * dim);
+                if (basis.q_single()) refine(E0, v.data() + 2 * dim, v.data() + 3 * dim);
+            } else if (m_E0 > 0 && method != "cg") {
+                std::cout << "Calculating ground state eigenvector (replaying Lanczos)..." << std::endl;
+                vec_randomize(dim, v.data(), seed);                              // the same starting vector
+                MKL_INT m = 0;
+                if (matrix_free) {
+                    lanczos(0, m_E0-1, maxit, m, dim, *this,  v.data(), hessenberg.data(), "sr_vec0");
+                } else {
+                    lanczos(0, m_E0-1, maxit, m, dim, HamMat, v.data(), hessenberg.data(), "sr_vec0");
+                }
+                assert(m == m_E0 - 1);
             } else {
-                eigenvec_CG(dim, maxit, m, HamMat, static_cast<T>(E0), accuracy,
-                            v.data() + 2 * dim, v.data(), v.data() + dim, v.data() + 3 * dim);
+                by_cg = true;
+                std::cout << "Calculating ground state eigenvector with CG..." << std::endl;
+                vec_randomize(dim, v.data() + 2 * dim, seed);
+                double accuracy;
+                MKL_INT m = 0;
+                if (matrix_free) {
+                    eigenvec_CG(dim, maxit, m, *this,  static_cast<T>(E0), accuracy,
+                                v.data() + 2 * dim, v.data(), v.data() + dim, v.data() + 3 * dim);
+                } else {
+                    eigenvec_CG(dim, maxit, m, HamMat, static_cast<T>(E0), accuracy,
+                                v.data() + 2 * dim, v.data(), v.data() + dim, v.data() + 3 * dim);
+                }
+                assert(m >= 0 && m < maxit);
+                assert(accuracy < lanczos_precision);
+                std::cout << "CG steps:     " << m << std::endl;
+                std::cout << "Accuracy:     " << accuracy << std::endl;
+            }
+            if (! by_cg) {
+                double rnorm = nrm2(dim, v.data() + 2 * dim, 1);
+                scal(dim, 1.0 / rnorm, v.data() + 2 * dim, 1);
             }
-            assert(m >= 0 && m < maxit);
-            assert(accuracy < lanczos_precision);
             end = std::chrono::system_clock::now();
             elapsed_seconds = end - start;
-            std::cout << "elapsed time: " << elapsed_seconds.count() << "s." << std::endl;
-            std::cout << "CG steps:     " << m << std::endl;
-            std::cout << "Accuracy:     " << accuracy << std::endl << std::endl;
+            std::cout << "elapsed time: " << elapsed_seconds.count() << "s." << std::endl << std::endl;
             
             V0_done = true;
             nconv = 1;
-            ckpt_lczsE0_updt(E0_done, V0_done, E1_done, V1_done);
+            ckpt_lczsE0_updt(E0_done, V0_done, E1_done, V1_done, by_cg ? nullptr : v.data() + 2 * dim);
         }
         
-        // postpone writing down ground state eigenvector, if gap needed
-        if (nev == 2 && ! E1_done) {
-            start = std::chrono::system_clock::now();
-            std::cout << "Calculating 1st excited state energy (simple Lanczos)..." << std::endl;
-            std::cout << "Lanczos may/maynot miss degenerate states, BE CAREFUL!" << std::endl;
+        auto start_E1 = [&]() {                                                  // random, orthogonal to phi0
             vec_randomize(dim, v.data(), seed);
             auto alpha = dotc(dim, v.data() + 2 * dim, 1, v.data(), 1);          // (phi0, v0)
             axpy(dim, -alpha, v.data() + 2 * dim, 1, v.data(), 1);               // v0 -= alpha * phi0
             double rnorm = nrm2(dim, v.data(), 1);
             scal(dim, 1.0 / rnorm, v.data(), 1);                                 // normalize v0
+        };
+        
+        // postpone writing down ground state eigenvector, if gap needed
+        if (nev == 2 && ! E1_done) {
+            start = std::chrono::system_clock::now();
+            std::cout << "Calculating 1st excited state energy (simple Lanczos)..." << std::endl;
+            std::cout << "Lanczos may/maynot miss degenerate states, BE CAREFUL!" << std::endl;
+            start_E1();
             
             MKL_INT m = 0;
+            basis.clear();
             if (matrix_free) {
-                lanczos(0, maxit-1, maxit, m, dim, *this,  v.data(), hessenberg.data(), "sr_val1");
+                lanczos(0, maxit-1, maxit, m, dim, *this,  v.data(), hessenberg.data(), "sr_val1", keep ? &basis : nullptr);
             } else {
-                lanczos(0, maxit-1, maxit, m, dim, HamMat, v.data(), hessenberg.data(), "sr_val1");
+                lanczos(0, maxit-1, maxit, m, dim, HamMat, v.data(), hessenberg.data(), "sr_val1", keep ? &basis : nullptr);
             }
             assert(m < maxit);
+            m_E1 = m;
             hess_eigen(hessenberg.data(), maxit, m, "sr", ritz, s);
             eigenvals.resize(2);
             eigenvals[1] = ritz[0];
@@ -1183,31 +1587,53 @@ namespace qbasis {
             copy(dim, v.data() + 2 * dim, 1, v.data(), 1);                       // copy eigenvec to head of v
             v.resize(dim);
             swap(eigenvecs,v);
+            if (! matrix_free) perm_vecs(sec_sym, sec_mat, eigenvecs.data(), 1, true);
             // clean ckpt
             return;
         }
         
         if (! V1_done) {
             start = std::chrono::system_clock::now();
-            std::cout << "Calculate 1st excited state eigenvector with CG..." << std::endl;
-            
-            v.resize(5*dim);
-            vec_randomize(dim, v.data() + 3 * dim, seed + 7);
-            double accuracy;
-            MKL_INT m = 0;
-            if (matrix_free) {
-                eigenvec_CG(dim, maxit, m, *this,  static_cast<T>(E1), accuracy,
-                            v.data() + 3 * dim, v.data(), v.data() + dim, v.data() + 4 * dim);
+            if (m_E1 > 0 && basis.size() >= m_E1) {
+                std::cout << "Forming 1st excited state eigenvector from the stored Lanczos vectors..." << std::endl;
+                hess_eigen(hessenberg.data(), maxit, m_E1, "sr", ritz, s);
+                basis.combine(m_E1, s.data(), v.data() + 3 * dim);
+                if (basis.q_single()) {
+                    v.resize(5*dim);
+                    refine(E1, v.data() + 3 * dim, v.data() + 4 * dim);
+                }
+            } else if (m_E1 > 0 && method != "cg") {
+                std::cout << "Calculating 1st excited state eigenvector (replaying Lanczos)..." << std::endl;
+                start_E1();
+                MKL_INT m = 0;
+                if (matrix_free) {
+                    lanczos(0, m_E1-1, maxit, m, dim, *this,  v.data(), hessenberg.data(), "sr_vec1");
+                } else {
+                    lanczos(0, m_E1-1, maxit, m, dim, HamMat, v.data(), hessenberg.data(), "sr_vec1");
+                }
+                assert(m == m_E1 - 1);
             } else {
-                eigenvec_CG(dim, maxit, m, HamMat, static_cast<T>(E1), accuracy,
-                            v.data() + 3 * dim, v.data(), v.data() + dim, v.data() + 4 * dim);
+                std::cout << "Calculate 1st excited state eigenvector with CG..." << std::endl;
+                v.resize(5*dim);
+                vec_randomize(dim, v.data() + 3 * dim, seed + 7);
+                double accuracy;
+                MKL_INT m = 0;
+                if (matrix_free) {
+                    eigenvec_CG(dim, maxit, m, *this,  static_cast<T>(E1), accuracy,
+                                v.data() + 3 * dim, v.data(), v.data() + dim, v.data() + 4 * dim);
+                } else {
+                    eigenvec_CG(dim, maxit, m, HamMat, static_cast<T>(E1), accuracy,
+                                v.data() + 3 * dim, v.data(), v.data() + dim, v.data() + 4 * dim);
+                }
+                assert(m >= 0 && m <= maxit);
+                std::cout << "CG steps:     " << m << std::endl;
+                std::cout << "Accuracy:     " << accuracy << std::endl;
             }
-            assert(m >= 0 && m <= maxit);
+            double rnorm = nrm2(dim, v.data() + 3 * dim, 1);
+            scal(dim, 1.0 / rnorm, v.data() + 3 * dim, 1);
             end = std::chrono::system_clock::now();
             elapsed_seconds = end - start;
             std::cout << "elapsed time: " << elapsed_seconds.count() << "s." << std::endl;
-            std::cout << "CG steps:     " << m << std::endl;
-            std::cout << "Accuracy:     " << accuracy << std::endl;
             
             V1_done = true;
             nconv = 2;
@@ -1224,6 +1650,7 @@ namespace qbasis {
                 alpha = dotc(dim, eigenvecs.data(), 1, eigenvecs.data() + dim, 1);   // (v0,v1)
                 std::cout << "After:  v0 . v1 = " << alpha << std::endl;
             }
+            if (! matrix_free) perm_vecs(sec_sym, sec_mat, eigenvecs.data(), 2, true);
             std::cout << std::endl;
             
             ckpt_lczsE0_updt(E0_done, V0_done, E1_done, V1_done);
@@ -1258,6 +1685,7 @@ namespace qbasis {
             iram(dim, *this,  v0.data(), nev, ncv, maxit, "sr", nconv, eigenvals.data(), eigenvecs.data());
         } else {
             iram(dim, HamMat, v0.data(), nev, ncv, maxit, "sr", nconv, eigenvals.data(), eigenvecs.data());
+            perm_vecs(sec_sym, sec_mat, eigenvecs.data(), nconv, true);
         }
         assert(nconv > 0);
         E0 = eigenvals[0];
@@ -1268,6 +1696,93 @@ namespace qbasis {
     }
     
     
+    template <typename T>
+    void model<T>::locate_E0_trlan(const uint32_t &sec_sym_, const MKL_INT &nev, const MKL_INT &ncv, MKL_INT maxit)
+    {
+        std::cout << "Locating lowest states with thick-restart Lanczos (sec_sym = " << sec_sym_ << ")..." << std::endl;
+        assert(nev > 0);
+        assert(ncv > nev + 1);
+        assert(sec_sym_ < 3);
+        if (maxit <= 0) maxit = nev * 100;
+        sec_sym = sec_sym_;
+        MKL_INT dim     = sec_sym == 0 ? dim_full[sec_mat] :
+                         (sec_sym == 1 ? dim_repr[sec_mat] : dim_vrnl[sec_mat]);
+        auto &HamMat    = sec_sym == 0 ? HamMat_csr_full[sec_mat] :
+                         (sec_sym == 1 ? HamMat_csr_repr[sec_mat] : HamMat_csr_vrnl[sec_mat]);
+        auto &eigenvals = sec_sym == 0 ? eigenvals_full :
+                         (sec_sym == 1 ? eigenvals_repr : eigenvals_vrnl);
+        auto &eigenvecs = sec_sym == 0 ? eigenvecs_full :
+                         (sec_sym == 1 ? eigenvecs_repr : eigenvecs_vrnl);
+        assert(nev <= dim);
+        
+        std::chrono::time_point<std::chrono::system_clock> start, end;
+        start = std::chrono::system_clock::now();
+        std::vector<T> v0(dim);
+        vec_randomize(dim, v0.data(), 1);
+        eigenvals.resize(nev);
+        eigenvecs.resize(static_cast<uint64_t>(dim) * nev);
+        if (matrix_free) {
+            trlan(dim, *this,  v0.data(), nev, ncv, maxit, "sr", nconv, eigenvals.data(), eigenvecs.data());
+        } else {
+            trlan(dim, HamMat, v0.data(), nev, ncv, maxit, "sr", nconv, eigenvals.data(), eigenvecs.data());
+            perm_vecs(sec_sym, sec_mat, eigenvecs.data(), nev, true);
+        }
+        assert(nconv > 0);
+        E0 = eigenvals[0];
+        end = std::chrono::system_clock::now();
+        std::chrono::duration<double> elapsed_seconds = end - start;
+        std::cout << "elapsed time: " << elapsed_seconds.count() << "s." << std::endl;
+        if (nconv > 1) {
+            E1  = eigenvals[1];
+            gap = eigenvals[1] - eigenvals[0];
+        }
+    }
+    
+    
+    template <typename T>
+    void model<T>::locate_E0_lobpcg(const uint32_t &sec_sym_, const MKL_INT &nev, MKL_INT p, MKL_INT maxit)
+    {
+        std::cout << "Locating lowest states with LOBPCG (sec_sym = " << sec_sym_ << ")..." << std::endl;
+        assert(nev > 0);
+        assert(sec_sym_ < 3);
+        if (p <= 0) p = nev + 2;
+        if (maxit <= 0) maxit = 1000;
+        assert(p >= nev);
+        sec_sym = sec_sym_;
+        MKL_INT dim     = sec_sym == 0 ? dim_full[sec_mat] :
+                         (sec_sym == 1 ? dim_repr[sec_mat] : dim_vrnl[sec_mat]);
+        auto &HamMat    = sec_sym == 0 ? HamMat_csr_full[sec_mat] :
+                         (sec_sym == 1 ? HamMat_csr_repr[sec_mat] : HamMat_csr_vrnl[sec_mat]);
+        auto &eigenvals = sec_sym == 0 ? eigenvals_full :
+                         (sec_sym == 1 ? eigenvals_repr : eigenvals_vrnl);
+        auto &eigenvecs = sec_sym == 0 ? eigenvecs_full :
+                         (sec_sym == 1 ? eigenvecs_repr : eigenvecs_vrnl);
+        assert(3 * p <= dim);
+        
+        std::chrono::time_point<std::chrono::system_clock> start, end;
+        start = std::chrono::system_clock::now();
+        std::vector<T> v0(static_cast<uint64_t>(dim) * p);
+        vec_randomize(dim * p, v0.data(), 1);
+        eigenvals.resize(nev);
+        eigenvecs.resize(static_cast<uint64_t>(dim) * nev);
+        if (matrix_free) {
+            lobpcg(dim, *this,  v0.data(), nev, p, maxit, "sr", nconv, eigenvals.data(), eigenvecs.data());
+        } else {
+            lobpcg(dim, HamMat, v0.data(), nev, p, maxit, "sr", nconv, eigenvals.data(), eigenvecs.data());
+            perm_vecs(sec_sym, sec_mat, eigenvecs.data(), nev, true);
+        }
+        assert(nconv > 0);
+        E0 = eigenvals[0];
+        end = std::chrono::system_clock::now();
+        std::chrono::duration<double> elapsed_seconds = end - start;
+        std::cout << "elapsed time: " << elapsed_seconds.count() << "s." << std::endl;
+        if (nconv > 1) {
+            E1  = eigenvals[1];
+            gap = eigenvals[1] - eigenvals[0];
+        }
+    }
+    
+    
     template <typename T>
     void model<T>::locate_Emax_iram(const uint32_t &sec_sym_, const MKL_INT &nev, const MKL_INT &ncv, MKL_INT maxit)
     {
@@ -1297,6 +1812,7 @@ namespace qbasis {
             iram(dim, *this,  v0.data(), nev, ncv, maxit, "lr", nconv, eigenvals.data(), eigenvecs.data());
         } else {
             iram(dim, HamMat, v0.data(), nev, ncv, maxit, "lr", nconv, eigenvals.data(), eigenvecs.data());
+            perm_vecs(sec_sym, sec_mat, eigenvecs.data(), nconv, true);
         }
         assert(nconv > 0);
         Emax = eigenvals[0];
@@ -1321,41 +1837,33 @@ namespace qbasis {
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
         
-        int num_threads = 1;
-        #pragma omp parallel
-        {
-            int tid = omp_get_thread_num();
-            if (tid == 0) num_threads = omp_get_num_threads();
-        }
-        // prepare intermediates in advance
-        std::vector<wavefunction<T>> intermediate_states(num_threads, {props});
-        std::vector<std::vector<uint8_t>> scratch_works1(num_threads);
-        std::vector<std::vector<uint64_t>> scratch_works2(num_threads);
+        scratch_prepare();
         
         std::cout << "mopr * vec (s = " << sec_old << ", t = " << sec_new << ")... " << std::endl;
         for (MKL_INT j = 0; j < dim_full[sec_new]; j++) vec_new[j] = 0.0;
         
         #pragma omp parallel for schedule(dynamic,1)
         for (MKL_INT j = 0; j < dim_full[sec_old]; j++) {
-            int tid = omp_get_thread_num();
+            auto &sc = scratch[omp_get_thread_num()];
             
             auto sj = vec_old[j];
             if (std::abs(sj) < lanczos_precision) continue;
             
             MKL_INT i;
             uint64_t i_a, i_b;
-            std::vector<std::pair<MKL_INT, T>> values;
+            auto &values = sc.values;
+            values.clear();
             for (auto it = lhs.mats.begin(); it != lhs.mats.end(); it++) {
                 if (it->q_diagonal() && (sec_old == sec_new)) {
                     values.push_back(std::pair<MKL_INT, T>(j,sj * basis_full[sec_old][j].diagonal_operator(props,*it)));
                 } else {
-                    intermediate_states[tid].copy(basis_full[sec_old][j]);
-                    oprXphi(*it, props, intermediate_states[tid]);
-                    for (MKL_INT cnt = 0; cnt < intermediate_states[tid].size(); cnt++) {
-                        auto &ele = intermediate_states[tid][cnt];
+                    sc.intermediate_state.copy(basis_full[sec_old][j]);
+                    oprXphi(*it, props, sc.intermediate_state);
+                    for (MKL_INT cnt = 0; cnt < sc.intermediate_state.size(); cnt++) {
+                        auto &ele = sc.intermediate_state[cnt];
                         if (Lin_Ja_full[sec_new].size() > 0 && Lin_Jb_full[sec_new].size() > 0) {
                             ele.first.label_sub(props, i_a, i_b,
-                                                scratch_works1[tid], scratch_works2[tid]);
+                                                sc.work1, sc.work2);
                             i = Lin_Ja_full[sec_new][i_a] + Lin_Jb_full[sec_new][i_b];
                         } else {
                             i = binary_search<mbasis_elem,MKL_INT>(basis_full[sec_new], ele.first, 0, dim_full[sec_new]);
@@ -1396,29 +1904,21 @@ namespace qbasis {
         auto &Lin_Ja = Lin_Ja_full[sec_full];
         auto &Lin_Jb = Lin_Jb_full[sec_full];
         
-        int num_threads = 1;
-        #pragma omp parallel
-        {
-            int tid = omp_get_thread_num();
-            if (tid == 0) num_threads = omp_get_num_threads();
-        }
-        // prepare intermediates in advance
-        std::vector<mbasis_elem> intermediate_basis(num_threads, {props});
-        std::vector<std::vector<uint8_t>> scratch_works1(num_threads);
-        std::vector<std::vector<uint64_t>> scratch_works2(num_threads);
+        scratch_prepare();
         
         for (MKL_INT i = 0; i < dim; i++) vec_new[i] = 0.0;
         #pragma omp parallel for schedule(dynamic,256)
         for (MKL_INT i = 0; i < dim; i++) {
             if (std::abs(vec_old[i]) < machine_prec) continue;
-            int tid = omp_get_thread_num();
-            auto basis_temp = basis[i];
+            auto &sc = scratch[omp_get_thread_num()];
+            auto &basis_temp = sc.basis_temp;
+            basis_temp = basis[i];
             int sgn;
             MKL_INT j;
             uint64_t i_a, i_b;
             basis_temp.transform(props, plan, sgn);
             if (Lin_Ja.size() > 0 && Lin_Jb.size() > 0) {
-                basis_temp.label_sub(props, i_a, i_b, scratch_works1[tid], scratch_works2[tid]);
+                basis_temp.label_sub(props, i_a, i_b, sc.work1, sc.work2);
                 j = Lin_Ja[i_a] + Lin_Jb[i_b];
             } else {
                 j = binary_search<mbasis_elem,MKL_INT>(basis, basis_temp, 0, dim);
@@ -1448,7 +1948,6 @@ namespace qbasis {
         std::vector<T> vec_temp(dim);
         std::vector<int> disp;
         std::vector<uint32_t> plan;
-        std::vector<int> scratch_coor, scratch_work;
         int sub;
         for (uint32_t site = 0; site < latt_parent.total_sites(); site++) {
             latt_parent.site2coor(disp, sub, site);
@@ -1459,7 +1958,7 @@ namespace qbasis {
             }
             auto coef = std::exp(std::complex<double>(0.0, 2.0 * pi * exp_coef));
             
-            latt_parent.translation_plan(plan, disp, scratch_coor, scratch_work);
+            latt_parent.translation_plan(plan, disp);
             transform_vec_full(plan, sec_full, vec_old, vec_temp.data());
             axpy(dim, coef, vec_temp.data(), 1, vec_new, 1);
         }
@@ -1478,7 +1977,7 @@ namespace qbasis {
                     disp[d] = 0;
                 }
             }
-            latt_parent.translation_plan(plan, disp, scratch_coor, scratch_work);
+            latt_parent.translation_plan(plan, disp);
             transform_vec_full(plan, sec_full, vec_new, vec_temp.data());          // vec_temp = T(R) vec_new
             double exp_coef = momentum[d] * disp[d] / static_cast<double>(L[d]);
             auto coef = std::exp(std::complex<double>(0.0, 2.0 * pi * exp_coef));
@@ -1538,7 +2037,7 @@ namespace qbasis {
     {
         MKL_INT dim_new = dim_full[sec_new];
         auto &HamMat    = HamMat_csr_full[sec_new];
-        std::vector<T> vec_new(2*dim_new);
+        std::vector<T> vec_new((! matrix_free && q_mixed_precision() ? 1 : 2) * dim_new);
         moprXvec_full(Aq, sec_old, sec_new, static_cast<MKL_INT>(0), vec_new.data()); // vec_new = Aq |phi>
         norm = nrm2(dim_new, vec_new.data(), 1);                                 // norm = sqrt(<phi| Aq^\dagger * Aq |phi>)
         if (std::abs(norm) < lanczos_precision) return;
@@ -1546,8 +2045,25 @@ namespace qbasis {
         if (matrix_free) {
             lanczos(0, maxit-1, maxit, m, dim_new, *this,  vec_new.data(), hessenberg, "dnmcs");
         } else {
-            lanczos(0, maxit-1, maxit, m, dim_new, HamMat, vec_new.data(), hessenberg, "dnmcs");
+            perm_vecs(0, sec_new, vec_new.data(), 1, false);                     // into the order of HamMat
+            lanczos_dynamic(HamMat, dim_new, vec_new, maxit, m, hessenberg);
+        }
+    }
+    
+    template <typename T>
+    void model<T>::lanczos_dynamic(const csr_mat<T> &HamMat, const MKL_INT &dim, std::vector<T> &vec_new,
+                                   const MKL_INT &maxit, MKL_INT &m, double hessenberg[]) const
+    {
+        if (! q_mixed_precision()) {
+            assert(static_cast<MKL_INT>(vec_new.size()) >= 2 * dim);
+            lanczos(0, maxit-1, maxit, m, dim, HamMat, vec_new.data(), hessenberg, "dnmcs");
+            return;
         }
+        typedef typename precision_policy<T>::single S;
+        std::vector<S> vs(2 * dim);
+        for (MKL_INT l = 0; l < dim; l++) vs[l] = static_cast<S>(vec_new[l]);
+        std::vector<T>().swap(vec_new);                                          // not needed any more
+        lanczos(0, maxit-1, maxit, m, dim, HamMat, vs.data(), hessenberg, "dnmcs");
     }
     
     
@@ -1556,27 +2072,13 @@ namespace qbasis {
                                  const T* vec_old, T* vec_new) const
     {
         // note: vec_new has size dim_repr[sec_target]
-        auto dim_latt = latt_parent.dimension();
         auto L        = latt_parent.Linear_size();
         bool bosonic  = q_bosonic(props);
         assert(dim_repr[sec_old] > 0 && dim_repr[sec_new] > 0);
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
         
-        int num_threads = 1;
-        #pragma omp parallel
-        {
-            int tid = omp_get_thread_num();
-            if (tid == 0) num_threads = omp_get_num_threads();
-        }
-        // prepare intermediates in advance
-        std::vector<wavefunction<T>> intermediate_states(num_threads, {props});
-        std::vector<std::vector<uint32_t>> plans_parent(num_threads);
-        std::vector<std::vector<uint32_t>> plans_sub(num_threads);
-        std::vector<std::vector<int>> scratch_works(num_threads);
-        std::vector<std::vector<int>> scratch_coors(num_threads);
-        std::vector<std::vector<uint8_t>> scratch_works1(num_threads);
-        std::vector<std::vector<uint64_t>> scratch_works2(num_threads);
+        scratch_prepare();
         
         std::cout << "mopr * vec (s = " << sec_old << ", t = " << sec_new << ")... " << std::endl;
         for (MKL_INT j = 0; j < dim_repr[sec_new]; j++) vec_new[j] = 0.0;
@@ -1587,83 +2089,58 @@ namespace qbasis {
             double nu_j = norm_repr[sec_old][j];
             if (std::abs(sj) < lanczos_precision || std::abs(nu_j) < lanczos_precision) continue;
             
-            int tid = omp_get_thread_num();
+            auto &sc = scratch[omp_get_thread_num()];
             
-            std::vector<std::pair<MKL_INT, T>> values;
+            auto &values = sc.values;
+            values.clear();
             for (auto it = lhs.mats.begin(); it != lhs.mats.end(); it++) {
                 if (it->q_diagonal()) {                                          // only momentum changes
                     double nu_i = norm_repr[sec_new][j];
                     if (std::abs(nu_i) > lanczos_precision)
-                        values.push_back(std::pair<MKL_INT, T>(j, std::sqrt(nu_j/nu_i) * sj * basis_repr[sec_old][j].diagonal_operator(props,*it)));
+                        values.push_back(std::pair<MKL_INT, T>(j, nu_j / nu_i * sj * basis_repr[sec_old][j].diagonal_operator(props,*it)));
                 } else {
-                    intermediate_states[tid].copy(basis_repr[sec_old][j]);
-                    oprXphi(*it, props, intermediate_states[tid]);
+                    sc.intermediate_state.copy(basis_repr[sec_old][j]);
+                    oprXphi(*it, props, sc.intermediate_state);
                     uint64_t state_sub1_label, state_sub2_label;
-                    std::vector<uint32_t> disp_i(dim_latt), disp_j(dim_latt);
-                    std::vector<int> disp_i_int(dim_latt), disp_j_int(dim_latt);
                     int sgn;
-                    mbasis_elem state_sub_new1, state_sub_new2, ra_z_Tj_rb;
                     
-                    for (MKL_INT cnt = 0; cnt < intermediate_states[tid].size(); cnt++) {
-                        auto &ele_new = intermediate_states[tid][cnt];
+                    for (MKL_INT cnt = 0; cnt < sc.intermediate_state.size(); cnt++) {
+                        auto &ele_new = sc.intermediate_state[cnt];
                         ele_new.first.label_sub(props, state_sub1_label, state_sub2_label,
-                                                scratch_works1[tid], scratch_works2[tid]);
+                                                sc.work1, sc.work2);
                         auto &state_rep1_label = belong2rep_sub[state_sub1_label];       // ra
                         auto &state_rep2_label = belong2rep_sub[state_sub2_label];       // rb
-                        auto &ga               = belong2group_sub[state_rep1_label];     // ga
-                        auto &gb               = belong2group_sub[state_rep2_label];     // gb
-                        std::vector<uint64_t> pos_e{ga, gb};
-                        pos_e.insert(pos_e.end(), dist2rep_sub[state_sub1_label].begin(), dist2rep_sub[state_sub1_label].end());
-                        pos_e.insert(pos_e.end(), dist2rep_sub[state_sub2_label].begin(), dist2rep_sub[state_sub2_label].end());
-                        if (state_rep1_label < state_rep2_label) {                          // ra < rb
-                            disp_i = Weisse_e_lt.index(pos_e).first;
-                            disp_j = Weisse_e_lt.index(pos_e).second;
-                        } else if (state_rep2_label < state_rep1_label) {                   // ra > rb
-                            disp_i = Weisse_e_gt.index(pos_e).first;
-                            disp_j = Weisse_e_gt.index(pos_e).second;
-                        } else {                                                            // ra == rb
-                            disp_i = Weisse_e_eq.index(pos_e).first;
-                            disp_j = Weisse_e_eq.index(pos_e).second;
-                        }
-                        for (uint32_t j = 0; j < disp_j.size(); j++) {
-                            disp_i_int[j] = static_cast<int>(disp_i[j]);
-                            disp_j_int[j] = static_cast<int>(disp_j[j]);
+                        const uint32_t *disp = Weisse_e_flat.data() + Weisse_e_pos(state_sub1_label, state_sub2_label);
+                        for (uint32_t d = 0; d < sc.disp_j_int.size(); d++) {
+                            sc.disp_i_int[d] = static_cast<int>(disp[d]);
+                            sc.disp_j_int[d] = static_cast<int>(disp[sc.disp_j_int.size() + d]);
                         }
                         
                         if (state_rep2_label < state_rep1_label && dim_spec_involved) {
-                            state_sub_new1 = basis_sub_repr[state_rep2_label];
-                            state_sub_new2 = basis_sub_repr[state_rep1_label];
+                            sc.state_sub_new1 = basis_sub_repr[state_rep2_label];
+                            sc.state_sub_new2 = basis_sub_repr[state_rep1_label];
                         } else {
-                            state_sub_new1 = basis_sub_repr[state_rep1_label];
-                            state_sub_new2 = basis_sub_repr[state_rep2_label];
+                            sc.state_sub_new1 = basis_sub_repr[state_rep1_label];
+                            sc.state_sub_new2 = basis_sub_repr[state_rep2_label];
                         }
-                        latt_sub.translation_plan(plans_sub[tid], disp_j_int, scratch_coors[tid], scratch_works[tid]);
-                        state_sub_new2.transform(props_sub_b, plans_sub[tid], sgn);   // T_j |rb>
-                        zipper_basis(props, props_sub_a, props_sub_b, state_sub_new1, state_sub_new2, ra_z_Tj_rb); // |ra> z T_j |rb>
+                        sc.state_sub_new2.transform(props_sub_b, latt_sub.translation_plan(sc.disp_j_int), sgn);   // T_j |rb>
+                        zipper_basis(props, props_sub_a, props_sub_b, sc.state_sub_new1, sc.state_sub_new2, sc.ra_z_Tj_rb); // |ra> z T_j |rb>
                         MKL_INT i;
                         if (Lin_Ja_repr[sec_new].size() > 0 && Lin_Jb_repr[sec_new].size() > 0) {
-                            uint64_t i_a = state_sub_new1.label(props_sub_a, scratch_works1[tid], scratch_works2[tid]); // use Lin Tables
-                            uint64_t i_b = state_sub_new2.label(props_sub_b, scratch_works1[tid], scratch_works2[tid]);
+                            uint64_t i_a = sc.state_sub_new1.label(props_sub_a, sc.work1, sc.work2); // use Lin Tables
+                            uint64_t i_b = sc.state_sub_new2.label(props_sub_b, sc.work1, sc.work2);
                             i = Lin_Ja_repr[sec_new][i_a] + Lin_Jb_repr[sec_new][i_b];
                         } else {
-                            i = binary_search<mbasis_elem,MKL_INT>(basis_repr[sec_new], ra_z_Tj_rb, 0, dim_repr[sec_new]);
+                            i = binary_search<mbasis_elem,MKL_INT>(basis_repr[sec_new], sc.ra_z_Tj_rb, 0, dim_repr[sec_new]);
                         }
                         if (i < 0 || i >= dim_repr[sec_new]) continue;
-                        assert(ra_z_Tj_rb == basis_repr[sec_new][i]);
+                        assert(sc.ra_z_Tj_rb == basis_repr[sec_new][i]);
                         double nu_i = norm_repr[sec_new][i];
                         if (std::abs(nu_i) < lanczos_precision) continue;
                         
-                        double exp_coef = 0.0;
-                        for (uint32_t d = 0; d < dim_latt; d++) {
-                            if (trans_sym[d]) {
-                                exp_coef += momenta[sec_new][d] * disp_i_int[d] / static_cast<double>(L[d]);
-                            }
-                        }
-                        auto coef = std::sqrt(nu_j / nu_i) * sj * ele_new.second * std::exp(std::complex<double>(0.0, -2.0 * pi * exp_coef));
+                        auto coef = nu_j / nu_i * sj * ele_new.second * std::conj(phase_repr[sec_new][phase_pos(sc.disp_i_int, L)]);
                         if (! bosonic) {
-                            latt_parent.translation_plan(plans_parent[tid], disp_i_int, scratch_coors[tid], scratch_works[tid]);
-                            ra_z_Tj_rb.transform(props, plans_parent[tid], sgn);          // to get sgn
-                            assert(ra_z_Tj_rb == ele_new.first);
+                            sgn = sc.ra_z_Tj_rb.transform_sign(props, latt_parent.translation_plan(sc.disp_i_int));   // T_i (|ra> z T_j |rb>) is the new state
                             if (sgn % 2 == 1) coef *= std::complex<double>(-1.0, 0.0);
                         }
                         values.push_back(std::pair<MKL_INT, T>(i, coef));
@@ -1710,12 +2187,11 @@ namespace qbasis {
         qbasis::mopr<T> opr_trans;                                               // O_t = (1/N) \sum_R T(R) O T(-R)
         std::vector<uint32_t> disp(base.size(),0);
         std::vector<uint32_t> plan(latt_parent.total_sites());
-        std::vector<int> scratch_coor(latt_parent.dimension()), scratch_work(latt_parent.dimension());
         
         while (! dynamic_base_overflow(disp, base)) {
             std::vector<int> disp_int(base.size());
             for (uint32_t d = 0; d < disp.size(); d++) disp_int[d] = static_cast<int>(disp[d]);
-            latt_parent.translation_plan(plan, disp_int, scratch_coor, scratch_work);
+            latt_parent.translation_plan(plan, disp_int);
             auto opr_temp = lhs;
             opr_temp.transform(plan);
             opr_trans += static_cast<T>(1.0/denominator) * opr_temp;
@@ -1735,7 +2211,7 @@ namespace qbasis {
     {
         MKL_INT dim_new = dim_repr[sec_new];
         auto &HamMat    = HamMat_csr_repr[sec_new];
-        std::vector<T> vec_new(2*dim_new);
+        std::vector<T> vec_new((! matrix_free && q_mixed_precision() ? 1 : 2) * dim_new);
         moprXvec_repr(Aq, sec_old, sec_new, static_cast<MKL_INT>(0), vec_new.data()); // vec_new = Aq * |phi>
         norm = nrm2(dim_new, vec_new.data(), 1);                      // norm = sqrt(<phi| Aq^\dagger * Aq |phi>)
         if (std::abs(norm) < lanczos_precision) return;
@@ -1743,7 +2219,8 @@ namespace qbasis {
         if (matrix_free) {
             lanczos(0, maxit-1, maxit, m, dim_new, *this,  vec_new.data(), hessenberg, "dnmcs");
         } else {
-            lanczos(0, maxit-1, maxit, m, dim_new, HamMat, vec_new.data(), hessenberg, "dnmcs");
+            perm_vecs(1, sec_new, vec_new.data(), 1, false);                     // into the order of HamMat
+            lanczos_dynamic(HamMat, dim_new, vec_new, maxit, m, hessenberg);
         }
     }
     
@@ -1756,23 +2233,13 @@ namespace qbasis {
         auto &momentum   = momenta_vrnl[sec_vrnl];
         auto Bq_dg    = Bq;
         Bq_dg.dagger();
-        auto L        = latt_parent.Linear_size();
         double sqrt_omega_g = std::sqrt(static_cast<double>(gs_omegaG_vrnl));
         assert(dim > 0);
         
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
         
-        int num_threads = 1;
-        #pragma omp parallel
-        {
-            int tid = omp_get_thread_num();
-            if (tid == 0) num_threads = omp_get_num_threads();
-        }
-        // prepare intermediates in advance
-        std::vector<wavefunction<T>> intermediate_states(num_threads, {props});
-        std::vector<std::vector<int>> scratch_disp(num_threads,std::vector<int>(L.size()));
-        std::vector<std::vector<double>> scratch_cart(num_threads);
+        scratch_prepare();
         
         std::cout << "mopr * gs (t = " << sec_vrnl << ")... " << std::endl;
         for (MKL_INT j = 0; j < dim; j++) vec_new[j] = 0.0;
@@ -1781,35 +2248,34 @@ namespace qbasis {
         for (MKL_INT j = 0; j < dim; j++) {
             //basis[j].prt_states(props);
             
-            int tid = omp_get_thread_num();
+            auto &sc = scratch[omp_get_thread_num()];
             
             for (auto it = Bq_dg.mats.begin(); it != Bq_dg.mats.end(); it++) {
                 if (it->q_diagonal()) continue;
                 
-                intermediate_states[tid].copy(basis[j]);
-                oprXphi(*it, props, intermediate_states[tid]);
+                sc.intermediate_state.copy(basis[j]);
+                oprXphi(*it, props, sc.intermediate_state);
                 
-                for (MKL_INT cnt = 0; cnt < intermediate_states[tid].size(); cnt++) {
+                for (MKL_INT cnt = 0; cnt < sc.intermediate_state.size(); cnt++) {
                     //it->prt();
                     //std::cout << std::endl;
                     
-                    //intermediate_states[tid][cnt].first.prt_states(props);
+                    //sc.intermediate_state[cnt].first.prt_states(props);
                     
                     
-                    auto &ele_new = intermediate_states[tid][cnt];
+                    auto &ele_new = sc.intermediate_state[cnt];
                     if (gs_omegaG_vrnl == 1) {
                         if (ele_new.first != gs_vrnl) continue;
-                        for (uint32_t d = 0; d < scratch_disp[tid].size(); d++)
-                            scratch_disp[tid][d] = 0;
+                        sc.disp_i_int.assign(latt_parent.dimension(), 0);
                     } else {
                         auto unique_state = ele_new.first;
-                        unique_state.translate_to_unique_state(props,latt_parent,scratch_disp[tid]);
+                        unique_state.translate_to_unique_state(props,latt_parent,sc.disp_i_int);
                         if (unique_state != gs_vrnl) continue;
                     }
-                    latt_parent.coor2cart(scratch_disp[tid], 0, scratch_cart[tid]);
+                    latt_parent.coor2cart(sc.disp_i_int, 0, sc.cart);
                     double exp_coef = 0.0;
                     for (uint32_t d = 0; d < latt_parent.dimension(); d++) {
-                        exp_coef += momentum[d] * scratch_cart[tid][d];
+                        exp_coef += momentum[d] * sc.cart[d];
                     }
                     auto coeff = std::exp(std::complex<double>(0.0,exp_coef));
                     vec_new[j] += sqrt_omega_g * conjugate(coeff*ele_new.second);
@@ -1825,22 +2291,12 @@ namespace qbasis {
     {
         // note: vec_new has size dim_repr[sec_target]
         auto &momentum   = momenta_vrnl[sec_new];                                // k + q
-        auto L           = latt_parent.Linear_size();
         double sqrt_omega_g = std::sqrt(static_cast<double>(gs_omegaG_vrnl));
         assert(dim_vrnl[sec_old] > 0 && dim_vrnl[sec_new] > 0);
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
         
-        int num_threads = 1;
-        #pragma omp parallel
-        {
-            int tid = omp_get_thread_num();
-            if (tid == 0) num_threads = omp_get_num_threads();
-        }
-        // prepare intermediates in advance
-        std::vector<wavefunction<T>> intermediate_states(num_threads, {props});
-        std::vector<std::vector<int>> scratch_disp(num_threads);
-        std::vector<std::vector<double>> scratch_cart(num_threads);
+        scratch_prepare();
         
         std::cout << "mopr * vec (s = " << sec_old << ", t = " << sec_new << ")... " << std::endl;
         for (MKL_INT j = 0; j < dim_vrnl[sec_new]; j++) vec_new[j] = 0.0;
@@ -1851,35 +2307,36 @@ namespace qbasis {
             auto sj = vec_old[j];
             if (std::abs(sj) < lanczos_precision) continue;
             
-            int tid = omp_get_thread_num();
+            auto &sc = scratch[omp_get_thread_num()];
             
-            std::vector<std::pair<MKL_INT, T>> values;
+            auto &values = sc.values;
+            values.clear();
             T value_gs = static_cast<T>(0.0);
             for (auto it = Bq.mats.begin(); it != Bq.mats.end(); it++) {
                 if (it->q_diagonal()) {                                           // only momentum changes
                     values.push_back(std::pair<MKL_INT, T>(j, sj * basis_vrnl[sec_old][j].diagonal_operator(props,*it)));
                 } else {
-                    intermediate_states[tid].copy(basis_vrnl[sec_old][j]);
-                    oprXphi(*it, props, intermediate_states[tid]);
-                    for (MKL_INT cnt = 0; cnt < intermediate_states[tid].size(); cnt++) {
-                        auto &ele_new = intermediate_states[tid][cnt];
+                    sc.intermediate_state.copy(basis_vrnl[sec_old][j]);
+                    oprXphi(*it, props, sc.intermediate_state);
+                    for (MKL_INT cnt = 0; cnt < sc.intermediate_state.size(); cnt++) {
+                        auto &ele_new = sc.intermediate_state[cnt];
                         auto unique_state = ele_new.first;
-                        unique_state.translate_to_unique_state(props,latt_parent,scratch_disp[tid]);
+                        unique_state.translate_to_unique_state(props,latt_parent,sc.disp_i_int);
                         if (unique_state == gs_vrnl && gs_norm_vrnl[sec_new] > lanczos_precision) {
-                            latt_parent.coor2cart(scratch_disp[tid], 0, scratch_cart[tid]);
+                            latt_parent.coor2cart(sc.disp_i_int, 0, sc.cart);
                             double exp_coef = 0.0;
                             for (uint32_t d = 0; d < latt_parent.dimension(); d++) {
-                                exp_coef += momentum[d] * scratch_cart[tid][d];
+                                exp_coef += momentum[d] * sc.cart[d];
                             }
                             value_gs +=  sj * ele_new.second / sqrt_omega_g
                                        * std::exp(std::complex<double>(0.0,exp_coef)) ;
                         } else {
                             MKL_INT i = binary_search<mbasis_elem,MKL_INT>(basis_vrnl[sec_new], unique_state, 0, dim_vrnl[sec_new]);
                             if (i < 0 || i >= dim_vrnl[sec_new]) continue;
-                            latt_parent.coor2cart(scratch_disp[tid], 0, scratch_cart[tid]);
+                            latt_parent.coor2cart(sc.disp_i_int, 0, sc.cart);
                             double exp_coef = 0.0;
                             for (uint32_t d = 0; d < latt_parent.dimension(); d++) {
-                                exp_coef += momentum[d] * scratch_cart[tid][d];
+                                exp_coef += momentum[d] * sc.cart[d];
                             }
                             auto coef = sj * ele_new.second * std::exp(std::complex<double>(0.0,exp_coef));
                             values.push_back(std::pair<MKL_INT, T>(i, coef));
@@ -1919,18 +2376,11 @@ namespace qbasis {
         auto eigenvec = eigenvecs_vrnl.data() + dim * which_col;
         
         T result = static_cast<T>(0.0);
-        int num_threads = 1;
-        #pragma omp parallel
-        {
-            int tid = omp_get_thread_num();
-            if (tid == 0) num_threads = omp_get_num_threads();
-        }
-        // prepare intermediates in advance
-        std::vector<qbasis::wavefunction<T>> intermediate_states(num_threads, {props});
+        scratch_prepare();
         
         #pragma omp parallel for schedule(dynamic,256)
         for (MKL_INT n = 0; n < dim; n++) {
-            int tid = omp_get_thread_num();
+            auto &sc = scratch[omp_get_thread_num()];
             
             if (std::abs(eigenvec[n]) < qbasis::lanczos_precision) continue;
             T values = static_cast<T>(0.0);
@@ -1940,11 +2390,11 @@ namespace qbasis {
                 if (A.q_diagonal()) {
                     values += temp * qbasis::conjugate(temp) * basis[n].diagonal_operator(props, A);
                 } else {
-                    qbasis::oprXphi(A, props, intermediate_states[tid], basis[n]);
-                    for (decltype(intermediate_states[tid].size()) cnt = 0; cnt < intermediate_states[tid].size(); cnt++) {
-                        auto &ele = intermediate_states[tid][cnt];
+                    qbasis::oprXphi(A, props, sc.intermediate_state, basis[n]);
+                    for (decltype(sc.intermediate_state.size()) cnt = 0; cnt < sc.intermediate_state.size(); cnt++) {
+                        auto &ele = sc.intermediate_state[cnt];
                         auto unique_state = ele.first;
-                        std::vector<int> disp_vec;
+                        auto &disp_vec = sc.disp_i_int;
                         unique_state.translate_to_unique_state(props, latt_parent, disp_vec);
                         auto m = qbasis::binary_search<qbasis::mbasis_elem,MKL_INT>(basis, unique_state, 0, dim);
                         if (m < dim) {
@@ -1969,12 +2419,12 @@ namespace qbasis {
     {
         MKL_INT dim  = dim_vrnl[sec_vrnl];
         auto &HamMat = HamMat_csr_vrnl[sec_vrnl];
-        std::vector<T> vec_new(2*dim);
+        std::vector<T> vec_new((q_mixed_precision() ? 1 : 2) * dim);
         moprXgs_vrnl(Bq, sec_vrnl, vec_new.data());                   // vec_new = N * Aq * |phi>
         norm = nrm2(dim, vec_new.data(), 1);                          // norm = sqrt(<phi| Aq^\dagger * Aq |phi>)
         if (std::abs(norm) < lanczos_precision) return;
         scal(dim, 1.0 / norm, vec_new.data(), 1);                     // normalize vec_new
-        lanczos(0, maxit-1, maxit, m, dim, HamMat, vec_new.data(), hessenberg, "dnmcs");
+        lanczos_dynamic(HamMat, dim, vec_new, maxit, m, hessenberg);
     }
     
     template <typename T>
@@ -2163,8 +2613,6 @@ namespace qbasis {
         }
         std::vector<std::vector<uint32_t>> plans_parent(num_threads);
         std::vector<std::vector<uint32_t>> plans_sub(num_threads);
-        std::vector<std::vector<int>> scratch_works(num_threads);
-        std::vector<std::vector<int>> scratch_coors(num_threads);
         std::vector<std::vector<uint8_t>> scratch_works1(num_threads);
         std::vector<std::vector<uint64_t>> scratch_works2(num_threads);
         
@@ -2213,7 +2661,7 @@ namespace qbasis {
                 }
                 if (flag) continue;            // such translation forbidden
                 auto basis_temp = basis_full[sec_full][i];
-                latt_parent.translation_plan(plans_parent[tid], disp, scratch_coors[tid], scratch_works[tid]);
+                latt_parent.translation_plan(plans_parent[tid], disp);
                 basis_temp.transform(props, plans_parent[tid], sgn);
                 MKL_INT j;
                 if (Lin_Ja_full[sec_full].size() > 0 && Lin_Jb_full[sec_full].size() > 0) {
@@ -2263,7 +2711,10 @@ namespace qbasis {
     template <typename T>
     void model<T>::generate_Ham_sparse_repr_deprecated(const uint32_t &sec_full,
                                                        const uint32_t &sec_repr,
-                                                       const bool &upper_triangle)
+                                                       const bool &upper_triangle,
+                                                       const bool &check_hermitian,
+                                                       const std::string &csr_index,
+                                                       const std::string &csr_file)
     {
         if (matrix_free) matrix_free = false;
         MKL_INT dim_full_depre  = dim_full[sec_full];
@@ -2276,6 +2727,15 @@ namespace qbasis {
         auto &Lin_Jb_full_depre = Lin_Jb_full[sec_full];
         auto &HamMat_csr        = HamMat_csr_repr[sec_repr];
         assert(dim_full_depre > 0 && dim_repr_depre > 0);
+        perm_repr[sec_repr].clear();
+        
+        auto cache_file = csr_cache_file("repr_deprecated", sec_repr, upper_triangle, sec_full);
+        if (! cache_file.empty() && HamMat_csr.load(cache_file, ! csr_file.empty()) == 0) {
+            if (csr_index != "mkl_int") HamMat_csr.set_index(csr_index);
+            HamMat_csr.use_real_values();
+            std::cout << "Hamiltonian CSR matrix (repr) reloaded, skipping the generation." << std::endl;
+            return;
+        }
         
         int num_threads = 1;
         #pragma omp parallel
@@ -2288,23 +2748,20 @@ namespace qbasis {
         std::vector<std::vector<uint8_t>> scratch_works1(num_threads);
         std::vector<std::vector<uint64_t>> scratch_works2(num_threads);
         
-        std::cout << "Generating LIL Hamiltonian Matrix (repr) (deprecated)..." << std::endl;
+        std::cout << "Generating CSR Hamiltonian Matrix (repr) (deprecated)..." << std::endl;
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
-        lil_mat<std::complex<double>> matrix_lil(dim_repr_depre, upper_triangle);
-        
-        #pragma omp parallel for schedule(dynamic,1)
-        for (MKL_INT i = 0; i < dim_repr_depre; i++) {
+        auto gen_row = [&](const MKL_INT &i, std::vector<std::pair<MKL_INT,std::complex<double>>> &row) {
             int tid = omp_get_thread_num();
             
             auto repr_i = basis_repr_depre[i];
             if (std::abs(basis_coeff[repr_i]) < lanczos_precision) {
-                matrix_lil.add(i, i, static_cast<T>(fake_pos + static_cast<double>(i)/static_cast<double>(dim_repr_depre)));
-                continue;
+                row.emplace_back(i, static_cast<T>(fake_pos + static_cast<double>(i)/static_cast<double>(dim_repr_depre)));
+                return;
             }
             // diagonal part:
             for (uint32_t cnt = 0; cnt < Ham_diag.size(); cnt++)
-                matrix_lil.add(i, i, basis_full_depre[repr_i].diagonal_operator(props,Ham_diag[cnt]));
+                row.emplace_back(i, basis_full_depre[repr_i].diagonal_operator(props,Ham_diag[cnt]));
             
             // non-diagonal part:
             for (auto it = Ham_off_diag.mats.begin(); it != Ham_off_diag.mats.end(); it++) {
@@ -2330,15 +2787,15 @@ namespace qbasis {
                     auto j = binary_search<MKL_INT,MKL_INT>(basis_repr_depre, repr_j, 0, dim_repr_depre);  // < j |P'_k H | i > obtained
                     auto coeff = basis_coeff[state_j]/std::sqrt(std::real(basis_coeff[repr_i] * basis_coeff[repr_j]));
                     
-                    if (upper_triangle) {
-                        if (i <= j) matrix_lil.add(i, j, conjugate(ele_new.second) * coeff);
-                    } else {
-                        matrix_lil.add(i, j, conjugate(ele_new.second) * coeff);
-                    }
+                    if (upper_triangle && i > j) continue;
+                    row.emplace_back(j, conjugate(ele_new.second) * coeff);
                 }
             }
-        }
-        HamMat_csr = csr_mat<std::complex<double>>(matrix_lil);
+        };
+        HamMat_csr = csr_mat<std::complex<double>>(dim_repr_depre, upper_triangle, gen_row, check_hermitian, csr_file);
+        if (! cache_file.empty()) HamMat_csr.save(cache_file);
+        if (csr_index != "mkl_int") HamMat_csr.set_index(csr_index);
+        HamMat_csr.use_real_values();
         std::cout << "Hamiltonian generated." << std::endl;
         end = std::chrono::system_clock::now();
         std::chrono::duration<double> elapsed_seconds = end - start;
@@ -2479,7 +2936,8 @@ namespace qbasis {
     }
     
     template <typename T>
-    void model<T>::ckpt_lczsE0_updt(const bool &E0_done, const bool &V0_done, const bool &E1_done, const bool &V1_done)
+    void model<T>::ckpt_lczsE0_updt(const bool &E0_done, const bool &V0_done, const bool &E1_done, const bool &V1_done,
+                                    T *vec0)
     {
         if (! enable_ckpt) return;
         
@@ -2536,7 +2994,9 @@ namespace qbasis {
         flnm0 += ".dat";
         flnm1 += ".dat";
         
-        if (E0_done && V0_done && (! E1_done) && (! V1_done)) {                  // record eigenvec0
+        if (E0_done && V0_done && (! E1_done) && (! V1_done) && vec0 != nullptr) {
+            vec_disk_write(flnm0, dim, vec0);
+        } else if (E0_done && V0_done && (! E1_done) && (! V1_done)) {           // record eigenvec0
             for (auto &p : fs::directory_iterator("out_Qckpt"))
             {
                 if (std::regex_match(p.path().filename().string(), std::regex("CG_V[[:digit:]]+\\.dat")))
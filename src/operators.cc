@@ -1,5 +1,7 @@
 #include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <map>
 #include "qbasis.h"
 
 namespace qbasis {
@@ -796,6 +798,69 @@ namespace qbasis {
         return true;
     }
     
+    template <typename T>
+    bool mopr<T>::split_hermitian(mopr<T> &half, mopr<T> &self) const
+    {
+        half.mats.clear();
+        self.mats.clear();
+        
+        // group the terms according to the (site, orbital, fermion) of each fundamental operator
+        auto key = [](const opr_prod<T> &ele)
+        {
+            std::vector<uint32_t> res;
+            for (const auto &op : ele.mat_prod) {
+                res.push_back(op.site);
+                res.push_back(op.orbital);
+                res.push_back(op.fermion ? 1 : 0);
+            }
+            return res;
+        };
+        std::vector<const opr_prod<T>*> terms;
+        for (const auto &ele : mats) terms.push_back(&ele);
+        std::map<std::vector<uint32_t>, std::vector<size_t>> groups;
+        for (size_t n = 0; n < terms.size(); n++) groups[key(*terms[n])].push_back(n);
+        
+        std::vector<bool> used(terms.size(), false);
+        for (size_t n = 0; n < terms.size(); n++) {
+            if (used[n]) continue;
+            used[n] = true;
+            const auto &ele = *terms[n];
+            
+            // Hermitian conjugate, brought to the same normal form as the terms stored
+            opr_prod<T> ele_dg;
+            ele_dg.coeff = conjugate(ele.coeff);
+            for (auto rit = ele.mat_prod.rbegin(); rit != ele.mat_prod.rend(); rit++) {
+                auto op = *rit;
+                op.dagger();
+                ele_dg *= op;
+                if (ele_dg.q_zero()) break;
+            }
+            if (ele_dg == ele) {
+                self.mats.push_back(ele);
+                continue;
+            }
+            
+            bool found = false;
+            auto it = groups.find(key(ele_dg));
+            if (it != groups.end()) {
+                for (auto m : it->second) {
+                    if (! used[m] && *terms[m] == ele_dg) {
+                        used[m] = true;
+                        found = true;
+                        break;
+                    }
+                }
+            }
+            if (! found) {
+                half.mats.clear();
+                self.mats.clear();
+                return false;
+            }
+            half.mats.push_back(ele);
+        }
+        return true;
+    }
+    
     template <typename T>
     opr_prod<T> &mopr<T>::operator[](uint32_t n)
     {
@@ -1207,6 +1272,200 @@ namespace qbasis {
         return prod;
     }
     
+    // ----------------- implementation of class mopr_compiled ---------------
+    template <typename T>
+    mopr_compiled<T>::mopr_compiled(const mopr<T> &lhs, const std::vector<basis_prop> &props_):
+        valid(true), total_bytes(2)
+    {
+        std::vector<uint16_t> orb_bgn(props_.size());                           // first byte of each orbital
+        for (uint32_t orb = 0; orb < props_.size(); orb++) {
+            orb_bgn[orb] = static_cast<uint16_t>(total_bytes);
+            total_bytes += props_[orb].num_bytes;
+            if (props_[orb].dilute) valid = false;
+        }
+        
+        bool props_needed = false;
+        term_bgn.push_back(0);
+        for (auto it = lhs.mats.begin(); it != lhs.mats.end() && valid; it++) {
+            if (std::abs(it->coeff) < opr_precision) continue;
+            if (std::any_of(it->mat_prod.begin(), it->mat_prod.end(), [](const opr<T> &op){ return op.mat == nullptr; })) continue;
+            for (auto rit = it->mat_prod.rbegin(); rit != it->mat_prod.rend(); rit++) {
+                if (rit->orbital >= props_.size() || rit->site >= props_[rit->orbital].num_sites) {
+                    valid = false;
+                    break;
+                }
+                const auto &prop = props_[rit->orbital];
+                assert(rit->dim == prop.dim_local);
+                
+                local_opr op;
+                op.site       = rit->site;
+                op.orbital    = rit->orbital;
+                op.dim        = static_cast<uint8_t>(rit->dim);
+                op.diagonal   = rit->diagonal;
+                op.fermion    = rit->fermion && (! rit->diagonal);
+                uint32_t bit_pos = prop.bits_per_site * rit->site;
+                op.byte_pos   = static_cast<uint16_t>(orb_bgn[rit->orbital] + bit_pos / 8);
+                op.bit_pos    = static_cast<uint8_t>(bit_pos % 8);
+                op.mask       = static_cast<uint8_t>((1 << prop.bits_per_site) - 1);
+                op.cross      = (op.bit_pos + prop.bits_per_site > 8);
+                
+                // local matrix, with negligible elements set to exactly zero
+                op.mat_pos = static_cast<uint32_t>(mats.size());
+                uint32_t mat_size = rit->diagonal ? rit->dim : rit->dim * rit->dim;
+                for (uint32_t k = 0; k < mat_size; k++) {
+                    mats.push_back(std::abs(rit->mat[k]) < machine_prec ? static_cast<T>(0.0) : rit->mat[k]);
+                }
+                
+                // byte masks covering all the fermions traversed by this operator
+                op.parity_pos     = static_cast<uint32_t>(parity_masks.size());
+                op.parity_byte    = 0;
+                op.parity_len     = 0;
+                op.parity_by_bits = true;
+                if (op.fermion) {
+                    assert(prop.q_fermion());
+                    std::vector<uint8_t> mask(total_bytes, 0);
+                    for (uint32_t orb = 0; orb <= rit->orbital; orb++) {
+                        if (! props_[orb].q_fermion()) continue;
+                        if (! props_[orb].parity_by_bits) {
+                            op.parity_by_bits = false;
+                            break;
+                        }
+                        uint32_t nbits = (orb < rit->orbital) ? props_[orb].bits_per_site * props_[orb].num_sites : bit_pos;
+                        for (uint32_t b = 0; b < nbits; b++) {
+                            mask[orb_bgn[orb] + b / 8] |= (props_[orb].parity_bytes[b / 8] & static_cast<uint8_t>(1 << (b % 8)));
+                        }
+                    }
+                    
+                    if (op.parity_by_bits) {
+                        int first = 0, last = -1;
+                        for (int b = 0; b < total_bytes; b++) {
+                            if (mask[b] == 0) continue;
+                            if (last < 0) first = b;
+                            last = b;
+                        }
+                        op.parity_byte = static_cast<uint16_t>(first);
+                        op.parity_len  = static_cast<uint16_t>(last - first + 1);
+                        if (last >= first) parity_masks.insert(parity_masks.end(), mask.begin() + first, mask.begin() + last + 1);
+                    } else {
+                        props_needed = true;
+                    }
+                }
+                oprs.push_back(op);
+            }
+            coeffs.push_back(it->coeff);
+            term_bgn.push_back(static_cast<uint32_t>(oprs.size()));
+        }
+        
+        if (! valid) {
+            coeffs.clear();
+            term_bgn.clear();
+            oprs.clear();
+            mats.clear();
+            parity_masks.clear();
+        } else if (props_needed) {
+            props = props_;
+        }
+    }
+    
+    template <typename T>
+    uint8_t mopr_compiled<T>::read(const uint8_t *bits, const local_opr &op) const
+    {
+        if (op.cross) {
+            uint16_t temp = (static_cast<uint16_t>(bits[op.byte_pos+1]) << 8) | bits[op.byte_pos];
+            return static_cast<uint8_t>((temp >> op.bit_pos) & op.mask);
+        } else {
+            return static_cast<uint8_t>((bits[op.byte_pos] >> op.bit_pos) & op.mask);
+        }
+    }
+    
+    template <typename T>
+    void mopr_compiled<T>::write(uint8_t *bits, const local_opr &op, const uint8_t &val) const
+    {
+        if (op.cross) {
+            uint16_t temp = (static_cast<uint16_t>(bits[op.byte_pos+1]) << 8) | bits[op.byte_pos];
+            temp &= static_cast<uint16_t>(~(static_cast<uint16_t>(op.mask) << op.bit_pos));
+            temp |= static_cast<uint16_t>(static_cast<uint16_t>(val) << op.bit_pos);
+            bits[op.byte_pos]   = static_cast<uint8_t>(temp & 0xFF);
+            bits[op.byte_pos+1] = static_cast<uint8_t>(temp >> 8);
+        } else {
+            bits[op.byte_pos] &= static_cast<uint8_t>(~(op.mask << op.bit_pos));
+            bits[op.byte_pos] |= static_cast<uint8_t>(val << op.bit_pos);
+        }
+    }
+    
+    template <typename T>
+    int mopr_compiled<T>::parity(const mbasis_elem &state, const local_opr &op) const
+    {
+        if (op.parity_by_bits) {
+            return bit_parity(masked_xor(state.mbits + op.parity_byte, parity_masks.data() + op.parity_pos, 8 * op.parity_len));
+        } else {
+            return state.fermion_parity(props, op.site, op.orbital);
+        }
+    }
+    
+    template <typename T>
+    void mopr_compiled<T>::apply(const mbasis_elem &rhs, wavefunction<T> &res) const
+    {
+        assert(valid);
+        assert(res.total_bytes == total_bytes);
+        res.bgn = 0;
+        res.end = 0;
+        MKL_INT capacity = static_cast<MKL_INT>(res.ele.size());
+        for (uint32_t n = 0; n < coeffs.size(); n++) {
+            // elements generated by the n-th operator product live in res.ele[bgn, end)
+            MKL_INT bgn = res.end;
+            MKL_INT end = bgn + 1;
+            if (end >= capacity) {
+                capacity *= 2;
+                auto gs = res.ele[0];
+                res.ele.resize(capacity, gs);
+            }
+            std::memcpy(res.ele[bgn].first.mbits, rhs.mbits, total_bytes);
+            res.ele[bgn].second = coeffs[n];
+            
+            for (uint32_t k = term_bgn[n]; k < term_bgn[n+1] && end > bgn; k++) {
+                const auto &op = oprs[k];
+                const T *mat = mats.data() + op.mat_pos;
+                if (op.diagonal) {
+                    MKL_INT end_new = bgn;
+                    for (MKL_INT cnt = bgn; cnt < end; cnt++) {
+                        auto coeff = mat[read(res.ele[cnt].first.mbits, op)];
+                        if (coeff == static_cast<T>(0.0)) continue;
+                        if (end_new != cnt) std::swap(res.ele[end_new], res.ele[cnt]);
+                        res.ele[end_new].second *= coeff;
+                        end_new++;
+                    }
+                    end = end_new;
+                } else {
+                    MKL_INT end_max = end + (end - bgn) * static_cast<MKL_INT>(op.dim);
+                    if (end_max >= capacity) {                          // enlarge, keeping all elements in place
+                        while (end_max >= capacity) capacity *= 2;
+                        auto gs = res.ele[0];
+                        res.ele.resize(capacity, gs);
+                    }
+                    // new elements written to res.ele[end, end_new), then moved to the front
+                    MKL_INT end_new = end;
+                    for (MKL_INT cnt = bgn; cnt < end; cnt++) {
+                        const uint8_t *bits = res.ele[cnt].first.mbits;
+                        const T *col = mat + static_cast<uint32_t>(read(bits, op)) * op.dim;
+                        auto coeff = res.ele[cnt].second;
+                        if (op.fermion && parity(res.ele[cnt].first, op) == 1) coeff = -coeff;
+                        for (uint8_t row = 0; row < op.dim; row++) {
+                            if (col[row] == static_cast<T>(0.0)) continue;
+                            std::memcpy(res.ele[end_new].first.mbits, bits, total_bytes);
+                            write(res.ele[end_new].first.mbits, op, row);
+                            res.ele[end_new].second = coeff * col[row];
+                            end_new++;
+                        }
+                    }
+                    for (MKL_INT cnt = end; cnt < end_new; cnt++) std::swap(res.ele[bgn + cnt - end], res.ele[cnt]);
+                    end = bgn + (end_new - end);
+                }
+            }
+            res.end = end;
+        }
+    }
+    
     
     // Explicit instantiation, so the class definition can be put in this file
     template class opr<double>;
@@ -1274,6 +1533,9 @@ namespace qbasis {
     template void swap(mopr<double>&, mopr<double>&);
     template void swap(mopr<std::complex<double>>&, mopr<std::complex<double>>&);
     
+    template class mopr_compiled<double>;
+    template class mopr_compiled<std::complex<double>>;
+    
     template bool operator==(const mopr<double>&, const mopr<double>&);
     template bool operator==(const mopr<std::complex<double>>&, const mopr<std::complex<double>>&);
     
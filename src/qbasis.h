@@ -9,6 +9,7 @@
 #ifndef qbasis_h
 #define qbasis_h
 
+#define MKL_Complex8 std::complex<float>
 #define MKL_Complex16 std::complex<double>
 
 #ifndef lapack_int
@@ -23,6 +24,13 @@
 #define BOOST_FILESYSTEM_NO_DEPRECATED
 #endif
 
+// number of bytes (including the 2-byte header) of mbasis_elem stored inline, longer ones are allocated on heap
+#ifndef QBASIS_MBITS_INLINE
+#define QBASIS_MBITS_INLINE 24
+#endif
+
+// define QBASIS_DEBUG_SCRATCH to report the growth of model's per-thread scratch space in each MultMv2
+
 #include <algorithm>
 #include <cassert>
 #include <chrono>
@@ -45,6 +53,7 @@
 #else
   #define omp_get_thread_num() 0
   #define omp_get_num_threads() 1
+  #define omp_get_max_threads() 1
   #define omp_get_num_procs() 1
   #define omp_get_proc_bind() 0
 #endif
@@ -77,6 +86,34 @@ namespace qbasis {
     extern const double sparse_precision;
     extern const double lanczos_precision;
     
+    /** @file qbasis.h
+     *  \brief precision policy of the vectors in the sparse solvers, given their storage type S:
+     *  single: the single precision storage of the same field (double -> float, complex<double> -> complex<float>),
+     *  wide: the type in which the elements are combined (always double precision),
+     *  tol(): the accuracy to which vectors stored as S can be trusted (lanczos_precision for double precision)
+     */
+    template <typename S> struct precision_policy;
+    template <> struct precision_policy<double> {
+        typedef float single;
+        typedef double wide;
+        static double tol() { return lanczos_precision; }
+    };
+    template <> struct precision_policy<std::complex<double>> {
+        typedef std::complex<float> single;
+        typedef std::complex<double> wide;
+        static double tol() { return lanczos_precision; }
+    };
+    template <> struct precision_policy<float> {
+        typedef float single;
+        typedef double wide;
+        static double tol() { return 1e-6; }
+    };
+    template <> struct precision_policy<std::complex<float>> {
+        typedef std::complex<float> single;
+        typedef std::complex<double> wide;
+        static double tol() { return 1e-6; }
+    };
+    
     /** @file qbasis.h
      *  \var bool enable_ckpt
      *  \brief use checkpoint and restart in Lanczos, for long runs
@@ -118,6 +155,8 @@ namespace qbasis {
         std::vector<uint64_t> linear_size() const { return linear_size_; }
         T& index(const std::vector<uint64_t> &pos);
         const T& index(const std::vector<uint64_t> &pos) const;
+        T& operator[](const uint64_t &n) { return data[n]; }                    // element at linear position n
+        const T& operator[](const uint64_t &n) const { return data[n]; }
     private:
         uint32_t dim_;
         uint64_t size_;
@@ -135,6 +174,7 @@ namespace qbasis {
     template <typename> class opr;
     template <typename> class opr_prod;
     template <typename> class mopr;
+    template <typename> class mopr_compiled;
     class lattice;
     template <typename> class csr_mat;
     template <typename> class model;
@@ -356,6 +396,19 @@ namespace qbasis {
         std::vector<uint32_t> Nfermion_map;     ///< Nfermion_map[i] corresponds to the number of fermions of state i
         std::string name;                       ///< store the name of the basis
         bool dilute;                            ///< if dilute, bit-rep is not a good representation
+        bool parity_by_bits;                    ///< if Nfermion_map[i] % 2 == popcount(i & parity_mask) % 2 for all i
+        uint8_t parity_mask;                    ///< (fermions only) the bits of a local state determining its fermion parity
+        std::vector<uint8_t> parity_bytes;      ///< parity_mask repeated on all sites, with num_bytes bytes
+        bool label_by_bytes;                    ///< if 8 % bits_per_site == 0, labels are obtained byte by byte from the tables below
+        std::vector<uint16_t> label_table;      ///< 3 * 256, partial label of a byte value, from (all sites, even sites, odd sites) in the byte
+        std::vector<uint64_t> label_weight;     ///< 3 * num_bytes, weight of each byte for (label, label_sub 1, label_sub 2)
+        
+    private:
+        /** \brief set parity_by_bits, parity_mask and parity_bytes, according to Nfermion_map and num_sites */
+        void init_parity();
+        
+        /** \brief set label_by_bytes, label_table and label_weight, according to dim_local and num_sites */
+        void init_label();
     };
     
     /** \brief Class for representing a quantum basis using bits
@@ -369,6 +422,8 @@ namespace qbasis {
         friend bool operator==(const mbasis_elem&, const mbasis_elem&);
         friend bool trans_equiv(const mbasis_elem&, const mbasis_elem&, const std::vector<basis_prop> &props, const lattice&);
         template <typename T> friend class wavefunction;
+        template <typename T> friend class mopr_compiled;
+        template <typename T> friend class model;
         template <typename T> friend void oprXphi(const opr<T>&, const std::vector<basis_prop>&, wavefunction<T>&, const bool&);
         template <typename T> friend void oprXphi(const opr<T>&, const std::vector<basis_prop>&, wavefunction<T>&, mbasis_elem, const bool&);
         template <typename T> friend void oprXphi(const opr_prod<T>&, const std::vector<basis_prop>&, wavefunction<T>&, mbasis_elem, const bool&);
@@ -439,6 +494,9 @@ namespace qbasis {
         /** \brief question if every site occupied by the same state */
         bool q_same_state_all_site(const std::vector<basis_prop> &props) const;
         
+        /** \brief parity (0 or 1) of the number of fermions on all orbitals before orbital, and on sites before site in orbital */
+        int fermion_parity(const std::vector<basis_prop> &props, const uint32_t &site, const uint32_t &orbital) const;
+        
         // get a label
         // preferred size of work: 2*num_sites
         uint64_t label(const std::vector<basis_prop> &props, const uint32_t &orbital,
@@ -473,6 +531,22 @@ namespace qbasis {
         mbasis_elem& transform(const std::vector<basis_prop> &props,
                                const std::vector<uint32_t> &plan, int &sgn);
         
+        // the sgn which would be generated by the above two transformations, without changing the basis
+        int transform_sign(const std::vector<basis_prop> &props,
+                           const std::vector<uint32_t> &plan, const uint32_t &orbital) const;
+        int transform_sign(const std::vector<basis_prop> &props,
+                           const std::vector<uint32_t> &plan) const;
+        
+        // same as above, with plan pointing to num_sites entries, e.g. a cached plan from lattice::translation_plan
+        mbasis_elem& transform(const std::vector<basis_prop> &props,
+                               const uint32_t *plan, int &sgn, const uint32_t &orbital);
+        mbasis_elem& transform(const std::vector<basis_prop> &props,
+                               const uint32_t *plan, int &sgn);
+        int transform_sign(const std::vector<basis_prop> &props,
+                           const uint32_t *plan, const uint32_t &orbital) const;
+        int transform_sign(const std::vector<basis_prop> &props,
+                           const uint32_t *plan) const;
+        
         // different orbs transform in different ways: (site1, orb1) -> (site2, orb2)
         // outer vector: each element denotes one orbital
         // middle vector: each element denotes one site
@@ -520,8 +594,18 @@ namespace qbasis {
          *  Note2: The wavefunction is always defined as:
          *         |alpha_0, beta_1, gamma_2, ... > = alpha_0^\dagger beta_1^\dagger gamma_2^\dagger ... |GS>
          *         (where alpha_i^\dagger is creation operator of state alpha on site i)
+         *
+         *  mbits points to mbits_inline if total_bytes <= QBASIS_MBITS_INLINE, otherwise to heap memory,
+         *  so that for most models a std::vector<mbasis_elem> is one contiguous array without allocations per element
          */
         uint8_t* mbits;
+        uint8_t mbits_inline[QBASIS_MBITS_INLINE];
+        
+        /** \brief question if the bits are stored inline */
+        bool q_inline() const { return mbits == mbits_inline; }
+        
+        /** \brief release the old memory (if on heap), and point mbits to memory of total_bytes (contents not initialized) */
+        void allocate(const uint16_t &total_bytes);
     };
     
     
@@ -529,6 +613,7 @@ namespace qbasis {
     // Use with caution, may hurt speed when not used properly
     template <typename T> class wavefunction {
         friend class model<T>;
+        friend class mopr_compiled<T>;
         friend void swap <> (wavefunction<T> &, wavefunction<T> &);
         friend wavefunction<T> operator+ <> (const wavefunction<T>&, const wavefunction<T>&);
         friend void oprXphi <> (const opr<T>&,      const std::vector<basis_prop>&, wavefunction<T>&, const bool&);
@@ -652,6 +737,8 @@ namespace qbasis {
         friend opr<T> normalize <> (const opr<T>&, T&);
         friend class opr_prod<T>;
         friend class mopr<T>;
+        friend class mopr_compiled<T>;
+        friend class model<T>;
         friend class mbasis_elem;
         friend void oprXphi <> (const opr<T>&, const std::vector<basis_prop>&, wavefunction<T>&, const bool&);
         friend void oprXphi <> (const opr<T>&, const std::vector<basis_prop>&, wavefunction<T>&, mbasis_elem, const bool&);
@@ -760,6 +847,8 @@ namespace qbasis {
         friend opr_prod<T> operator* <> (const T&, const opr_prod<T>&);
         friend opr_prod<T> operator* <> (const opr<T>&, const opr<T>&);
         friend class mopr<T>;
+        friend class mopr_compiled<T>;
+        friend class model<T>;
         friend class mbasis_elem;
         friend void oprXphi <> (const opr_prod<T>&, const std::vector<basis_prop>&, wavefunction<T>&);
         friend void oprXphi <> (const opr_prod<T>&, const std::vector<basis_prop>&, wavefunction<T>&, mbasis_elem, const bool&);
@@ -830,6 +919,7 @@ namespace qbasis {
     // a linear combination of products of operators
     template <typename T> class mopr {
         friend class model<T>;
+        friend class mopr_compiled<T>;
         friend void swap <> (mopr<T>&, mopr<T>&);
         friend bool operator== <> (const mopr<T>&, const mopr<T>&);
         friend bool operator!= <> (const mopr<T>&, const mopr<T>&);
@@ -892,6 +982,10 @@ namespace qbasis {
         // question if each opr_prod is diagonal
         bool q_diagonal() const;
         
+        // decompose as half + half^\dagger + self, where each term in self is Hermitian by itself
+        // returns false (with half and self set to zero) if not possible, e.g. when not Hermitian
+        bool split_hermitian(mopr<T> &half, mopr<T> &self) const;
+        
         uint32_t size() const { return static_cast<uint32_t>(mats.size()); }
         
         opr_prod<T>& operator[](uint32_t n);
@@ -935,6 +1029,65 @@ namespace qbasis {
     };
     
     
+    // -------------- compiled form of mopr ----------------
+    // mopr flattened into contiguous tables, for repeated actions on basis states (e.g. matrix-free H*v)
+    // for each fundamental operator, the bit positions inside mbits, the local matrix and the byte masks
+    // covering all fermions traversed (for the sign) are computed once, when compiled
+    template <typename T> class mopr_compiled {
+    public:
+        // default constructor
+        mopr_compiled() : valid(true), total_bytes(0) {}
+        
+        // compile lhs, according to the memory layout given by props
+        mopr_compiled(const mopr<T> &lhs, const std::vector<basis_prop> &props);
+        
+        //    ----------- basic inquiries ----------
+        // false if lhs acting on orbitals not present in props
+        bool q_valid() const { return valid; }
+        
+        bool q_zero() const { return coeffs.empty(); }
+        
+        uint32_t size() const { return static_cast<uint32_t>(coeffs.size()); }
+        
+        // wavefunction = mopr * mbasis_elem
+        // note: res is not simplified, the same basis element may appear more than once
+        void apply(const mbasis_elem &rhs, wavefunction<T> &res) const;
+        
+    private:
+        struct local_opr {
+            uint32_t site;
+            uint32_t orbital;
+            uint32_t mat_pos;                  // local matrix stored in mats[mat_pos, mat_pos + dim*dim) or [mat_pos, mat_pos + dim) if diagonal
+            uint32_t parity_pos;               // byte masks stored in parity_masks[parity_pos, parity_pos + parity_len)
+            uint16_t parity_byte;              // the byte in mbits corresponding to parity_masks[parity_pos]
+            uint16_t parity_len;
+            uint16_t byte_pos;                 // the (first) byte in mbits storing the site
+            uint8_t bit_pos;
+            uint8_t mask;
+            uint8_t dim;
+            bool cross;                        // if the site crosses the boundary of two bytes
+            bool diagonal;
+            bool fermion;
+            bool parity_by_bits;               // if the fermionic sign can be read from the parity of the masked bits
+        };
+        
+        bool valid;
+        int total_bytes;
+        std::vector<basis_prop> props;         // only used when parity_by_bits == false
+        std::vector<T> coeffs;                 // coefficient of each operator product
+        std::vector<uint32_t> term_bgn;        // operator product n: oprs[term_bgn[n], term_bgn[n+1]), in the order of action
+        std::vector<local_opr> oprs;
+        std::vector<T> mats;
+        std::vector<uint8_t> parity_masks;
+        
+        uint8_t read(const uint8_t *bits, const local_opr &op) const;
+        
+        void write(uint8_t *bits, const local_opr &op, const uint8_t &val) const;
+        
+        int parity(const mbasis_elem &state, const local_opr &op) const;
+    };
+    
+    
     
     
 //  --------------------------  part 3: sparse matrices ------------------------
@@ -1014,7 +1167,44 @@ namespace qbasis {
         
         // construcotr from an lil_mat, and if sym_ == true, use only the upper triangle
         // then destroy the lil_mat
-        csr_mat(lil_mat<T> &old);
+        // if check_herm == true and the full matrix is stored, exit when it is not hermitian
+        csr_mat(lil_mat<T> &old, const bool &check_herm = true);
+        
+        // constructor from a row generator, without the intermediate lil_mat
+        // gen(row, buf) appends the (col, val) pairs of the given row to buf, and has to be thread-safe
+        // pass 1 counts the nonzero elements per row, pass 2 regenerates the rows and fills the arrays
+        // in each row: duplicates are summed up, tiny elements dropped, the diagonal always stored,
+        // and if sym_ == true, only the upper triangle kept
+        // if file is not empty, pass 2 streams blocks of rows to the file (see mmap_open for the format),
+        // which is then memory-mapped, and only ia stays in memory during the construction
+        csr_mat(const MKL_INT &n, const bool &sym_,
+                const std::function<void(const MKL_INT&, std::vector<std::pair<MKL_INT,T>>&)> &gen,
+                const bool &check_herm = true, const std::string &file = "");
+        
+        // use a file-backed matrix: val, ja, ia point into a read-only mapping of the file,
+        // streamed from disk by MultMv2 (with readahead hints), using the native or mkl_ie backend
+        // file format (native endianness), every section starting at a multiple of 4096 bytes:
+        //   header: char[8] "QBCSR01", then uint64_t dim, nnz, sym, sizeof(T), sizeof(MKL_INT),
+        //           offsets of ia, ja, val (in bytes, from the beginning of the file)
+        //   ia:     (dim + 1) MKL_INT
+        //   ja:     nnz MKL_INT, sorted within each row
+        //   val:    nnz T
+        void mmap_open(const std::string &filename);
+        
+        bool q_mmap() const { return mmap_addr != nullptr; }
+        
+        // write the matrix in the file format of mmap_open, with crc32 checksums appended:
+        //   header: after the offsets, uint64_t chunk size (1M bytes) and offset of the checksums
+        //   checksums: uint64_t count, then uint32_t crc of the header (magic + 10 uint64_t),
+        //              and of each chunk of ia, ja, val (the last chunk of each section may be shorter)
+        // compressed indices and real values are decoded, i.e. always stored as plain MKL_INT and T
+        // written to filename.tmp first and then renamed, existing mappings of filename remain valid. returns 0 on success
+        int save(const std::string &filename) const;
+        
+        // read a matrix written by save, verifying the checksums chunk by chunk
+        // if mapped == true, memory-map the file after the verification instead of reading it
+        // returns 0 on success, 1 if the file is missing, incompatible or corrupted (the matrix untouched)
+        int load(const std::string &filename, const bool &mapped = false);
         
         // matrix vector product
         // y = H * x + y
@@ -1022,15 +1212,127 @@ namespace qbasis {
         // y = H * x
         void MultMv(T *x, T *y);              // non-const, to be compatible with arpack++
         
+        // block product with k vectors stored interleaved: X[i * k + s] is the i-th component of vector s
+        // Y = H * X + Y, streaming the matrix only once (native kernel, whatever the spmv backend)
+        void MultMm2(const T *X, T *Y, const MKL_INT &k) const;
+        // Y = H * X
+        void MultMm(const T *X, T *Y, const MKL_INT &k) const;
+        
+        // three-term recurrence of Lanczos: w = H * v - b * w, a = Re(v, w), returns (w, w)
+        // the native backend does it in a single sweep, the others fall back to lanczos_step_generic
+        double lanczos_step(const T *v, T *w, const double &b, double &a) const;
+        
+        // the same two for vectors stored in single precision (see precision_policy): the elements are read and
+        // combined in double precision, the dot products and norms accumulated in double, and only the results
+        // rounded when stored. always with the native kernel, whatever the spmv backend
+        typedef typename precision_policy<T>::single single_t;
+        void MultMv2(const single_t *x, single_t *y) const;
+        double lanczos_step(const single_t *v, single_t *w, const double &b, double &a) const;
+        
+        // select the backend of MultMv2, and prepare its data layout (kept across copies):
+        // "mkl_csrmv": the classic mkl_csrmv (default)
+        // "native":    multithreaded csr kernel, no dependence on mkl
+        // "sell":      SELL-C-sigma layout, chunks of C rows (sorted by length within windows of sigma rows),
+        //              stored column-major inside each chunk. the lower triangle is expanded if sym == true
+        // "mkl_ie":    mkl inspector-executor routines, tuned by mkl_sparse_optimize
+        void set_spmv(const std::string &backend, const MKL_INT &C = 8, const MKL_INT &sigma = 256);
+        
+        std::string spmv() const;
+        
+        // storage of the column indices (MultMv2 decodes them on the fly, and only the "native" backend supports it):
+        // "mkl_int": plain MKL_INT array (default, required by mkl_csrmv, sell and mkl_ie)
+        // "idx32":   32-bit offsets relative to the smallest column of each block of rows
+        // "delta":   variable-length (7 bits per byte) gaps between consecutive columns of each row
+        void set_index(const std::string &mode);
+        
+        std::string index() const;
+        
+        // if all the matrix elements are real (imaginary parts below sparse_precision), store them as double,
+        // and use the native backend with the real matrix acting on complex vectors. returns true if converted
+        bool use_real_values();
+        
+        // restore the values of type T
+        void use_complex_values();
+        
+        bool q_real_values() const { return val == nullptr && ! val_re.empty(); }
+        
         std::vector<T> to_dense() const;
         
+        // check if the matrix is hermitian (trivially true if only the upper triangle stored)
+        // parallel over rows, binary search for the conjugate element in the sorted ja
+        // the first failure found is printed
+        bool q_hermitian() const;
+        
+        // reverse Cuthill-McKee ordering of the (symmetrized) sparsity pattern, reducing the bandwidth
+        // returns perm, with perm[i] the new position of row/column i
+        std::vector<MKL_INT> rcm_order() const;
+        
+        // H -> P H P^T, i.e. row/column i moved to perm[i]. index mode, real values and spmv backend are kept
+        // returns false (the matrix untouched) for a file-backed matrix
+        bool permute(const std::vector<MKL_INT> &perm);
+        
     private:
+        // print the statistics of the matrix
+        void prt_info() const;
+        
+        // build (or free) the data layout of the current spmv backend
+        void prepare_spmv();
+        void destroy_spmv();
+        
+        // v: matrix elements, either val or val_re
+        // Rows(i) gives a cursor over the columns of row i, with next() returning the next column
+        // y = H * x + beta * y, and if dots != nullptr: dots[0] = Re(x, y), dots[1] = (y, y) of the result
+        // X: T, or single_t with the arithmetic still in T
+        template <typename X, typename V>
+        void MultMv2_native(const X *x, X *y, const V *v, const double &beta = 1.0, double *dots = nullptr) const;
+        template <typename X, typename V, typename Rows>
+        void MultMv2_native(const X *x, X *y, const V *v, const Rows &rows,
+                            const double &beta = 1.0, double *dots = nullptr) const;
+        void MultMv2_sell(const T *x, T *y) const;
+        template <typename V>
+        void MultMm2_native(const T *X, T *Y, const MKL_INT &k, const V *v) const;
+        template <typename V, typename Rows>
+        void MultMm2_native(const T *X, T *Y, const MKL_INT &k, const V *v, const Rows &rows) const;
+        // native kernels with sym == true: (re)build sym_part if the # of threads changed, size y_private for k vectors
+        template <typename Rows>
+        void prepare_sym_part(const Rows &rows, const MKL_INT &k) const;
+        
+        // all column indices (matrix elements), decoded
+        void decode_ja(std::vector<MKL_INT> &cols) const;
+        void decode_val(std::vector<T> &vals) const;
+        
         MKL_INT dim;
         MKL_INT nnz;        // number of non-zero entries
         bool sym;           // if storing only upper triangle
         T *val;
         MKL_INT *ja;
         MKL_INT *ia;
+        
+        uint32_t spmv_backend = 0;                   // 0: mkl_csrmv, 1: native, 2: sell, 3: mkl_ie
+        MKL_INT sell_C = 8;                          // rows per chunk
+        MKL_INT sell_sigma = 256;                    // sorting window
+        std::vector<MKL_INT> sell_ptr;               // start of each chunk in sell_col/sell_val
+        std::vector<MKL_INT> sell_row;               // original row of each slot, -1 for padding
+        std::vector<MKL_INT> sell_col;
+        std::vector<T> sell_val;
+        sparse_matrix_t mkl_handle = nullptr;        // refers to val, ja, ia (not copied by mkl)
+        matrix_descr mkl_descr;
+        mutable std::vector<MKL_INT> sym_part;           // native kernel with sym == true: row blocks (one per thread)
+        mutable std::vector<std::vector<T>> y_private;   // and their buffers for the scatter beyond the block
+        mutable std::vector<MKL_INT> sym_span;           // # of rows covered by each buffer
+        
+        uint32_t idx_mode = 0;                       // 0: ja, 1: ja32, 2: ja_delta (ja freed if not 0)
+        std::vector<uint32_t> ja32;                  // col - ja32_base[row / ja32_block]
+        std::vector<MKL_INT> ja32_base;
+        std::vector<uint8_t> ja_delta;               // per row: zigzag(col_0 - row), col_1 - col_0, ...
+        std::vector<uint64_t> ia_delta;              // start of each row in ja_delta
+        static const MKL_INT ja32_block = 4096;
+        std::vector<double> val_re;                  // real part of the values, val freed if not empty
+        
+        void mmap_close();
+        void *mmap_addr = nullptr;                   // file-backed: val, ja, ia point into the mapping
+        uint64_t mmap_len = 0;
+        std::string mmap_name;
     };
     
     
@@ -1075,10 +1377,78 @@ namespace qbasis {
     //
     // if purpose == "sr_vec0" (smallest eigenvector):
     // same as "sr_val0", but with one extra column storing the eigenvector
+    // the recurrence of an earlier "sr_val0" run of mm steps is replayed with the stored a, b:
+    // on entry, hessenberg as left by that run, v[0] the same starting vector, k = 0 and np = mm - 1
+    // on exit, v[2] = sum_{j < mm} s[j] * v[j], the Ritz vector of the lowest Ritz value
+    // ("sr_vec1": the same for "sr_val1", with phi0 in v[2] and the Ritz vector in v[3])
+    //
+    // basis: if not null, the Lanczos vectors v[0], v[1], ... are also appended to it ("val" purposes only,
+    // and only when starting from k = 0), for krylov_basis::combine to form Ritz vectors afterwards
+    //
+    // precision: T is the storage of v, either the scalar type of mat, or its single precision counterpart
+    // (precision_policy<T>::single, for csr_mat only). in single precision the recurrence is still computed
+    // in double, with a and b accumulated in double, while the thresholds of convergence, breakdown and
+    // re-orthogonalization become precision_policy<T>::tol()
+    
+    template <typename T> class krylov_basis;
     
     template <typename T, typename MAT>
     void lanczos(MKL_INT k, MKL_INT np, const MKL_INT &maxit, MKL_INT &m, const MKL_INT &dim,
-                 const MAT &mat, T v[], double hessenberg[], const std::string &purpose);
+                 const MAT &mat, T v[], double hessenberg[], const std::string &purpose,
+                 krylov_basis<T> *basis = nullptr);
+    
+    // storage of the Lanczos vectors, for forming Ritz vectors without a second Lanczos pass
+    // room for nvec vectors of length dim is mapped at construction (pages touched only when used):
+    // anonymous memory if file is empty, otherwise the file (created, removed on destruction),
+    // which the kernel writes back to disk when memory runs short
+    // if single == true, the vectors are rounded to precision_policy<T>::single when pushed (half the room),
+    // and combined in double precision
+    template <typename T> class krylov_basis {
+    public:
+        krylov_basis(const MKL_INT &dim_, const MKL_INT &nvec_, const std::string &file = "", const bool &single_ = false);
+        krylov_basis(const krylov_basis<T> &old) = delete;
+        krylov_basis<T> &operator=(const krylov_basis<T> &old) = delete;
+        ~krylov_basis();
+        
+        // append v as the next vector, ignored when full
+        void push(const T v[]);
+        
+        // forget the stored vectors, keeping the mapping
+        void clear() { cnt = 0; }
+        
+        MKL_INT size() const { return cnt; }
+        
+        // y = sum_{j < m} s[j] * v[j], m <= size()
+        void combine(const MKL_INT &m, const double s[], T y[]) const;
+        
+        bool q_single() const { return single; }
+        
+    private:
+        typedef typename precision_policy<T>::single S;
+        MKL_INT dim;
+        MKL_INT nvec;
+        bool single;
+        MKL_INT cnt = 0;
+        void *addr = nullptr;                                                    // T, or S if single
+        uint64_t len = 0;
+        std::string name;
+    };
+    
+    // one step of the three-term recurrence, as MAT::lanczos_step for operators without a fused kernel:
+    // w = H * v - b * w (w holding the previous Lanczos vector on entry), a = Re(v, w), returns (w, w)
+    // scaling, mat.MultMv2, then the dot product and the norm computed in the same sweep
+    template <typename T, typename MAT>
+    double lanczos_step_generic(const MKL_INT &dim, const MAT &mat, const T v[], T w[], const double &b, double &a);
+    
+    // finish the step: w = (w - a * v) / b in one sweep, returns || w - a * v ||
+    template <typename T>
+    double lanczos_step_finish(const MKL_INT &dim, const T v[], T w[], const double &a, const double &b);
+    
+    // finish the step with b = || w - a * v || estimated from w2 = (w, w) returned by lanczos_step,
+    // one more sweep only if the estimate turns out inaccurate. returns b
+    // nv: (v, v) on entry, (w, w) on exit, both 1 up to round-off
+    template <typename T>
+    double lanczos_step_normalize(const MKL_INT &dim, const T v[], T w[], const double &a, const double &w2, double &nv);
     
     
     
@@ -1087,6 +1457,8 @@ namespace qbasis {
     // on entry: assuming m-step finished, v contains the initital guess v[m]
     //           r[0] = -(H-E0)*v[0], p[0] = r[0]
     // on exit:  v rewritten by the converged solution
+    // in single precision storage (see lanczos), converged only to precision_policy<T>::tol(),
+    // to be refined by a double precision run started from the solution
     template <typename T, typename MAT>
     void eigenvec_CG(const MKL_INT &dim, const MKL_INT &maxit, MKL_INT &m,
                      const MAT &mat, const T &E0, double &accu,
@@ -1125,6 +1497,31 @@ namespace qbasis {
               MKL_INT &nconv, double eigenvals[], T eigenvecs[],
               const bool &use_arpack = true);
     
+    // thick-restart Lanczos for the nev lowest (order = "sr") or highest (order = "lr") eigenpairs of a Hermitian mat
+    // ncv: number of Lanczos vectors held in memory (ncv + 1 columns of dim), nev + 2 <= ncv
+    // maxit: maximum number of restarts
+    // each restart keeps nev + (ncv - nev) / 2 Ritz vectors, converged ones are locked and deflated;
+    // new vectors are always orthogonalized against the kept Ritz vectors (selective),
+    // and against the rest of the basis only when the omega recurrence signals loss of orthogonality (partial)
+    // with enable_ckpt, the state after each restart is saved in out_Qckpt and resumed from there
+    // on exit, eigenvals (size nev) and eigenvecs (size dim * nev) sorted, nconv of them converged
+    template <typename T, typename MAT>
+    void trlan(const MKL_INT &dim, const MAT &mat, const T v0[], const MKL_INT &nev, const MKL_INT &ncv,
+               const MKL_INT &maxit, const std::string &order,
+               MKL_INT &nconv, double eigenvals[], T eigenvecs[]);
+    
+    // locally optimal block preconditioned conjugate gradient (no preconditioner) for the nev lowest (order = "sr")
+    // or highest (order = "lr") eigenpairs of a Hermitian mat, suited for (nearly) degenerate multiplets
+    // v0: starting block of p vectors (size dim * p), nev <= p, 3 * p <= dim
+    // each iteration applies mat to the block of unconverged residuals with mat.MultMm,
+    // and does the Rayleigh-Ritz in span{X, W, P} with a stabilized (SVQB) orthonormalization
+    // maxit: maximum number of iterations
+    // on exit, eigenvals (size nev) and eigenvecs (size dim * nev) sorted, nconv of them converged
+    template <typename T, typename MAT>
+    void lobpcg(const MKL_INT &dim, const MAT &mat, const T v0[], const MKL_INT &nev, const MKL_INT &p,
+                const MKL_INT &maxit, const std::string &order,
+                MKL_INT &nconv, double eigenvals[], T eigenvecs[]);
+    
     
 //  ----------------------------- part 5: Lattices  ----------------------------
 //  ----------------------------------------------------------------------------
@@ -1156,8 +1553,11 @@ namespace qbasis {
         // return a vector containing the positions of each site after translation
         //std::vector<uint32_t> translation_plan(const std::vector<int> &disp) const;
         
-        void translation_plan(std::vector<uint32_t> &plan, const std::vector<int> &disp,
-                              std::vector<int> &scratch_coor, std::vector<int> &scratch_work) const;
+        // copy of the cached plan below
+        void translation_plan(std::vector<uint32_t> &plan, const std::vector<int> &disp) const;
+        
+        // cached plan (total_sites() entries) of the translation by disp (taken modulo the linear sizes)
+        const uint32_t *translation_plan(const std::vector<int> &disp) const;
         
         
         // return a vector containing the positions of each site after rotation
@@ -1238,8 +1638,11 @@ namespace qbasis {
         uint32_t dim_spec;                   // the code starts labeling sites from a dimension which has even # of sites
         
         std::vector<std::pair<std::vector<int>,int>> site2coor_map;
-        std::vector<std::map<std::vector<int>,uint32_t>> coor2site_map;
-        //std::map<std::pair<std::vector<int>,int>,uint32_t> coor2site_map;
+        std::vector<uint32_t> coor2site_map;  // site of (coor, sub) at sub + num_sub * (coor[0] + L[0] * (coor[1] + L[1] * ...))
+        std::vector<uint32_t> plans_trans;    // translation plans, the one of disp at Nsites * (disp[0] + L[0] * (disp[1] + ...))
+        
+        // fill site2coor_map, coor2site_map and plans_trans
+        void init_maps();
     };
     
     
@@ -1249,11 +1652,14 @@ namespace qbasis {
     template <typename T> class model {
     public:
         bool matrix_free;                                                        ///< if generating matrix on the fly
+        bool matrix_free_upper_triangle;                                         ///< if on the fly, generate each pair of hops only once (full basis only; falls back to generating all hops if their reach needs more than one extra vector, see MultMm2)
+        bool mixed_precision;                                                    ///< keep Lanczos vectors in single precision where possible (not with enable_ckpt), see locate_E0_lanczos and measure_full_dynamic
         std::vector<basis_prop> props, props_sub_a, props_sub_b;
         mopr<T> Ham_diag;                                                        ///< diagonal part of H
         mopr<T> Ham_off_diag;                                                    ///< offdiagonal part of H
         mopr<T> Ham_vrnl;                                                        ///< used for generating Trugman's basis
         MKL_INT nconv;
+        std::string csr_cache;                                                   ///< if not empty, directory to keep the generated CSR matrices across runs (see generate_Ham_sparse_full)
         
         // controls which sector of basis to be active
         // by default sec_full = 0 (e.g. Sz=0 ground state sector of Heisenberg model);
@@ -1288,7 +1694,13 @@ namespace qbasis {
         std::vector<std::vector<MKL_INT>> Lin_Ja_repr;
         std::vector<std::vector<MKL_INT>> Lin_Jb_repr;
         
-        /** \brief 1 / <rep | P_k | rep> */
+        /** \brief bandwidth reducing permutations of HamMat_csr_full/repr (see reorder_Ham_sparse), empty if not reordered.
+         *  perm[i]: position of basis state i in the vectors seen by the sparse solvers
+         */
+        std::vector<std::vector<MKL_INT>> perm_full;
+        std::vector<std::vector<MKL_INT>> perm_repr;
+        
+        /** \brief sqrt(1 / <rep | P_k | rep>) */
         std::vector<std::vector<double>> norm_repr;
         
         /** \brief 1 / <vac | P_k | vac> = omega_g, for the variational vacuum state */
@@ -1333,12 +1745,16 @@ namespace qbasis {
         {
             props.emplace_back(n_sites,dim_local_,Nf_map,dilute_);
             basis_props_split(props, props_sub_a, props_sub_b);
+            scratch.clear();
+            Ham_off_diag_dirty = true;
         }
         
         void add_orbital(const uint32_t &n_sites, const std::string &s, const extra_info &ex = extra_info{0})
         {
             props.emplace_back(n_sites, s, ex);
             basis_props_split(props, props_sub_a, props_sub_b);
+            scratch.clear();
+            Ham_off_diag_dirty = true;
         }
         
         uint32_t local_dimension() const;
@@ -1388,23 +1804,56 @@ namespace qbasis {
                                         const uint32_t &sec_full = 0,
                                         const uint32_t &sec_repr = 0);
         
+        // content hash (16 hex digits) of everything the CSR matrix of a sector depends on:
+        // props, Ham_diag, Ham_off_diag, the basis of the sector (thus its quantum numbers), upper_triangle,
+        // and for basis_type "repr", "vrnl" or "repr_deprecated" (sec: sec_repr) also the momentum and the lattice
+        // used as the file name in csr_cache
+        std::string Ham_hash(const std::string &basis_type, const uint32_t &sec, const bool &upper_triangle,
+                             const uint32_t &sec_full = 0) const;
+        
         // generate the Hamiltonian using basis_full
+        // if csr_cache is set, the matrix is loaded from there when its Ham_hash matches (mapped if csr_file not empty),
+        // otherwise saved there after the generation
+        // check_hermitian: validate the matrix when upper_triangle == false, can be skipped in production runs
+        // csr_index: storage of the column indices, "mkl_int", "idx32" or "delta" (see csr_mat::set_index)
+        // sectors with only real matrix elements are stored as double automatically (see csr_mat::use_real_values)
+        // csr_file: if not empty, the matrix is streamed to this file and memory-mapped (see csr_mat::mmap_open)
         void generate_Ham_sparse_full(const uint32_t &sec_full = 0,
-                                      const bool &upper_triangle = true);
+                                      const bool &upper_triangle = true,
+                                      const bool &check_hermitian = true,
+                                      const std::string &csr_index = "mkl_int",
+                                      const std::string &csr_file = "");
         
         // generate the Hamiltonian using basis_repr
         // a few artificial diagonal elements above 100, corresponding to zero norm states
         void generate_Ham_sparse_repr(const uint32_t &sec_repr = 0,
-                                      const bool &upper_triangle = true);
+                                      const bool &upper_triangle = true,
+                                      const bool &check_hermitian = true,
+                                      const std::string &csr_index = "mkl_int",
+                                      const std::string &csr_file = "");
         
         // generate the Hamiltonian using basis_vrnl
         void generate_Ham_sparse_vrnl(const uint32_t &sec_vrnl = 0,
-                                      const bool &upper_triangle = true);
+                                      const bool &upper_triangle = true,
+                                      const bool &check_hermitian = true,
+                                      const std::string &csr_index = "mkl_int",
+                                      const std::string &csr_file = "");
         
         // a few artificial diagonal elements above 100, corresponding to zero norm states
         void generate_Ham_sparse_repr_deprecated(const uint32_t &sec_full = 0,
                                                  const uint32_t &sec_repr = 0,
-                                                 const bool &upper_triangle = true); // generate the Hamiltonian using basis_repr
+                                                 const bool &upper_triangle = true,
+                                                 const bool &check_hermitian = true,
+                                                 const std::string &csr_index = "mkl_int",
+                                                 const std::string &csr_file = ""); // generate the Hamiltonian using basis_repr
+        
+        /** \brief reorder the rows/columns of HamMat_csr_full[sec] (sec_sym_ = 0) or HamMat_csr_repr[sec] (sec_sym_ = 1)
+         *  to improve the locality of the SpMV, the permutation being kept in perm_full/perm_repr.
+         *  method: "rcm" (reverse Cuthill-McKee on the sparsity pattern), or "none" (back to the basis order).
+         *  The sparse solvers work in the permuted order, their eigenvectors are returned in the basis order.
+         *  Regenerating the matrix drops the permutation.
+         */
+        void reorder_Ham_sparse(const uint32_t &sec_sym_, const uint32_t &sec, const std::string &method = "rcm");
         
         // generate a dense matrix of the Hamiltonian
         std::vector<std::complex<double>> to_dense(const uint32_t &sec_mat_ = 0);
@@ -1414,6 +1863,16 @@ namespace qbasis {
         /** \brief y = H * x (matrix generated on the fly) */
         void MultMv(T *x, T *y);              // non-const, to be compatible with arpack++
         
+        /** \brief Y = H * X + Y for k vectors stored interleaved, X[i * k + s] (matrix generated on the fly).
+         *  The off-diagonal terms of each row are generated once for all the k vectors
+         */
+        void MultMm2(const T *X, T *Y, const MKL_INT &k) const;
+        /** \brief Y = H * X (matrix generated on the fly) */
+        void MultMm(const T *X, T *Y, const MKL_INT &k) const;
+        
+        /** \brief w = H * v - b * w, a = Re(v, w), returns (w, w) (matrix generated on the fly, see csr_mat::lanczos_step) */
+        double lanczos_step(const T *v, T *w, const double &b, double &a) const;
+        
         // Note: in this function, (nev, ncv, maxit) have different meanings comparing to IRAM!
         // 1 <= nev <= 2, nev-1 <= ncv <= nev
         // nev = 1, calcualte up to ground state energy
@@ -1421,7 +1880,18 @@ namespace qbasis {
         // ncv = 1, calculate up to ground state eigenvector
         // ncv = 2, calculate up to 1st excited excited state eigenvector
         // sec_sym_=0: without translation; sec_sym_=1, with translation symmetry
-        void locate_E0_lanczos(const uint32_t &sec_sym_, const MKL_INT &nev = 1, const MKL_INT &ncv = 1, MKL_INT maxit = 1000);
+        // vec_method: how the eigenvectors are obtained from the Lanczos runs for the energies
+        //   "cg":     solving (H - E) v = 0 with conjugate gradient
+        //   "replay": a second Lanczos pass with the stored a, b, accumulating the Ritz vector (no extra memory)
+        //   "store":  keeping the Lanczos vectors in memory, no extra matrix-vector product
+        //   "spill":  as "store", but in a memory mapping of basis_file, paged to disk as needed
+        //   "auto":   "store" if maxit vectors fit in half of the available memory, otherwise "replay"
+        // "cg" is used anyway when the energies were restored from a checkpoint
+        // with mixed_precision, "store" and "spill" keep the Lanczos vectors in single precision (half the room),
+        // and the Ritz vectors formed from them (accurate to about 1e-7) are refined with CG in double precision
+        void locate_E0_lanczos(const uint32_t &sec_sym_, const MKL_INT &nev = 1, const MKL_INT &ncv = 1, MKL_INT maxit = 1000,
+                               const std::string &vec_method = "auto",
+                               const std::string &basis_file = "lanczos_basis.tmp");
         
         /** \brief calculate the lowest eigenstates using IRAM
          *  nev, ncv, maxit following ARPACK definition
@@ -1429,6 +1899,18 @@ namespace qbasis {
          */
         void locate_E0_iram(const uint32_t &sec_sym_, const MKL_INT &nev = 2, const MKL_INT &ncv = 6, MKL_INT maxit = 0);
         
+        /** \brief calculate the lowest eigenstates using thick-restart Lanczos (see trlan)
+         *  nev: number of eigenpairs, ncv: number of Lanczos vectors in memory (> nev + 1), maxit: maximum restarts
+         *  sec_sym_ : 0 (full), 1 (repr), 2 (vrnl)
+         */
+        void locate_E0_trlan(const uint32_t &sec_sym_, const MKL_INT &nev = 4, const MKL_INT &ncv = 20, MKL_INT maxit = 0);
+        
+        /** \brief calculate the lowest eigenstates using LOBPCG (see lobpcg), resolving degenerate multiplets
+         *  nev: number of eigenpairs, p: block size (>= nev, 0 for nev + 2), maxit: maximum iterations
+         *  sec_sym_ : 0 (full), 1 (repr), 2 (vrnl)
+         */
+        void locate_E0_lobpcg(const uint32_t &sec_sym_, const MKL_INT &nev = 4, MKL_INT p = 0, MKL_INT maxit = 0);
+        
         /** \brief calculate the highest eigenstates using IRAM
          *  nev, ncv, maxit following ARPACK definition.
          *  sec_sym_ : 0 (full), 1 (repr), 2 (vrnl).
@@ -1498,6 +1980,8 @@ namespace qbasis {
          * \f]
          *
          *  on exit: \f$ a_i \f$, \f$ b_i \f$ and norm are given.
+         *  With mixed_precision and the matrix in CSR form, the Lanczos vectors are stored in single precision
+         *  (a, b still accumulated in double, accurate to about 1e-6), halving the memory of the run.
          *  NEED enable CKPT later!!!
          */
         void measure_full_dynamic(const mopr<T> &Aq, const uint32_t &sec_old, const uint32_t &sec_new,
@@ -1619,12 +2103,106 @@ namespace qbasis {
         std::vector<std::pair<std::vector<std::vector<uint32_t>>,uint32_t>> groups_sub;
         std::vector<uint32_t>              omega_g_sub;
         std::vector<uint32_t>              belong2group_sub;
-        MltArray_PairVec                   Weisse_e_lt, Weisse_e_eq, Weisse_e_gt;
-        MltArray_uint32                    Weisse_w_lt, Weisse_w_eq, Weisse_w_gt;
+        // the tables e<, e=, e> and w<, w=, w> flattened: for representatives ra (group ga), rb (group gb),
+        // and sublattice translations ja, jb, let c = 0,1,2 if ra <,=,> rb. Then
+        // Weisse_w_flat[c + 3 * (ga + G * gb) + Weisse_offset(jb)] = w,
+        // record n = c + 3 * (ga + G * gb) + Weisse_offset(ja) + N * Weisse_offset(jb) of Weisse_e_flat
+        // holds 2D integers {disp_i, disp_j} from position 2D * n on,
+        // with G the # of groups, N the # of sublattice translations, D the dimension of the sublattice
+        std::vector<uint32_t>              Weisse_e_flat, Weisse_w_flat;
+        std::vector<uint64_t>              Weisse_size;                // # of sublattice translations in each direction
+        std::vector<uint64_t>              Weisse_off_a, Weisse_off_b; // Weisse_offset(dist2rep_sub[label]), and N times it
+        
+        uint64_t Weisse_offset(const std::vector<int> &disp) const;
+        
+        // exp(i 2 pi sum_d k_d disp_d / L_d) of each sector (sum over directions with translation symmetry),
+        // indexed by the translation disp of the parent lattice (with linear sizes L), see phase_pos
+        std::vector<std::vector<std::complex<double>>> phase_repr;
+        
+        static uint64_t phase_pos(const std::vector<int> &disp, const std::vector<uint32_t> &L)
+        {
+            uint64_t res = 0;
+            for (auto d = disp.size(); d-- > 0; ) res = res * L[d] + static_cast<uint64_t>(disp[d]);
+            return res;
+        }
+        
+        // position of the record (in Weisse_e_flat) for the sublattice states with labels label_a, label_b
+        uint64_t Weisse_e_pos(const uint64_t &label_a, const uint64_t &label_b) const
+        {
+            auto ra = belong2rep_sub[label_a];
+            auto rb = belong2rep_sub[label_b];
+            uint64_t num_groups = groups_sub.size();
+            uint64_t n = static_cast<uint64_t>((ra > rb) + (ra >= rb))
+                       + 3 * (belong2group_sub[ra] + num_groups * belong2group_sub[rb])
+                       + Weisse_off_a[label_a] + Weisse_off_b[label_b];
+            return n * 2 * Weisse_size.size();
+        }
+        
+        // Ham_off_diag compiled, add_Ham and add_orbital only mark it dirty,
+        // recompiled by compile_Ham_off_diag() on the first use afterwards (MultMm2, generate_Ham_sparse_full/repr)
+        // if Ham_off_diag_split, then Ham_off_diag = half + half^\dagger + self
+        mutable mopr_compiled<T>           Ham_off_diag_compiled;
+        mutable mopr_compiled<T>           Ham_off_diag_half_compiled;
+        mutable mopr_compiled<T>           Ham_off_diag_self_compiled;
+        mutable bool                       Ham_off_diag_split;
+        mutable bool                       Ham_off_diag_dirty;
+        
+        void compile_Ham_off_diag() const;
+        
+        // per-thread scratch space of the hot loops (MultMv2, generate_Ham_sparse, moprXvec...),
+        // created once and reused across calls; rebuilt only when the thread count changes
+        struct scratch_thread {
+            wavefunction<T>                    intermediate_state;
+            mbasis_elem                        basis_temp, state_sub_new1, state_sub_new2, ra_z_Tj_rb;
+            std::vector<uint8_t>               work1;
+            std::vector<uint64_t>              work2;
+            std::vector<int>                   disp_i_int, disp_j_int;
+            std::vector<double>                cart;                  // Cartesian displacement (vrnl phases)
+            std::vector<std::pair<MKL_INT,T>>  values;
+            std::vector<T>                     y_private;
+            
+            scratch_thread(const std::vector<basis_prop> &props, const uint32_t &dim_latt) :
+                intermediate_state(props), basis_temp(props), disp_i_int(dim_latt), disp_j_int(dim_latt) {}
+            
+            uint64_t footprint() const;                            // bytes of heap owned
+        };
+        mutable std::vector<scratch_thread> scratch;
+        mutable uint64_t                    scratch_allocs;        // # of times the scratch space had to grow
+        
+        // make sure the scratch space is ready, returns the number of threads
+        int scratch_prepare() const;
+        
+        // matrix_free_upper_triangle: rows of sector sym_sec cut into one contiguous block per thread (sym_part),
+        // the scatter of block b outside of itself reaches the columns [sym_lo[b], sym_hi[b]);
+        // sym_ok false if the private buffers for that would be longer than dim in total.
+        // found with one pass over the hops, cleared when the basis or the Hamiltonian changes
+        mutable std::vector<MKL_INT>        sym_part, sym_lo, sym_hi;
+        mutable uint32_t                    sym_sec;
+        mutable bool                        sym_ok;
+        
+        // permutation of the solver vectors (ncols columns of length dim, column-major) of the sector:
+        // to_basis == true: from the order of HamMat_csr to the basis order; false: the other way round
+        // nothing to do if the sector is not reordered
+        template <typename V>
+        void perm_vecs(const uint32_t &sec_sym_, const uint32_t &sec, V *vecs, const MKL_INT &ncols, const bool &to_basis) const;
+        
+        // mixed_precision in effect: not with checkpoints (their files would mix both precisions), a warning then
+        bool q_mixed_precision() const;
+        
+        // "dnmcs" Lanczos of HamMat, starting from vec_new (normalized, in the order of HamMat)
+        // vec_new: dim long if q_mixed_precision(), the run then in single precision, otherwise 2 * dim long
+        void lanczos_dynamic(const csr_mat<T> &HamMat, const MKL_INT &dim, std::vector<T> &vec_new,
+                             const MKL_INT &maxit, MKL_INT &m, double hessenberg[]) const;
+        
+        // file of the CSR matrix in csr_cache (created if missing), named after Ham_hash; empty if csr_cache not set
+        std::string csr_cache_file(const std::string &basis_type, const uint32_t &sec, const bool &upper_triangle,
+                                   const uint32_t &sec_full = 0) const;
         
         void ckpt_lczsE0_init(bool &E0_done, bool &V0_done, bool &E1_done, bool &V1_done, std::vector<T> &v);
         
-        void ckpt_lczsE0_updt(const bool &E0_done, const bool &V0_done, const bool &E1_done, const bool &V1_done);
+        // vec0: the ground state eigenvector when V0 just finished without CG, otherwise taken from the CG checkpoint
+        void ckpt_lczsE0_updt(const bool &E0_done, const bool &V0_done, const bool &E1_done, const bool &V1_done,
+                              T *vec0 = nullptr);
         
     };
     
@@ -1633,7 +2211,9 @@ namespace qbasis {
 //  ---------------------------  Kernel polynomial  ----------------------------
 //  ----------------------------------------------------------------------------
     
-    /** \brief use Lanczos to determine the upper and lower bound of the eigenvalues of the matrix. */
+    /** \brief use Lanczos to determine the upper and lower bound of the eigenvalues of the matrix.
+     *  v: 2 columns of workspace, which may be stored in single precision for a csr_mat (see lanczos).
+     */
     template <typename T, typename MAT>
     void energy_scale(const MKL_INT &dim, const MAT &mat, T v[], double &lo, double &hi,
                       const double &extend = 0.1, const MKL_INT &iters = 128);
@@ -1644,9 +2224,28 @@ namespace qbasis {
     
     std::string date_and_time();
     
+    // physical memory currently available, in bytes
+    uint64_t mem_available();
+    
     inline double conjugate(const double &rhs) { return rhs; }
     inline std::complex<double> conjugate(const std::complex<double> &rhs) { return std::conj(rhs); }
     
+    // parity (0 or 1) of the number of 1 bits in x
+    inline int bit_parity(uint64_t x)
+    {
+        x ^= (x >> 32);
+        x ^= (x >> 16);
+        x ^= (x >> 8);
+        x ^= (x >> 4);
+        x ^= (x >> 2);
+        x ^= (x >> 1);
+        return static_cast<int>(x & 1);
+    }
+    
+    // xor of (bits & masks) over the first nbits bits, 64 bits at a time
+    // bit_parity of the result gives the parity of the number of 1 bits in (bits & masks)
+    uint64_t masked_xor(const uint8_t *bits, const uint8_t *masks, const uint32_t &nbits);
+    
     // calculate base^index, in the case both are integers
     template <typename T1, typename T2>
     T2 int_pow(const T1 &base, const T1 &index);
@@ -1744,6 +2343,14 @@ namespace qbasis {
     void axpy(const MKL_INT n, const std::complex<double> alpha, const std::complex<double> *x, const MKL_INT incx, std::complex<double> *y, const MKL_INT incy) {
         zaxpy(&n, &alpha, x, &incx, y, &incy);
     }
+    inline // float
+    void axpy(const MKL_INT n, const float alpha, const float *x, const MKL_INT incx, float *y, const MKL_INT incy) {
+        saxpy(&n, &alpha, x, &incx, y, &incy);
+    }
+    inline // complex float
+    void axpy(const MKL_INT n, const std::complex<float> alpha, const std::complex<float> *x, const MKL_INT incx, std::complex<float> *y, const MKL_INT incy) {
+        caxpy(&n, &alpha, x, &incx, y, &incy);
+    }
     
     /** @file
      *  \fn void copy(const MKL_INT n, const double *x, const MKL_INT incx, double *y, const MKL_INT incy)
@@ -1761,6 +2368,14 @@ namespace qbasis {
     void copy(const MKL_INT n, const std::complex<double> *x, const MKL_INT incx, std::complex<double> *y, const MKL_INT incy) {
         zcopy(&n, x, &incx, y, &incy);
     }
+    inline // float
+    void copy(const MKL_INT n, const float *x, const MKL_INT incx, float *y, const MKL_INT incy) {
+        scopy(&n, x, &incx, y, &incy);
+    }
+    inline // complex float
+    void copy(const MKL_INT n, const std::complex<float> *x, const MKL_INT incx, std::complex<float> *y, const MKL_INT incy) {
+        ccopy(&n, x, &incx, y, &incy);
+    }
     
     // blas level 1, Euclidean norm of vector
     inline // double
@@ -1771,6 +2386,17 @@ namespace qbasis {
     double nrm2(const MKL_INT n, const std::complex<double> *x, const MKL_INT incx) {
         return dznrm2(&n, x, &incx);
     }
+    inline // float, accumulated in double
+    double nrm2(const MKL_INT n, const float *x, const MKL_INT incx) {
+        return std::sqrt(dsdot(&n, x, &incx, x, &incx));
+    }
+    inline // complex float, accumulated in double (as 2n floats)
+    double nrm2(const MKL_INT n, const std::complex<float> *x, const MKL_INT incx) {
+        MKL_INT n2 = 2 * n, inc2 = 2 * incx;
+        auto xf = reinterpret_cast<const float*>(x);
+        if (incx == 1) return std::sqrt(dsdot(&n2, xf, &incx, xf, &incx));
+        return std::sqrt(dsdot(&n, xf, &inc2, xf, &inc2) + dsdot(&n, xf + 1, &inc2, xf + 1, &inc2));
+    }
     
     // blas level 1, rescale: x = a*x
     inline // double * double vector
@@ -1785,6 +2411,18 @@ namespace qbasis {
     void scal(const MKL_INT n, const double a, std::complex<double> *x, const MKL_INT incx) {
         zdscal(&n, &a, x, &incx);
     }
+    inline // float * float vector
+    void scal(const MKL_INT n, const float a, float *x, const MKL_INT incx) {
+        sscal(&n, &a, x, &incx);
+    }
+    inline // complex float * complex float vector
+    void scal(const MKL_INT n, const std::complex<float> a, std::complex<float> *x, const MKL_INT incx) {
+        cscal(&n, &a, x, &incx);
+    }
+    inline // float * complex float vector
+    void scal(const MKL_INT n, const float a, std::complex<float> *x, const MKL_INT incx) {
+        csscal(&n, &a, x, &incx);
+    }
     
     
     // blas level 1, conjugated vector dot vector
@@ -1800,6 +2438,17 @@ namespace qbasis {
         cblas_zdotc_sub(n, x, incx, y, incy, &result);
         return result;
     }
+    inline // float, accumulated in double
+    double dotc(const MKL_INT n, const float *x, const MKL_INT incx, const float *y, const MKL_INT incy) {
+        return dsdot(&n, x, &incx, y, &incy);
+    }
+    inline // complex float
+    std::complex<double> dotc(const MKL_INT n, const std::complex<float> *x, const MKL_INT incx,
+                              const std::complex<float> *y, const MKL_INT incy) {
+        std::complex<float> result(0.0, 0.0);
+        cblas_cdotc_sub(n, x, incx, y, incy, &result);
+        return std::complex<double>(result);
+    }
     
     // blas level 3, matrix matrix product
     inline // double
@@ -1815,6 +2464,19 @@ namespace qbasis {
               const std::complex<double> beta, std::complex<double> *c, const MKL_INT ldc) {
         zgemm(&transa, &transb, &m, &n, &k, &alpha, a, &lda, b, &ldb, &beta, c, &ldc);
     }
+    inline // float
+    void gemm(const char transa, const char transb, const MKL_INT m, const MKL_INT n, const MKL_INT k,
+              const float alpha, const float *a, const MKL_INT lda, const float *b, const MKL_INT ldb,
+              const float beta, float *c, const MKL_INT ldc) {
+        sgemm(&transa, &transb, &m, &n, &k, &alpha, a, &lda, b, &ldb, &beta, c, &ldc);
+    }
+    inline // complex float
+    void gemm(const char transa, const char transb, const MKL_INT m, const MKL_INT n, const MKL_INT k,
+              const std::complex<float> alpha, const std::complex<float> *a, const MKL_INT lda,
+              const std::complex<float> *b, const MKL_INT ldb,
+              const std::complex<float> beta, std::complex<float> *c, const MKL_INT ldc) {
+        cgemm(&transa, &transb, &m, &n, &k, &alpha, a, &lda, b, &ldb, &beta, c, &ldc);
+    }
     
     
     // sparse blas routines
@@ -1866,6 +2528,31 @@ namespace qbasis {
         mkl_zcsrmm(&transa, &m, &n, &k, &alpha, matdescra, val, indx, pntrb, pntre, b, &ldb, &beta, c, &ldc);
     }
     
+    // sparse blas, inspector-executor routines
+    inline // double
+    sparse_status_t mkl_sparse_create_csr(sparse_matrix_t *A, const MKL_INT m, MKL_INT *ia, MKL_INT *ja, double *val) {
+        return mkl_sparse_d_create_csr(A, SPARSE_INDEX_BASE_ZERO, m, m, ia, ia + 1, ja, val);
+    }
+    inline // complex double
+    sparse_status_t mkl_sparse_create_csr(sparse_matrix_t *A, const MKL_INT m, MKL_INT *ia, MKL_INT *ja, std::complex<double> *val) {
+        return mkl_sparse_z_create_csr(A, SPARSE_INDEX_BASE_ZERO, m, m, ia, ia + 1, ja, val);
+    }
+    inline // double
+    sparse_status_t mkl_sparse_mv(const double alpha, const sparse_matrix_t A, const matrix_descr descr,
+                                  const double *x, const double beta, double *y) {
+        return mkl_sparse_d_mv(SPARSE_OPERATION_NON_TRANSPOSE, alpha, A, descr, x, beta, y);
+    }
+    inline // complex double
+    sparse_status_t mkl_sparse_mv(const std::complex<double> alpha, const sparse_matrix_t A, const matrix_descr descr,
+                                  const std::complex<double> *x, const std::complex<double> beta, std::complex<double> *y) {
+        return mkl_sparse_z_mv(SPARSE_OPERATION_NON_TRANSPOSE, alpha, A, descr, x, beta, y);
+    }
+    // matrix type when only the upper triangle stored
+    inline // double
+    sparse_matrix_type_t mkl_sparse_type_upper(const double*) { return SPARSE_MATRIX_TYPE_SYMMETRIC; }
+    inline // complex double
+    sparse_matrix_type_t mkl_sparse_type_upper(const std::complex<double>*) { return SPARSE_MATRIX_TYPE_HERMITIAN; }
+    
     // sparse blas, convert csr to csc
     inline // double
     void mkl_csrcsc(const MKL_INT *job, const MKL_INT n, double *Acsr, MKL_INT *AJ0, MKL_INT *AI0,
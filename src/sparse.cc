@@ -1,5 +1,12 @@
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/crc.hpp>
 #include "qbasis.h"
 
 namespace qbasis {
@@ -78,13 +85,18 @@ namespace qbasis {
     csr_mat<T>::csr_mat(const csr_mat<T> &old) :
         dim(old.dim), nnz(old.nnz), sym(old.sym)
     {
-        if (nnz > 0) {
-            val = new T[nnz];
-            ja  = new MKL_INT[nnz];
+        if (old.mmap_addr != nullptr) {                                          // map the same file again
+            val = nullptr;
+            ja  = nullptr;
+            ia  = nullptr;
+            mmap_open(old.mmap_name);
+        } else if (nnz > 0) {
+            val = old.val == nullptr ? nullptr : new T[nnz];
+            ja  = old.ja == nullptr ? nullptr : new MKL_INT[nnz];
             ia  = new MKL_INT[dim+1];
             for (MKL_INT j = 0; j < nnz; j++) {
-                val[j] = old.val[j];
-                ja[j]  = old.ja[j];
+                if (val != nullptr) val[j] = old.val[j];
+                if (ja != nullptr) ja[j] = old.ja[j];
             }
             for (MKL_INT j = 0; j < dim + 1; j++) {
                 ia[j]  = old.ia[j];
@@ -94,21 +106,57 @@ namespace qbasis {
             ja  = nullptr;
             ia  = nullptr;
         }
+        val_re       = old.val_re;
+        idx_mode     = old.idx_mode;
+        ja32         = old.ja32;
+        ja32_base    = old.ja32_base;
+        ja_delta     = old.ja_delta;
+        ia_delta     = old.ia_delta;
+        sell_C       = old.sell_C;
+        sell_sigma   = old.sell_sigma;
+        spmv_backend = old.spmv_backend;
+        if (nnz > 0) prepare_spmv();
     }
     
     template <typename T>
     csr_mat<T>::csr_mat(csr_mat<T> &&old) noexcept :
         dim(old.dim), nnz(old.nnz), sym(old.sym),
-        val(old.val), ja(old.ja), ia(old.ia)
+        val(old.val), ja(old.ja), ia(old.ia),
+        spmv_backend(old.spmv_backend), sell_C(old.sell_C), sell_sigma(old.sell_sigma),
+        sell_ptr(std::move(old.sell_ptr)), sell_row(std::move(old.sell_row)),
+        sell_col(std::move(old.sell_col)), sell_val(std::move(old.sell_val)),
+        mkl_handle(old.mkl_handle), mkl_descr(old.mkl_descr),
+        idx_mode(old.idx_mode), ja32(std::move(old.ja32)), ja32_base(std::move(old.ja32_base)),
+        ja_delta(std::move(old.ja_delta)), ia_delta(std::move(old.ia_delta)),
+        val_re(std::move(old.val_re)),
+        mmap_addr(old.mmap_addr), mmap_len(old.mmap_len), mmap_name(std::move(old.mmap_name))
     {
         old.val = nullptr;
         old.ja  = nullptr;
         old.ia  = nullptr;
+        old.mkl_handle   = nullptr;
+        old.spmv_backend = 0;
+        old.idx_mode     = 0;
+        old.mmap_addr    = nullptr;
+        old.mmap_len     = 0;
     }
 
     template <typename T>
     void csr_mat<T>::destroy()
     {
+        destroy_spmv();
+        spmv_backend = 0;
+        idx_mode     = 0;
+        ja32.clear();
+        ja32.shrink_to_fit();
+        ja32_base.clear();
+        ja_delta.clear();
+        ja_delta.shrink_to_fit();
+        ia_delta.clear();
+        ia_delta.shrink_to_fit();
+        val_re.clear();
+        val_re.shrink_to_fit();
+        mmap_close();
         if(val != nullptr) {
             delete [] val;
             val = nullptr;
@@ -126,6 +174,8 @@ namespace qbasis {
     template <typename T>
     csr_mat<T>::~csr_mat()
     {
+        destroy_spmv();
+        mmap_close();
         if(val != nullptr) {
             delete [] val;
             val = nullptr;
@@ -146,25 +196,24 @@ namespace qbasis {
         std::cout << "dim = " << dim << std::endl;
         std::cout << "nnz = " << nnz << std::endl;
         std::cout << (sym?"Upper triangle":"Full matrix") << std::endl;
-        for (MKL_INT i = 0; i < nnz; i++) std::cout << std::setw(8) << val[i];
+        std::vector<MKL_INT> cols;
+        std::vector<T> vals;
+        decode_ja(cols);
+        decode_val(vals);
+        for (MKL_INT i = 0; i < nnz; i++) std::cout << std::setw(8) << vals[i];
         std::cout << std::endl;
-        for (MKL_INT i = 0; i < nnz; i++) std::cout << std::setw(8) << ja[i];
+        for (MKL_INT i = 0; i < nnz; i++) std::cout << std::setw(8) << cols[i];
         std::cout << std::endl;
         for (MKL_INT i = 0; i <= dim; i++) std::cout << std::setw(8) << ia[i];
         std::cout << std::endl;
     }
     
     template <typename T>
-    csr_mat<T>::csr_mat(lil_mat<T> &old) : dim(old.dim), nnz(old.nnz), sym(old.sym)
+    csr_mat<T>::csr_mat(lil_mat<T> &old, const bool &check_herm) : dim(old.dim), nnz(old.nnz), sym(old.sym)
     {
         assert(old.nnz>0);
         std::cout << "Converting LIL to CSR: " << std::endl;
-        std::cout << "# of Row and col:      " << dim << std::endl;
-        std::cout << "# of nonzero elements: " << nnz << std::endl;
-        auto capacity= sym ? static_cast<long long>(dim+1) * static_cast<long long>(dim) / 2 : static_cast<long long>(dim) * static_cast<long long>(dim);
-        std::cout << "# of all elements:     " << capacity << std::endl;
-        std::cout << "Sparsity:              " << static_cast<double>(nnz) / capacity << std::endl;
-        std::cout << "Matrix usage:          " << (sym?"Upper triangle":"Full") << std::endl;
+        prt_info();
         val = new T[nnz];
         ja = new MKL_INT[nnz];
         ia = new MKL_INT[dim+1];
@@ -186,39 +235,1025 @@ namespace qbasis {
         ia[dim] = counts;
         old.destroy();
         
-        if (! sym) {                                                             // check if matrix is hermitian
-            for (decltype(dim) row = 0; row < dim; row++) {
-                for (decltype(dim) j = ia[row]; j < ia[row+1]; j++) {            // check for each element in current row
-                    auto col = ja[j];
-                    if(row == col) continue;
-                    auto i = ia[col];
-                    while (i < ia[col+1] && ja[i] != row) i++;                   // until it's conjugate found
-                    if (i == ia[col+1] || std::abs(val[j] - std::conj(val[i])) > sparse_precision) {
-                        std::cout << "Hermitian check failed!!!" << std::endl;
-                        std::cout << "(row, col)    = (" << row << ", " << col << ")" << std::endl;
-                        std::cout << "mat(row, col) = " << val[j] << std::endl;
-                        if (i == ia[col+1]) {
-                            std::cout << "mat(col, row) NOT found!" << std::endl;
+        if (check_herm && ! q_hermitian()) std::exit(99);
+    }
+    
+    // sort the generated row by col (stable, to keep the summation order), merge the duplicates,
+    // and drop the tiny elements (same convention as lil_mat::add)
+    template <typename T>
+    static void csr_row_merge(const MKL_INT &row, const bool &sym, std::vector<std::pair<MKL_INT,T>> &buf)
+    {
+        auto by_col = [](const std::pair<MKL_INT,T> &a, const std::pair<MKL_INT,T> &b) { return a.first < b.first; };
+        decltype(buf.size()) len = 0;
+        for (decltype(buf.size()) k = 0; k < buf.size(); k++) {
+            assert(buf[k].first >= 0);
+            if (sym && buf[k].first < row) continue;
+            if (buf[k].first != row && std::abs(buf[k].second) < sparse_precision) continue;
+            buf[len++] = buf[k];
+        }
+        buf.resize(len);
+        if (buf.size() <= 64) {                                                  // insertion sort, no allocation
+            for (decltype(buf.size()) k = 1; k < buf.size(); k++) {
+                auto temp = buf[k];
+                auto m = k;
+                while (m > 0 && temp.first < buf[m-1].first) {
+                    buf[m] = buf[m-1];
+                    m--;
+                }
+                buf[m] = temp;
+            }
+        } else {
+            std::stable_sort(buf.begin(), buf.end(), by_col);
+        }
+        len = 0;
+        for (decltype(buf.size()) k = 0; k < buf.size(); k++) {
+            if (len > 0 && buf[len-1].first == buf[k].first) {
+                buf[len-1].second += buf[k].second;
+            } else {
+                buf[len++] = buf[k];
+            }
+        }
+        buf.resize(len);
+        len = 0;
+        for (decltype(buf.size()) k = 0; k < buf.size(); k++) {
+            if (buf[k].first != row && std::abs(buf[k].second) < sparse_precision) continue;
+            buf[len++] = buf[k];
+        }
+        buf.resize(len);
+    }
+    
+    template <typename T>
+    csr_mat<T>::csr_mat(const MKL_INT &n, const bool &sym_,
+                        const std::function<void(const MKL_INT&, std::vector<std::pair<MKL_INT,T>>&)> &gen,
+                        const bool &check_herm, const std::string &file) :
+        dim(n), nnz(0), sym(sym_), val(nullptr), ja(nullptr)
+    {
+        assert(dim > 0);
+        std::vector<std::vector<std::pair<MKL_INT,T>>> bufs(omp_get_max_threads());
+        auto build_row = [&](const MKL_INT &row, std::vector<std::pair<MKL_INT,T>> &buf) {
+            buf.clear();
+            buf.emplace_back(row, static_cast<T>(0.0));                          // at least storing the diagonal element
+            gen(row, buf);
+            csr_row_merge(row, sym, buf);
+        };
+        ia = new MKL_INT[dim+1];
+        ia[0] = 0;
+        
+        // pass 1: count
+        #pragma omp parallel for schedule(dynamic,256)
+        for (MKL_INT i = 0; i < dim; i++) {
+            auto &buf = bufs[omp_get_thread_num()];
+            build_row(i, buf);
+            ia[i+1] = static_cast<MKL_INT>(buf.size());
+        }
+        for (MKL_INT i = 0; i < dim; i++) ia[i+1] += ia[i];
+        nnz = ia[dim];
+        
+        // pass 2: fill, in blocks of rows (a single block when kept in memory)
+        std::ofstream fout;
+        std::vector<MKL_INT> ja_blk;
+        std::vector<T> val_blk;
+        uint64_t off_ja = 0, off_val = 0;
+        MKL_INT blk_nnz_max = nnz;
+        if (file.empty()) {
+            val = new T[nnz];
+            ja  = new MKL_INT[nnz];
+        } else {
+            uint64_t off_ia = 4096;
+            off_ja  = (off_ia + sizeof(MKL_INT) * static_cast<uint64_t>(dim + 1) + 4095) / 4096 * 4096;
+            off_val = (off_ja + sizeof(MKL_INT) * static_cast<uint64_t>(nnz) + 4095) / 4096 * 4096;
+            fout.open(file, std::ios::out | std::ios::binary | std::ios::trunc);
+            assert(fout.is_open());
+            char magic[8] = "QBCSR01";
+            uint64_t head[8] = {static_cast<uint64_t>(dim), static_cast<uint64_t>(nnz), static_cast<uint64_t>(sym),
+                                sizeof(T), sizeof(MKL_INT), off_ia, off_ja, off_val};
+            fout.write(magic, sizeof(magic));
+            fout.write(reinterpret_cast<const char*>(head), sizeof(head));
+            fout.seekp(off_ia);
+            fout.write(reinterpret_cast<const char*>(ia), sizeof(MKL_INT) * (dim + 1));
+            blk_nnz_max = std::min(nnz, static_cast<MKL_INT>(1) << 24);
+            ja_blk.resize(blk_nnz_max);
+            val_blk.resize(blk_nnz_max);
+        }
+        MKL_INT row_begin = 0;
+        while (row_begin < dim) {
+            MKL_INT row_end = row_begin + 1;
+            while (row_end < dim && ia[row_end+1] - ia[row_begin] <= blk_nnz_max) row_end++;
+            MKL_INT base   = file.empty() ? 0 : ia[row_begin];
+            MKL_INT *ja_out = file.empty() ? ja : ja_blk.data();
+            T *val_out      = file.empty() ? val : val_blk.data();
+            if (! file.empty() && ia[row_end] - base > blk_nnz_max) {            // a single long row
+                ja_blk.resize(ia[row_end] - base);
+                val_blk.resize(ia[row_end] - base);
+                ja_out  = ja_blk.data();
+                val_out = val_blk.data();
+            }
+            #pragma omp parallel for schedule(dynamic,256)
+            for (MKL_INT i = row_begin; i < row_end; i++) {
+                auto &buf = bufs[omp_get_thread_num()];
+                build_row(i, buf);
+                assert(static_cast<MKL_INT>(buf.size()) == ia[i+1] - ia[i]);
+                for (MKL_INT k = 0; k < ia[i+1] - ia[i]; k++) {
+                    ja_out[ia[i] - base + k]  = buf[k].first;
+                    val_out[ia[i] - base + k] = buf[k].second;
+                }
+            }
+            if (! file.empty()) {
+                fout.seekp(off_ja + sizeof(MKL_INT) * static_cast<uint64_t>(base));
+                fout.write(reinterpret_cast<const char*>(ja_out), sizeof(MKL_INT) * (ia[row_end] - base));
+                fout.seekp(off_val + sizeof(T) * static_cast<uint64_t>(base));
+                fout.write(reinterpret_cast<const char*>(val_out), sizeof(T) * (ia[row_end] - base));
+            }
+            row_begin = row_end;
+        }
+        if (! file.empty()) {
+            fout.close();
+            assert(! fout.fail());
+            delete [] ia;
+            ia = nullptr;
+            mmap_open(file);
+        }
+        
+        std::cout << "CSR matrix built in two passes: " << std::endl;
+        prt_info();
+        if (check_herm && ! q_hermitian()) std::exit(99);
+    }
+    
+    template <typename T>
+    void csr_mat<T>::mmap_open(const std::string &filename)
+    {
+        destroy();
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) std::cout << "Cannot open " << filename << std::endl;
+        assert(fd >= 0);
+        struct stat st;
+        fstat(fd, &st);
+        mmap_len  = static_cast<uint64_t>(st.st_size);
+        mmap_addr = mmap(nullptr, mmap_len, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        assert(mmap_addr != MAP_FAILED);
+        char *base = static_cast<char*>(mmap_addr);
+        assert(mmap_len >= 4096 && std::strncmp(base, "QBCSR01", 8) == 0);
+        uint64_t head[8];
+        std::memcpy(head, base + 8, sizeof(head));
+        assert(head[3] == sizeof(T) && head[4] == sizeof(MKL_INT));
+        assert(mmap_len >= head[7] + sizeof(T) * head[1]);
+        dim = static_cast<MKL_INT>(head[0]);
+        nnz = static_cast<MKL_INT>(head[1]);
+        sym = (head[2] != 0);
+        ia  = reinterpret_cast<MKL_INT*>(base + head[5]);
+        ja  = reinterpret_cast<MKL_INT*>(base + head[6]);
+        val = reinterpret_cast<T*>(base + head[7]);
+        madvise(mmap_addr, mmap_len, MADV_SEQUENTIAL);                           // streamed row by row in MultMv2
+        madvise(base + head[5], sizeof(MKL_INT) * (dim + 1), MADV_WILLNEED);
+        mmap_name    = filename;
+        spmv_backend = 1;
+        std::cout << "CSR matrix mapped from " << filename << " (" << mmap_len << " bytes)" << std::endl;
+    }
+    
+    template <typename T>
+    void csr_mat<T>::mmap_close()
+    {
+        if (mmap_addr == nullptr) return;
+        munmap(mmap_addr, mmap_len);
+        mmap_addr = nullptr;
+        mmap_len  = 0;
+        mmap_name.clear();
+        val = nullptr;
+        ja  = nullptr;
+        ia  = nullptr;
+    }
+    
+    template <typename T>
+    int csr_mat<T>::save(const std::string &filename) const
+    {
+        assert(dim > 0 && ia != nullptr);
+        std::vector<MKL_INT> cols;
+        std::vector<T> vals;
+        const MKL_INT *ja_out = ja;
+        const T *val_out      = val;
+        if (idx_mode != 0) {
+            decode_ja(cols);
+            ja_out = cols.data();
+        }
+        if (q_real_values()) {
+            decode_val(vals);
+            val_out = vals.data();
+        }
+        
+        const uint64_t buffer_each_size = 1024*1024;                             // 1M per chunk
+        uint64_t off_ia  = 4096;
+        uint64_t off_ja  = (off_ia + sizeof(MKL_INT) * static_cast<uint64_t>(dim + 1) + 4095) / 4096 * 4096;
+        uint64_t off_val = (off_ja + sizeof(MKL_INT) * static_cast<uint64_t>(nnz) + 4095) / 4096 * 4096;
+        uint64_t off_crc = (off_val + sizeof(T) * static_cast<uint64_t>(nnz) + 7) / 8 * 8;
+        std::string filename_tmp = filename + ".tmp";                            // renamed in the end, not to disturb existing mappings
+        std::ofstream fout(filename_tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (! fout.is_open()) return 1;
+        
+        std::vector<uint32_t> checksums;
+        boost::crc_32_type res_crc;
+        char magic[8] = "QBCSR01";
+        uint64_t head[10] = {static_cast<uint64_t>(dim), static_cast<uint64_t>(nnz), static_cast<uint64_t>(sym),
+                             sizeof(T), sizeof(MKL_INT), off_ia, off_ja, off_val, buffer_each_size, off_crc};
+        fout.write(magic, sizeof(magic));
+        fout.write(reinterpret_cast<const char*>(head), sizeof(head));
+        res_crc.process_bytes(magic, sizeof(magic));
+        res_crc.process_bytes(head, sizeof(head));
+        checksums.push_back(res_crc.checksum());
+        auto write_section = [&](const uint64_t &offset, const char *pos, const uint64_t &total_size) {
+            fout.seekp(offset);
+            for (uint64_t done = 0; done < total_size; done += buffer_each_size) {
+                uint64_t size_chunk = std::min(buffer_each_size, total_size - done);
+                fout.write(pos + done, size_chunk);
+                res_crc.reset();
+                res_crc.process_bytes(pos + done, size_chunk);
+                checksums.push_back(res_crc.checksum());
+            }
+        };
+        write_section(off_ia,  reinterpret_cast<const char*>(ia),      sizeof(MKL_INT) * static_cast<uint64_t>(dim + 1));
+        write_section(off_ja,  reinterpret_cast<const char*>(ja_out),  sizeof(MKL_INT) * static_cast<uint64_t>(nnz));
+        write_section(off_val, reinterpret_cast<const char*>(val_out), sizeof(T) * static_cast<uint64_t>(nnz));
+        
+        uint64_t n_checksums = checksums.size();
+        fout.seekp(off_crc);
+        fout.write(reinterpret_cast<const char*>(&n_checksums), sizeof(n_checksums));
+        fout.write(reinterpret_cast<const char*>(checksums.data()), sizeof(uint32_t) * n_checksums);
+        fout.close();
+        if (fout.fail()) return 1;
+        fs::rename(fs::path(filename_tmp), fs::path(filename));
+        std::cout << "CSR matrix saved to " << filename << std::endl;
+        return 0;
+    }
+    
+    template <typename T>
+    int csr_mat<T>::load(const std::string &filename, const bool &mapped)
+    {
+        if (! fs::exists(fs::path(filename))) return 1;
+        std::ifstream fin(filename, std::ios::in | std::ios::binary);
+        char magic[8];
+        uint64_t head[10];
+        fin.read(magic, sizeof(magic));
+        fin.read(reinterpret_cast<char*>(head), sizeof(head));
+        if (! fin || std::strncmp(magic, "QBCSR01", 8) != 0 ||
+            head[3] != sizeof(T) || head[4] != sizeof(MKL_INT) || head[8] == 0 || head[9] == 0) {
+            return 1;                                                            // incompatible, or written without checksums
+        }
+        uint64_t dim_ = head[0], nnz_ = head[1], buffer_each_size = head[8];
+        uint64_t size_ia  = sizeof(MKL_INT) * (dim_ + 1);
+        uint64_t size_ja  = sizeof(MKL_INT) * nnz_;
+        uint64_t size_val = sizeof(T) * nnz_;
+        auto num_chunks = [&](const uint64_t &total_size) { return (total_size + buffer_each_size - 1) / buffer_each_size; };
+        uint64_t n_checksums = 1 + num_chunks(size_ia) + num_chunks(size_ja) + num_chunks(size_val);
+        uint64_t filesize_ideal = head[9] + sizeof(uint64_t) + sizeof(uint32_t) * n_checksums;
+        if (fs::file_size(fs::path(filename)) != filesize_ideal) return 1;
+        
+        uint64_t n_checksums_check;
+        std::vector<uint32_t> checksums(n_checksums);
+        fin.seekg(head[9]);
+        fin.read(reinterpret_cast<char*>(&n_checksums_check), sizeof(n_checksums_check));
+        fin.read(reinterpret_cast<char*>(checksums.data()), sizeof(uint32_t) * n_checksums);
+        if (! fin || n_checksums_check != n_checksums) return 1;
+        boost::crc_32_type res_crc;
+        res_crc.process_bytes(magic, sizeof(magic));
+        res_crc.process_bytes(head, sizeof(head));
+        if (res_crc.checksum() != checksums[0]) return 1;
+        
+        // read (or only verify, if mapped) chunk by chunk
+        std::vector<char> buffer(mapped ? buffer_each_size : 0);
+        uint64_t cnt = 1;
+        auto read_section = [&](const uint64_t &offset, char *pos, const uint64_t &total_size) {
+            fin.seekg(offset);
+            for (uint64_t done = 0; done < total_size; done += buffer_each_size) {
+                uint64_t size_chunk = std::min(buffer_each_size, total_size - done);
+                char *dest = mapped ? buffer.data() : pos + done;
+                fin.read(dest, size_chunk);
+                res_crc.reset();
+                res_crc.process_bytes(dest, size_chunk);
+                if (! fin || res_crc.checksum() != checksums[cnt++]) return false;
+            }
+            return true;
+        };
+        MKL_INT *ia_new  = mapped ? nullptr : new MKL_INT[dim_ + 1];
+        MKL_INT *ja_new  = mapped ? nullptr : new MKL_INT[nnz_];
+        T       *val_new = mapped ? nullptr : new T[nnz_];
+        bool ok = read_section(head[5], reinterpret_cast<char*>(ia_new), size_ia) &&
+                  read_section(head[6], reinterpret_cast<char*>(ja_new), size_ja) &&
+                  read_section(head[7], reinterpret_cast<char*>(val_new), size_val);
+        fin.close();
+        if (! ok) {
+            std::cout << "Checksum mismatch in " << filename << std::endl;
+            if (! mapped) {
+                delete [] ia_new;
+                delete [] ja_new;
+                delete [] val_new;
+            }
+            return 1;
+        }
+        
+        if (mapped) {
+            mmap_open(filename);
+        } else {
+            destroy();
+            dim = static_cast<MKL_INT>(dim_);
+            nnz = static_cast<MKL_INT>(nnz_);
+            sym = (head[2] != 0);
+            ia  = ia_new;
+            ja  = ja_new;
+            val = val_new;
+            std::cout << "CSR matrix loaded from " << filename << std::endl;
+        }
+        prt_info();
+        return 0;
+    }
+    
+    template <typename T>
+        void csr_mat<T>::prt_info() const
+    {
+        std::cout << "# of Row and col:      " << dim << std::endl;
+        std::cout << "# of nonzero elements: " << nnz << std::endl;
+        auto capacity= sym ? static_cast<long long>(dim+1) * static_cast<long long>(dim) / 2 : static_cast<long long>(dim) * static_cast<long long>(dim);
+        std::cout << "# of all elements:     " << capacity << std::endl;
+        std::cout << "Sparsity:              " << static_cast<double>(nnz) / capacity << std::endl;
+        std::cout << "Matrix usage:          " << (sym?"Upper triangle":"Full") << std::endl;
+    }
+    
+    // cursors over the columns of one row, for each storage of the column indices
+    struct cols_plain {
+        const MKL_INT *p;
+        MKL_INT next() { return *p++; }
+    };
+    
+    struct cols_idx32 {
+        const uint32_t *p;
+        MKL_INT base;
+        MKL_INT next() { return base + static_cast<MKL_INT>(*p++); }
+    };
+    
+    struct cols_delta {
+        const uint8_t *p;
+        MKL_INT col;                                                             // starts from the row index
+        bool first;
+        MKL_INT next() {
+            uint64_t gap = 0;
+            int shift = 0;
+            while (*p & 0x80) {
+                gap |= static_cast<uint64_t>(*p++ & 0x7f) << shift;
+                shift += 7;
+            }
+            gap |= static_cast<uint64_t>(*p++) << shift;
+            if (first) {                                                         // zigzag: the first col may be left to the diagonal
+                first = false;
+                col += (gap & 1) ? -static_cast<MKL_INT>(gap >> 1) - 1 : static_cast<MKL_INT>(gap >> 1);
+            } else {
+                col += static_cast<MKL_INT>(gap);
+            }
+            return col;
+        }
+    };
+    
+    struct rows_plain {
+        const MKL_INT *ja, *ia;
+        cols_plain operator()(const MKL_INT &i) const { return cols_plain{ja + ia[i]}; }
+    };
+    
+    struct rows_idx32 {
+        const uint32_t *ja32;
+        const MKL_INT *base, *ia;
+        MKL_INT block;
+        cols_idx32 operator()(const MKL_INT &i) const { return cols_idx32{ja32 + ia[i], base[i / block]}; }
+    };
+    
+    struct rows_delta {
+        const uint8_t *bytes;
+        const uint64_t *ia_delta;
+        cols_delta operator()(const MKL_INT &i) const { return cols_delta{bytes + ia_delta[i], i, true}; }
+    };
+    
+    static void varint_push(uint64_t gap, std::vector<uint8_t> &bytes, uint64_t &pos)
+    {
+        while (gap >= 0x80) {
+            bytes[pos++] = static_cast<uint8_t>(gap & 0x7f) | 0x80;
+            gap >>= 7;
+        }
+        bytes[pos++] = static_cast<uint8_t>(gap);
+    }
+    
+    static uint64_t varint_len(uint64_t gap)
+    {
+        uint64_t len = 1;
+        while (gap >= 0x80) {
+            gap >>= 7;
+            len++;
+        }
+        return len;
+    }
+    
+    static uint64_t delta_gap(const MKL_INT *ja, const MKL_INT &row, const MKL_INT &p, const MKL_INT &p_first)
+    {
+        if (p > p_first) return static_cast<uint64_t>(ja[p] - ja[p-1]);
+        int64_t d = static_cast<int64_t>(ja[p]) - static_cast<int64_t>(row);
+        return d >= 0 ? static_cast<uint64_t>(d) << 1 : (static_cast<uint64_t>(-d - 1) << 1) | 1;
+    }
+    
+    template <typename Rows>
+    static void decode_ja_rows(const MKL_INT &dim, const MKL_INT *ia, const Rows &rows, MKL_INT *cols)
+    {
+        #pragma omp parallel for schedule(dynamic,256)
+        for (MKL_INT i = 0; i < dim; i++) {
+            auto c = rows(i);
+            for (MKL_INT p = ia[i]; p < ia[i+1]; p++) cols[p] = c.next();
+        }
+    }
+    
+    template <typename T>
+    void csr_mat<T>::MultMv2(const T *x, T *y) const
+    {
+        std::cout << "*" << std::flush;
+        assert(ia != nullptr && (ja != nullptr || idx_mode != 0) && (val != nullptr || ! val_re.empty()));
+        T one  = static_cast<T>(1.0);
+        if (spmv_backend == 1) {
+            if (val == nullptr) {                                                // real matrix, complex vectors
+                MultMv2_native(x, y, val_re.data());
+            } else {
+                MultMv2_native(x, y, val);
+            }
+        } else if (spmv_backend == 2) {
+            MultMv2_sell(x, y);
+        } else if (spmv_backend == 3) {
+            mkl_sparse_mv(one, mkl_handle, mkl_descr, x, one, y);
+        } else {
+            char matdescra[7] = "HUNC";
+            if (! sym) matdescra[0] = 'G';
+            mkl_csrmv('n', dim, dim, one, matdescra,
+                      val, ja, ia, ia + 1, x, one, y);
+        }
+    }
+    
+    template <typename T>
+    double csr_mat<T>::lanczos_step(const T *v, T *w, const double &b, double &a) const
+    {
+        if (spmv_backend != 1) return lanczos_step_generic(dim, *this, v, w, b, a);
+        std::cout << "*" << std::flush;
+        assert(ia != nullptr && (ja != nullptr || idx_mode != 0) && (val != nullptr || ! val_re.empty()));
+        double dots[2];
+        if (val == nullptr) {
+            MultMv2_native(v, w, val_re.data(), -b, dots);
+        } else {
+            MultMv2_native(v, w, val, -b, dots);
+        }
+        a = dots[0];
+        return dots[1];
+    }
+    
+    template <typename T>
+    void csr_mat<T>::MultMv2(const single_t *x, single_t *y) const
+    {
+        std::cout << "*" << std::flush;
+        assert(ia != nullptr && (ja != nullptr || idx_mode != 0) && (val != nullptr || ! val_re.empty()));
+        if (val == nullptr) {
+            MultMv2_native(x, y, val_re.data());
+        } else {
+            MultMv2_native(x, y, val);
+        }
+    }
+    
+    template <typename T>
+    double csr_mat<T>::lanczos_step(const single_t *v, single_t *w, const double &b, double &a) const
+    {
+        std::cout << "*" << std::flush;
+        assert(ia != nullptr && (ja != nullptr || idx_mode != 0) && (val != nullptr || ! val_re.empty()));
+        double dots[2];
+        if (val == nullptr) {
+            MultMv2_native(v, w, val_re.data(), -b, dots);
+        } else {
+            MultMv2_native(v, w, val, -b, dots);
+        }
+        a = dots[0];
+        return dots[1];
+    }
+    
+    template <typename T> template <typename X, typename V>
+    void csr_mat<T>::MultMv2_native(const X *x, X *y, const V *v, const double &beta, double *dots) const
+    {
+        if (idx_mode == 1) {
+            MultMv2_native(x, y, v, rows_idx32{ja32.data(), ja32_base.data(), ia, ja32_block}, beta, dots);
+        } else if (idx_mode == 2) {
+            MultMv2_native(x, y, v, rows_delta{ja_delta.data(), ia_delta.data()}, beta, dots);
+        } else {
+            MultMv2_native(x, y, v, rows_plain{ja, ia}, beta, dots);
+        }
+    }
+    
+    template <typename T> template <typename X, typename V, typename Rows>
+    void csr_mat<T>::MultMv2_native(const X *x, X *y, const V *v, const Rows &rows,
+                                    const double &beta, double *dots) const
+    {
+        double dot = 0.0, nrm = 0.0;                                             // Re(x, y) and (y, y) of the result
+        if (! sym) {
+            #pragma omp parallel for schedule(dynamic,256) reduction(+:dot,nrm)
+            for (MKL_INT i = 0; i < dim; i++) {
+                auto c = rows(i);
+                T sum = static_cast<T>(0.0);
+                for (MKL_INT p = ia[i]; p < ia[i+1]; p++) sum += v[p] * static_cast<T>(x[c.next()]);
+                T yi = beta * static_cast<T>(y[i]) + sum;
+                y[i] = static_cast<X>(yi);
+                if (dots != nullptr) {
+                    dot += std::real(conjugate(static_cast<T>(x[i])) * yi);
+                    nrm += std::norm(yi);
+                }
+            }
+            if (dots != nullptr) {
+                dots[0] = dot;
+                dots[1] = nrm;
+            }
+            return;
+        }
+        
+        // upper triangle: rows are cut into one contiguous block per thread, with balanced nnz.
+        // block b owns y[row_b : row_{b+1}], and is the only one writing there directly;
+        // the scatter of the transposed part into higher blocks (the lower triangle never scatters downwards)
+        // goes to a private buffer covering only [row_{b+1}, max col of block b], reduced afterwards
+        // (the buffers are always of type T, only the direct writes into y rounded to X)
+        prepare_sym_part(rows, 1);
+        int num_blocks = static_cast<int>(sym_span.size());
+        
+        #pragma omp parallel
+        {
+            int nthreads = omp_get_num_threads();
+            for (int b = omp_get_thread_num(); b < num_blocks; b += nthreads) {
+                auto &yp = y_private[b];
+                MKL_INT row_end = sym_part[b+1];
+                for (decltype(yp.size()) j = 0; j < yp.size(); j++) yp[j] = static_cast<T>(0.0);
+                if (beta != 1.0) {                                               // rows of the block written only by this thread
+                    for (MKL_INT i = sym_part[b]; i < row_end; i++) y[i] = static_cast<X>(beta * static_cast<T>(y[i]));
+                }
+                for (MKL_INT i = sym_part[b]; i < row_end; i++) {
+                    auto c = rows(i);
+                    T xi = static_cast<T>(x[i]);
+                    T sum = static_cast<T>(0.0);
+                    for (MKL_INT p = ia[i]; p < ia[i+1]; p++) {
+                        auto j = c.next();
+                        sum += v[p] * static_cast<T>(x[j]);
+                        if (j == i) continue;
+                        if (j < row_end) {
+                            y[j] = static_cast<X>(static_cast<T>(y[j]) + conjugate(v[p]) * xi);
                         } else {
-                            std::cout << "mat(col, row) = " << val[i] << std::endl;
+                            yp[j - row_end] += conjugate(v[p]) * xi;
                         }
-                        std::exit(99);
                     }
+                    y[i] = static_cast<X>(static_cast<T>(y[i]) + sum);
+                }
+            }
+            #pragma omp barrier
+            #pragma omp for schedule(dynamic,256) reduction(+:dot,nrm)
+            for (MKL_INT j = 0; j < dim; j++) {
+                T yj = static_cast<T>(y[j]);
+                bool touched = false;
+                for (int b = 0; b < num_blocks && sym_part[b+1] <= j; b++) {
+                    auto k = j - sym_part[b+1];
+                    if (k < sym_span[b]) {
+                        yj += y_private[b][k];
+                        touched = true;
+                    }
+                }
+                if (touched) y[j] = static_cast<X>(yj);
+                if (dots != nullptr) {                                           // y[j] final
+                    dot += std::real(conjugate(static_cast<T>(x[j])) * yj);
+                    nrm += std::norm(yj);
+                }
+            }
+        }
+        if (dots != nullptr) {
+            dots[0] = dot;
+            dots[1] = nrm;
+        }
+    }
+    
+    template <typename T> template <typename Rows>
+    void csr_mat<T>::prepare_sym_part(const Rows &rows, const MKL_INT &k) const
+    {
+        int num_blocks = omp_get_max_threads();
+        if (static_cast<int>(sym_part.size()) != num_blocks + 1) {
+            sym_part.assign(num_blocks + 1, dim);
+            sym_part[0] = 0;
+            for (int b = 1; b < num_blocks; b++) {
+                auto target = static_cast<MKL_INT>(static_cast<double>(nnz) * b / num_blocks);
+                sym_part[b] = std::max(sym_part[b-1],
+                                       static_cast<MKL_INT>(std::lower_bound(ia, ia + dim, target) - ia));
+            }
+            sym_span.assign(num_blocks, 0);
+            for (int b = 0; b < num_blocks; b++) {
+                MKL_INT col_max = sym_part[b+1] - 1;
+                for (MKL_INT i = sym_part[b]; i < sym_part[b+1]; i++) {
+                    auto c = rows(i);
+                    for (MKL_INT p = ia[i]; p < ia[i+1]; p++) col_max = std::max(col_max, c.next());
                 }
+                sym_span[b] = col_max + 1 - sym_part[b+1];
             }
+            y_private.assign(num_blocks, std::vector<T>());
+        }
+        for (int b = 0; b < num_blocks; b++) {
+            auto len = static_cast<uint64_t>(sym_span[b]) * static_cast<uint64_t>(k);
+            if (y_private[b].size() != len) y_private[b].resize(len);
         }
     }
     
     template <typename T>
-    void csr_mat<T>::MultMv2(const T *x, T *y) const
+    void csr_mat<T>::MultMm2(const T *X, T *Y, const MKL_INT &k) const
     {
         std::cout << "*" << std::flush;
-        assert(val != nullptr && ja != nullptr && ia != nullptr);
-        char matdescra[7] = "HUNC";
-        if (! sym) matdescra[0] = 'G';
-        T one  = static_cast<T>(1.0);
-        mkl_csrmv('n', dim, dim, one, matdescra,
-                  val, ja, ia, ia + 1, x, one, y);
+        assert(ia != nullptr && (ja != nullptr || idx_mode != 0) && (val != nullptr || ! val_re.empty()) && k > 0);
+        if (val == nullptr) {                                                    // real matrix, complex vectors
+            MultMm2_native(X, Y, k, val_re.data());
+        } else {
+            MultMm2_native(X, Y, k, val);
+        }
+    }
+    
+    template <typename T>
+    void csr_mat<T>::MultMm(const T *X, T *Y, const MKL_INT &k) const
+    {
+        T zero = static_cast<T>(0.0);
+        auto len = static_cast<uint64_t>(dim) * static_cast<uint64_t>(k);
+        for (uint64_t j = 0; j < len; j++) Y[j] = zero;
+        MultMm2(X, Y, k);
+    }
+    
+    template <typename T> template <typename V>
+    void csr_mat<T>::MultMm2_native(const T *X, T *Y, const MKL_INT &k, const V *v) const
+    {
+        if (idx_mode == 1) {
+            MultMm2_native(X, Y, k, v, rows_idx32{ja32.data(), ja32_base.data(), ia, ja32_block});
+        } else if (idx_mode == 2) {
+            MultMm2_native(X, Y, k, v, rows_delta{ja_delta.data(), ia_delta.data()});
+        } else {
+            MultMm2_native(X, Y, k, v, rows_plain{ja, ia});
+        }
+    }
+    
+    // same as MultMv2_native, each matrix element (and column index) read once for all the k vectors
+    template <typename T> template <typename V, typename Rows>
+    void csr_mat<T>::MultMm2_native(const T *X, T *Y, const MKL_INT &k, const V *v, const Rows &rows) const
+    {
+        const uint64_t ld = static_cast<uint64_t>(k);
+        if (! sym) {
+            #pragma omp parallel for schedule(dynamic,256)
+            for (MKL_INT i = 0; i < dim; i++) {
+                auto c = rows(i);
+                T *yi = Y + ld * i;
+                for (MKL_INT p = ia[i]; p < ia[i+1]; p++) {
+                    const T *xj = X + ld * c.next();
+                    for (MKL_INT s = 0; s < k; s++) yi[s] += v[p] * xj[s];
+                }
+            }
+            return;
+        }
+        
+        prepare_sym_part(rows, k);
+        int num_blocks = static_cast<int>(sym_span.size());
+        #pragma omp parallel
+        {
+            int nthreads = omp_get_num_threads();
+            for (int b = omp_get_thread_num(); b < num_blocks; b += nthreads) {
+                auto &yp = y_private[b];
+                MKL_INT row_end = sym_part[b+1];
+                for (decltype(yp.size()) j = 0; j < yp.size(); j++) yp[j] = static_cast<T>(0.0);
+                for (MKL_INT i = sym_part[b]; i < row_end; i++) {
+                    auto c = rows(i);
+                    T *yi = Y + ld * i;
+                    const T *xi = X + ld * i;
+                    for (MKL_INT p = ia[i]; p < ia[i+1]; p++) {
+                        auto j = c.next();
+                        const T *xj = X + ld * j;
+                        for (MKL_INT s = 0; s < k; s++) yi[s] += v[p] * xj[s];
+                        if (j == i) continue;
+                        T *yj = (j < row_end) ? Y + ld * j : yp.data() + ld * (j - row_end);
+                        auto v_conj = conjugate(v[p]);
+                        for (MKL_INT s = 0; s < k; s++) yj[s] += v_conj * xi[s];
+                    }
+                }
+            }
+            #pragma omp barrier
+            #pragma omp for schedule(dynamic,256)
+            for (MKL_INT j = 0; j < dim; j++) {
+                for (int b = 0; b < num_blocks && sym_part[b+1] <= j; b++) {
+                    auto pos = j - sym_part[b+1];
+                    if (pos >= sym_span[b]) continue;
+                    for (MKL_INT s = 0; s < k; s++) Y[ld * j + s] += y_private[b][ld * pos + s];
+                }
+            }
+        }
+    }
+    
+    template <typename T>
+    void csr_mat<T>::MultMv2_sell(const T *x, T *y) const
+    {
+        const MKL_INT C = sell_C;
+        MKL_INT n_chunk = static_cast<MKL_INT>(sell_ptr.size()) - 1;
+        #pragma omp parallel for schedule(dynamic,32)
+        for (MKL_INT c = 0; c < n_chunk; c++) {
+            T sum[32];
+            for (MKL_INT s = 0; s < C; s++) sum[s] = static_cast<T>(0.0);
+            for (MKL_INT pos = sell_ptr[c]; pos < sell_ptr[c+1]; pos += C) {
+                for (MKL_INT s = 0; s < C; s++) sum[s] += sell_val[pos + s] * x[sell_col[pos + s]];
+            }
+            for (MKL_INT s = 0; s < C; s++) {
+                auto row = sell_row[c * C + s];
+                if (row >= 0) y[row] += sum[s];
+            }
+        }
+    }
+    
+    template <typename T>
+    void csr_mat<T>::set_spmv(const std::string &backend, const MKL_INT &C, const MKL_INT &sigma)
+    {
+        assert(C > 0 && C <= 32 && sigma >= C && sigma % C == 0);
+        if (backend == "sell" && mmap_addr != nullptr) {
+            std::cout << "sell layout would be built in memory, keep the " << spmv() << " backend for file-backed matrix" << std::endl;
+            return;
+        }
+        if (backend != "native" && idx_mode != 0) {
+            std::cout << "spmv backend " << backend << " needs plain column indices, restoring them" << std::endl;
+            set_index("mkl_int");
+        }
+        if (backend != "native" && val == nullptr) {
+            std::cout << "spmv backend " << backend << " needs complex values, restoring them" << std::endl;
+            use_complex_values();
+        }
+        destroy_spmv();
+        sell_C     = C;
+        sell_sigma = sigma;
+        if (backend == "mkl_csrmv") {
+            spmv_backend = 0;
+        } else if (backend == "native") {
+            spmv_backend = 1;
+        } else if (backend == "sell") {
+            spmv_backend = 2;
+        } else if (backend == "mkl_ie") {
+            spmv_backend = 3;
+        } else {
+            std::cout << "spmv backend " << backend << " not recognized!" << std::endl;
+            assert(false);
+        }
+        prepare_spmv();
+    }
+    
+    template <typename T>
+    std::string csr_mat<T>::spmv() const
+    {
+        const std::string names[4] = {"mkl_csrmv", "native", "sell", "mkl_ie"};
+        return names[spmv_backend];
+    }
+    
+    template <typename T>
+    void csr_mat<T>::prepare_spmv()
+    {
+        assert(ia != nullptr && ((ja != nullptr && val != nullptr) || spmv_backend == 1));
+        if (spmv_backend == 2) {
+            // row lengths of the full matrix
+            std::vector<MKL_INT> len(dim);
+            for (MKL_INT i = 0; i < dim; i++) len[i] = ia[i+1] - ia[i];
+            if (sym) {
+                for (MKL_INT i = 0; i < dim; i++) {
+                    for (MKL_INT p = ia[i]; p < ia[i+1]; p++) {
+                        if (ja[p] != i) len[ja[p]]++;
+                    }
+                }
+            }
+            // sort by length (descending) inside each window of sigma rows
+            std::vector<MKL_INT> perm(dim);
+            for (MKL_INT i = 0; i < dim; i++) perm[i] = i;
+            for (MKL_INT w = 0; w < dim; w += sell_sigma) {
+                auto w_end = std::min(w + sell_sigma, dim);
+                std::stable_sort(perm.begin() + w, perm.begin() + w_end,
+                                 [&len](const MKL_INT &a, const MKL_INT &b) { return len[a] > len[b]; });
+            }
+            MKL_INT n_chunk = (dim + sell_C - 1) / sell_C;
+            sell_ptr.assign(n_chunk + 1, 0);
+            sell_row.assign(n_chunk * sell_C, -1);
+            for (MKL_INT c = 0; c < n_chunk; c++) {
+                MKL_INT width = 0;
+                for (MKL_INT s = 0; s < sell_C && c * sell_C + s < dim; s++) {
+                    sell_row[c * sell_C + s] = perm[c * sell_C + s];
+                    width = std::max(width, len[perm[c * sell_C + s]]);
+                }
+                sell_ptr[c+1] = sell_ptr[c] + width * sell_C;
+            }
+            
+            // fill, the padding points to the row itself with zero value
+            std::vector<MKL_INT> slot(dim), cnt(dim, 0);
+            for (MKL_INT k = 0; k < dim; k++) slot[perm[k]] = k;
+            sell_col.assign(sell_ptr[n_chunk], 0);
+            sell_val.assign(sell_ptr[n_chunk], static_cast<T>(0.0));
+            auto put = [&](const MKL_INT &row, const MKL_INT &col, const T &v) {
+                auto pos = sell_ptr[slot[row] / sell_C] + (cnt[row]++) * sell_C + slot[row] % sell_C;
+                sell_col[pos] = col;
+                sell_val[pos] = v;
+            };
+            for (MKL_INT i = 0; i < dim; i++) {
+                for (MKL_INT p = ia[i]; p < ia[i+1]; p++) {
+                    put(i, ja[p], val[p]);
+                    if (sym && ja[p] != i) put(ja[p], i, conjugate(val[p]));
+                }
+            }
+            for (MKL_INT c = 0; c < n_chunk; c++) {
+                for (MKL_INT s = 0; s < sell_C; s++) {
+                    auto row = sell_row[c * sell_C + s];
+                    if (row < 0) continue;
+                    for (MKL_INT pos = sell_ptr[c] + cnt[row] * sell_C + s; pos < sell_ptr[c+1]; pos += sell_C)
+                        sell_col[pos] = row;
+                }
+            }
+            std::cout << "SELL-" << sell_C << "-" << sell_sigma << " layout: " << sell_ptr[n_chunk]
+                      << " slots for " << (sym ? 2 * nnz - dim : nnz) << " nonzero elements" << std::endl;
+        } else if (spmv_backend == 3) {
+            if (mkl_sparse_create_csr(&mkl_handle, dim, ia, ja, val) != SPARSE_STATUS_SUCCESS) {
+                std::cout << "mkl_sparse_create_csr failed, fall back to mkl_csrmv" << std::endl;
+                mkl_handle   = nullptr;
+                spmv_backend = 0;
+                return;
+            }
+            mkl_descr.type = sym ? mkl_sparse_type_upper(val) : SPARSE_MATRIX_TYPE_GENERAL;
+            mkl_descr.mode = SPARSE_FILL_MODE_UPPER;
+            mkl_descr.diag = SPARSE_DIAG_NON_UNIT;
+            mkl_sparse_set_mv_hint(mkl_handle, SPARSE_OPERATION_NON_TRANSPOSE, mkl_descr, 1000);   // Lanczos: many calls
+            if (mkl_sparse_optimize(mkl_handle) != SPARSE_STATUS_SUCCESS)
+                std::cout << "mkl_sparse_optimize failed, continue without optimization" << std::endl;
+        }
+    }
+    
+    template <typename T>
+    void csr_mat<T>::destroy_spmv()
+    {
+        sell_ptr.clear();
+        sell_ptr.shrink_to_fit();
+        sell_row.clear();
+        sell_row.shrink_to_fit();
+        sell_col.clear();
+        sell_col.shrink_to_fit();
+        sell_val.clear();
+        sell_val.shrink_to_fit();
+        y_private.clear();
+        sym_part.clear();
+        sym_span.clear();
+        if (mkl_handle != nullptr) {
+            mkl_sparse_destroy(mkl_handle);
+            mkl_handle = nullptr;
+        }
+    }
+    
+    template <typename T>
+    void csr_mat<T>::set_index(const std::string &mode)
+    {
+        assert(ia != nullptr);
+        if (mmap_addr != nullptr) {
+            std::cout << "Column indices of file-backed matrix kept as mkl_int" << std::endl;
+            return;
+        }
+        assert(mode == "mkl_int" || mode == "idx32" || mode == "delta");
+        if (ja == nullptr) {                                                     // back to plain indices first
+            ja = new MKL_INT[nnz];
+            if (idx_mode == 1) {
+                decode_ja_rows(dim, ia, rows_idx32{ja32.data(), ja32_base.data(), ia, ja32_block}, ja);
+            } else {
+                decode_ja_rows(dim, ia, rows_delta{ja_delta.data(), ia_delta.data()}, ja);
+            }
+            idx_mode = 0;
+            ja32.clear();
+            ja32.shrink_to_fit();
+            ja32_base.clear();
+            ja_delta.clear();
+            ja_delta.shrink_to_fit();
+            ia_delta.clear();
+            ia_delta.shrink_to_fit();
+        }
+        if (mode == "mkl_int") return;
+        
+        uint64_t bytes;
+        if (mode == "idx32") {
+            MKL_INT n_block = (dim + ja32_block - 1) / ja32_block;
+            ja32_base.assign(n_block, 0);
+            bool fit = true;
+            for (MKL_INT b = 0; b < n_block; b++) {
+                MKL_INT p_begin = ia[b * ja32_block];
+                MKL_INT p_end   = ia[std::min(dim, (b + 1) * ja32_block)];
+                if (p_begin == p_end) continue;
+                auto col_min = *std::min_element(ja + p_begin, ja + p_end);
+                auto col_max = *std::max_element(ja + p_begin, ja + p_end);
+                if (static_cast<uint64_t>(col_max - col_min) > static_cast<uint64_t>(UINT32_MAX)) fit = false;
+                ja32_base[b] = col_min;
+            }
+            if (! fit) {
+                std::cout << "Column span of a row block exceeds 32 bits, keep plain column indices" << std::endl;
+                ja32_base.clear();
+                return;
+            }
+            ja32.resize(nnz);
+            #pragma omp parallel for schedule(dynamic,256)
+            for (MKL_INT i = 0; i < dim; i++) {
+                for (MKL_INT p = ia[i]; p < ia[i+1]; p++)
+                    ja32[p] = static_cast<uint32_t>(ja[p] - ja32_base[i / ja32_block]);
+            }
+            idx_mode = 1;
+            bytes = sizeof(uint32_t) * static_cast<uint64_t>(nnz) + sizeof(MKL_INT) * static_cast<uint64_t>(n_block);
+        } else {
+            // count the bytes of each row, then encode in place
+            ia_delta.assign(dim + 1, 0);
+            #pragma omp parallel for schedule(dynamic,256)
+            for (MKL_INT i = 0; i < dim; i++) {
+                uint64_t len = 0;
+                for (MKL_INT p = ia[i]; p < ia[i+1]; p++) len += varint_len(delta_gap(ja, i, p, ia[i]));
+                ia_delta[i+1] = len;
+            }
+            for (MKL_INT i = 0; i < dim; i++) ia_delta[i+1] += ia_delta[i];
+            ja_delta.resize(ia_delta[dim]);
+            #pragma omp parallel for schedule(dynamic,256)
+            for (MKL_INT i = 0; i < dim; i++) {
+                uint64_t pos = ia_delta[i];
+                for (MKL_INT p = ia[i]; p < ia[i+1]; p++) varint_push(delta_gap(ja, i, p, ia[i]), ja_delta, pos);
+                assert(pos == ia_delta[i+1]);
+            }
+            idx_mode = 2;
+            bytes = ja_delta.size() + sizeof(uint64_t) * ia_delta.size();
+        }
+        std::cout << "Column indices stored as " << mode << ": " << sizeof(MKL_INT) * static_cast<uint64_t>(nnz)
+                  << " -> " << bytes << " bytes" << std::endl;
+        delete [] ja;
+        ja = nullptr;
+        if (spmv_backend != 1) {
+            destroy_spmv();
+            spmv_backend = 1;
+            std::cout << "spmv backend switched to native" << std::endl;
+        }
+    }
+    
+    template <typename T>
+    std::string csr_mat<T>::index() const
+    {
+        const std::string names[3] = {"mkl_int", "idx32", "delta"};
+        return names[idx_mode];
+    }
+    
+    template <typename T>
+    void csr_mat<T>::decode_ja(std::vector<MKL_INT> &cols) const
+    {
+        cols.resize(nnz);
+        if (idx_mode == 1) {
+            decode_ja_rows(dim, ia, rows_idx32{ja32.data(), ja32_base.data(), ia, ja32_block}, cols.data());
+        } else if (idx_mode == 2) {
+            decode_ja_rows(dim, ia, rows_delta{ja_delta.data(), ia_delta.data()}, cols.data());
+        } else {
+            std::copy(ja, ja + nnz, cols.begin());
+        }
+    }
+    
+    template <typename T>
+    bool csr_mat<T>::use_real_values()
+    {
+        if (sizeof(T) == sizeof(double) || val == nullptr) return false;    // already real
+        if (mmap_addr != nullptr) return false;
+        bool real = true;
+        #pragma omp parallel for reduction(&&:real)
+        for (MKL_INT j = 0; j < nnz; j++) {
+            if (std::abs(std::imag(val[j])) > sparse_precision) real = false;
+        }
+        if (! real) return false;
+        val_re.resize(nnz);
+        #pragma omp parallel for
+        for (MKL_INT j = 0; j < nnz; j++) val_re[j] = std::real(val[j]);
+        delete [] val;
+        val = nullptr;
+        std::cout << "Matrix elements all real, stored as double: " << sizeof(T) * static_cast<uint64_t>(nnz)
+                  << " -> " << sizeof(double) * static_cast<uint64_t>(nnz) << " bytes" << std::endl;
+        if (spmv_backend != 1) {
+            destroy_spmv();
+            spmv_backend = 1;
+            std::cout << "spmv backend switched to native" << std::endl;
+        }
+        return true;
+    }
+    
+    template <typename T>
+    void csr_mat<T>::use_complex_values()
+    {
+        if (val != nullptr) return;
+        std::vector<T> vals;
+        decode_val(vals);
+        val = new T[nnz];
+        std::copy(vals.begin(), vals.end(), val);
+        val_re.clear();
+        val_re.shrink_to_fit();
+    }
+    
+    template <typename T>
+    void csr_mat<T>::decode_val(std::vector<T> &vals) const
+    {
+        vals.resize(nnz);
+        if (val != nullptr) {
+            std::copy(val, val + nnz, vals.begin());
+        } else {
+            for (MKL_INT j = 0; j < nnz; j++) vals[j] = static_cast<T>(val_re[j]);
+        }
     }
     
     template <typename T>
@@ -235,18 +1270,238 @@ namespace qbasis {
         std::cout << "Converting CSR to " << dim << "x" << dim << " dense matrix!" << std::endl;
         if (dim > 500) std::cout << "Warning: Dense matrix large!!!" << std::endl;
         std::vector<T> res(dim*dim,static_cast<T>(0.0));
+        std::vector<MKL_INT> cols;
+        std::vector<T> vals;
+        decode_ja(cols);
+        decode_val(vals);
+        const MKL_INT *col_idx = cols.data();
+        const T *v = vals.data();
         for (MKL_INT row = 0; row < dim; row++) {
             MKL_INT pt_row_curr = ia[row];
             MKL_INT pt_row_next = ia[row+1];
             for (MKL_INT pt = pt_row_curr; pt < pt_row_next; pt++) {
-                MKL_INT col = ja[pt];
-                res[row + col * dim] = val[pt];
-                if (sym && row != col) res[col + row * dim] = conjugate(val[pt]);
+                MKL_INT col = col_idx[pt];
+                res[row + col * dim] = v[pt];
+                if (sym && row != col) res[col + row * dim] = conjugate(v[pt]);
             }
         }
         return res;
     }
     
+    template <typename T>
+    bool csr_mat<T>::q_hermitian() const
+    {
+        if (sym) return true;
+        assert(ia != nullptr);
+        std::vector<MKL_INT> cols;
+        std::vector<T> vals;
+        const MKL_INT *col_idx = ja;
+        const T *v = val;
+        if (col_idx == nullptr) {
+            decode_ja(cols);
+            col_idx = cols.data();
+        }
+        if (v == nullptr) {
+            decode_val(vals);
+            v = vals.data();
+        }
+        MKL_INT bad_row = dim;                                                   // first row failing the check
+        #pragma omp parallel for schedule(dynamic,256)
+        for (MKL_INT row = 0; row < dim; row++) {
+            for (MKL_INT j = ia[row]; j < ia[row+1]; j++) {                      // check for each element in current row
+                auto col = col_idx[j];
+                if (row == col) continue;
+                auto pos = std::lower_bound(col_idx + ia[col], col_idx + ia[col+1], row);  // cols sorted within each row
+                if (pos == col_idx + ia[col+1] || *pos != row ||
+                    std::abs(v[j] - std::conj(v[pos - col_idx])) > sparse_precision) {
+                    #pragma omp critical
+                    {
+                        if (row < bad_row) bad_row = row;
+                    }
+                    break;
+                }
+            }
+        }
+        if (bad_row == dim) return true;
+        
+        auto row = bad_row;
+        for (MKL_INT j = ia[row]; j < ia[row+1]; j++) {
+            auto col = col_idx[j];
+            if (row == col) continue;
+            auto pos = std::lower_bound(col_idx + ia[col], col_idx + ia[col+1], row);
+            bool found = (pos != col_idx + ia[col+1] && *pos == row);
+            if (found && std::abs(v[j] - std::conj(v[pos - col_idx])) <= sparse_precision) continue;
+            std::cout << "Hermitian check failed!!!" << std::endl;
+            std::cout << "(row, col)    = (" << row << ", " << col << ")" << std::endl;
+            std::cout << "mat(row, col) = " << v[j] << std::endl;
+            if (! found) {
+                std::cout << "mat(col, row) NOT found!" << std::endl;
+            } else {
+                std::cout << "mat(col, row) = " << v[pos - col_idx] << std::endl;
+            }
+            break;
+        }
+        return false;
+    }
+    
+    template <typename T>
+    std::vector<MKL_INT> csr_mat<T>::rcm_order() const
+    {
+        assert(ia != nullptr);
+        std::vector<MKL_INT> cols;
+        decode_ja(cols);
+        
+        // adjacency lists of the full (symmetric) pattern, diagonal excluded
+        std::vector<MKL_INT> adj_ptr(dim + 1, 0);
+        for (MKL_INT i = 0; i < dim; i++) {
+            for (MKL_INT p = ia[i]; p < ia[i+1]; p++) {
+                if (cols[p] == i) continue;
+                adj_ptr[i+1]++;
+                if (sym) adj_ptr[cols[p]+1]++;
+            }
+        }
+        for (MKL_INT i = 0; i < dim; i++) adj_ptr[i+1] += adj_ptr[i];
+        std::vector<MKL_INT> adj(adj_ptr[dim]), fill(adj_ptr.begin(), adj_ptr.end() - 1);
+        for (MKL_INT i = 0; i < dim; i++) {
+            for (MKL_INT p = ia[i]; p < ia[i+1]; p++) {
+                if (cols[p] == i) continue;
+                adj[fill[i]++] = cols[p];
+                if (sym) adj[fill[cols[p]]++] = i;
+            }
+        }
+        fill.clear();
+        fill.shrink_to_fit();
+        auto degree = [&adj_ptr](const MKL_INT &i) { return adj_ptr[i+1] - adj_ptr[i]; };
+        auto by_degree = [&degree](const MKL_INT &a, const MKL_INT &b) {
+            return degree(a) < degree(b) || (degree(a) == degree(b) && a < b);
+        };
+        
+        // breadth first search from root inside the un-numbered part of the graph,
+        // the visited vertices appended to queue (from position q_begin), returns the # of levels
+        std::vector<MKL_INT> level(dim, -1), queue;
+        queue.reserve(dim);
+        auto bfs = [&](const MKL_INT &root, const size_t &q_begin, const bool &sorted) {
+            level[root] = 0;
+            queue.push_back(root);
+            MKL_INT depth = 0;
+            for (size_t q = q_begin; q < queue.size(); q++) {
+                auto i = queue[q];
+                auto q_nbr = queue.size();
+                for (MKL_INT p = adj_ptr[i]; p < adj_ptr[i+1]; p++) {
+                    if (level[adj[p]] >= 0) continue;
+                    level[adj[p]] = level[i] + 1;
+                    depth = std::max(depth, level[i] + 1);
+                    queue.push_back(adj[p]);
+                }
+                if (sorted) std::sort(queue.begin() + q_nbr, queue.end(), by_degree);
+            }
+            return depth + 1;
+        };
+        auto bfs_undo = [&](const size_t &q_begin) {
+            for (size_t q = q_begin; q < queue.size(); q++) level[queue[q]] = -1;
+            queue.resize(q_begin);
+        };
+        
+        for (MKL_INT start = 0; start < dim; start++) {
+            if (level[start] >= 0) continue;
+            auto q_begin = queue.size();
+            // pseudo-peripheral root: from a vertex of minimal degree of the component,
+            // move to the vertex of minimal degree on the last level, as long as the eccentricity grows
+            bfs(start, q_begin, false);
+            auto root = *std::min_element(queue.begin() + q_begin, queue.end(), by_degree);
+            bfs_undo(q_begin);
+            auto depth = bfs(root, q_begin, false);
+            for (int iter = 0; iter < 16; iter++) {
+                MKL_INT cand = -1;
+                for (size_t q = q_begin; q < queue.size(); q++) {
+                    if (level[queue[q]] == depth - 1 && (cand < 0 || by_degree(queue[q], cand))) cand = queue[q];
+                }
+                bfs_undo(q_begin);
+                auto depth_new = bfs(cand, q_begin, false);
+                if (depth_new <= depth) {
+                    bfs_undo(q_begin);
+                    break;
+                }
+                root  = cand;
+                depth = depth_new;
+            }
+            if (queue.size() > q_begin) bfs_undo(q_begin);
+            // Cuthill-McKee: neighbors numbered in the order of increasing degree
+            bfs(root, q_begin, true);
+        }
+        assert(static_cast<MKL_INT>(queue.size()) == dim);
+        
+        std::vector<MKL_INT> perm(dim);
+        for (MKL_INT k = 0; k < dim; k++) perm[queue[k]] = dim - 1 - k;     // reversed
+        
+        MKL_INT bw_old = 0, bw_new = 0;
+        for (MKL_INT i = 0; i < dim; i++) {
+            for (MKL_INT p = adj_ptr[i]; p < adj_ptr[i+1]; p++) {
+                bw_old = std::max(bw_old, std::abs(adj[p] - i));
+                bw_new = std::max(bw_new, std::abs(perm[adj[p]] - perm[i]));
+            }
+        }
+        std::cout << "Reverse Cuthill-McKee ordering, bandwidth: " << bw_old << " -> " << bw_new << std::endl;
+        return perm;
+    }
+    
+    template <typename T>
+    bool csr_mat<T>::permute(const std::vector<MKL_INT> &perm)
+    {
+        assert(ia != nullptr && static_cast<MKL_INT>(perm.size()) == dim);
+        if (mmap_addr != nullptr) {
+            std::cout << "File-backed matrix not permuted" << std::endl;
+            return false;
+        }
+        auto mode = index();
+        bool real = q_real_values();
+        set_index("mkl_int");
+        use_complex_values();
+        destroy_spmv();
+        
+        // (i, j, v) -> (perm[i], perm[j], v), for sym == true kept in the upper triangle
+        auto target = [&perm, this](const MKL_INT &i, const MKL_INT &j) {
+            return (sym && perm[i] > perm[j]) ? perm[j] : perm[i];
+        };
+        MKL_INT *ia_new = new MKL_INT[dim+1];
+        std::fill(ia_new, ia_new + dim + 1, 0);
+        for (MKL_INT i = 0; i < dim; i++) {
+            for (MKL_INT p = ia[i]; p < ia[i+1]; p++) ia_new[target(i, ja[p]) + 1]++;
+        }
+        for (MKL_INT i = 0; i < dim; i++) ia_new[i+1] += ia_new[i];
+        assert(ia_new[dim] == nnz);
+        std::vector<std::pair<MKL_INT,T>> elems(nnz);
+        std::vector<MKL_INT> pos(ia_new, ia_new + dim);
+        for (MKL_INT i = 0; i < dim; i++) {
+            for (MKL_INT p = ia[i]; p < ia[i+1]; p++) {
+                auto row = target(i, ja[p]);
+                if (row == perm[i]) {
+                    elems[pos[row]++] = std::make_pair(perm[ja[p]], val[p]);
+                } else {
+                    elems[pos[row]++] = std::make_pair(perm[i], conjugate(val[p]));
+                }
+            }
+        }
+        pos.clear();
+        pos.shrink_to_fit();
+        #pragma omp parallel for schedule(dynamic,256)
+        for (MKL_INT i = 0; i < dim; i++) {
+            std::sort(elems.begin() + ia_new[i], elems.begin() + ia_new[i+1],
+                      [](const std::pair<MKL_INT,T> &a, const std::pair<MKL_INT,T> &b) { return a.first < b.first; });
+            for (MKL_INT p = ia_new[i]; p < ia_new[i+1]; p++) {
+                ja[p]  = elems[p].first;
+                val[p] = elems[p].second;
+            }
+        }
+        delete [] ia;
+        ia = ia_new;
+        
+        prepare_spmv();
+        if (mode != "mkl_int") set_index(mode);
+        if (real) use_real_values();
+        return true;
+    }
+    
     template <typename T>
     void swap(csr_mat<T> &lhs, csr_mat<T> &rhs)
     {
@@ -257,8 +1512,31 @@ namespace qbasis {
         swap(lhs.val, rhs.val);
         swap(lhs.ja,  rhs.ja);
         swap(lhs.ia,  rhs.ia);
+        swap(lhs.spmv_backend, rhs.spmv_backend);
+        swap(lhs.sell_C,       rhs.sell_C);
+        swap(lhs.sell_sigma,   rhs.sell_sigma);
+        swap(lhs.sell_ptr,     rhs.sell_ptr);
+        swap(lhs.sell_row,     rhs.sell_row);
+        swap(lhs.sell_col,     rhs.sell_col);
+        swap(lhs.sell_val,     rhs.sell_val);
+        swap(lhs.mkl_handle,   rhs.mkl_handle);
+        swap(lhs.mkl_descr,    rhs.mkl_descr);
+        swap(lhs.y_private,    rhs.y_private);
+        swap(lhs.sym_part,     rhs.sym_part);
+        swap(lhs.sym_span,     rhs.sym_span);
+        swap(lhs.idx_mode,     rhs.idx_mode);
+        swap(lhs.ja32,         rhs.ja32);
+        swap(lhs.ja32_base,    rhs.ja32_base);
+        swap(lhs.ja_delta,     rhs.ja_delta);
+        swap(lhs.ia_delta,     rhs.ia_delta);
+        swap(lhs.val_re,       rhs.val_re);
+        swap(lhs.mmap_addr,    rhs.mmap_addr);
+        swap(lhs.mmap_len,     rhs.mmap_len);
+        swap(lhs.mmap_name,    rhs.mmap_name);
     }
     
+    template <typename T> const MKL_INT csr_mat<T>::ja32_block;
+    
     // Explicit instantiation
     template struct lil_mat_elem<double>;
     template struct lil_mat_elem<std::complex<double>>;